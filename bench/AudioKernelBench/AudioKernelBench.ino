@@ -0,0 +1,84 @@
+/*
+ * AudioKernel microbenchmark
+ *
+ * Times the Speaker block kernel against the original per-sample float loop on
+ * the target and prints CPU cycles per frame for mono/stereo input at unity and
+ * sub-unity gain. Build it like src/main/main.ino (src/main on the include path)
+ * and read the results on the serial monitor at 115200 baud.
+ */
+
+#include <Arduino.h>
+#include <AudioKernel.hpp>
+
+static const size_t FRAMES = 1024;
+static const int    ITERS  = 200;
+
+static int16_t g_in[FRAMES * 2];
+static int16_t g_out[FRAMES];
+
+/*
+ * The loop audioTask used before AudioKernel, kept here as the baseline
+ */
+static void referenceLoop(const int16_t* in, uint8_t ch, int16_t* out, size_t frames, float volume) {
+  for (size_t i = 0; i < frames; ++i) {
+    int16_t monoSample;
+    if (ch == 1) {
+      monoSample = in[i];
+    } else {
+      int32_t mix = (int32_t)in[2 * i] + (int32_t)in[2 * i + 1];
+      monoSample  = (int16_t)(mix / 2);
+    }
+    int32_t scaled = (int32_t)(monoSample * volume);
+    if (scaled > 32767) scaled = 32767;
+    if (scaled < -32768) scaled = -32768;
+    out[i] = (int16_t)scaled;
+  }
+}
+
+/*
+ * Runs one configuration ITERS times and prints cycles per frame for both paths
+ */
+static void benchOne(uint8_t ch, float volume) {
+  int32_t gainQ15 = AudioKernel::gainToQ15(volume);
+
+  uint32_t t0 = esp_cpu_get_cycle_count();
+  for (int it = 0; it < ITERS; ++it) {
+    referenceLoop(g_in, ch, g_out, FRAMES, volume);
+  }
+  uint32_t t1 = esp_cpu_get_cycle_count();
+  for (int it = 0; it < ITERS; ++it) {
+    AudioKernel::toMono(g_in, ch, g_out, FRAMES, gainQ15);
+  }
+  uint32_t t2 = esp_cpu_get_cycle_count();
+
+  float refCpf    = (float)(t1 - t0) / (float)(ITERS * FRAMES);
+  float kernelCpf = (float)(t2 - t1) / (float)(ITERS * FRAMES);
+
+  Serial.printf("ch=%u gain=%.2f  float loop: %6.2f cyc/frame  kernel: %6.2f cyc/frame  (x%.2f)\n",
+                ch, volume, refCpf, kernelCpf, refCpf / kernelCpf);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < FRAMES * 2; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    g_in[i] = (int16_t)(seed >> 16);
+  }
+
+  Serial.printf("AudioKernel bench: %u frames x %d iterations, ESP-DSP path %s\n",
+                (unsigned)FRAMES, ITERS, AUDIO_KERNEL_USE_ESP_DSP ? "on" : "off");
+
+  benchOne(1, 1.0f);
+  benchOne(1, 0.05f);
+  benchOne(1, 1.5f);
+  benchOne(2, 1.0f);
+  benchOne(2, 0.05f);
+  benchOne(2, 1.5f);
+}
+
+void loop() {
+  vTaskDelay(portMAX_DELAY);
+}
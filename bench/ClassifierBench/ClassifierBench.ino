@@ -0,0 +1,146 @@
+/*
+ * Gesture classifier microbenchmark
+ *
+ * Builds a set of synthetic episodes (Left, Right, Up, Down and Tap, at slow and
+ * fast speeds) by feeding simulated L/R/T passes through GesturePreprocessor,
+ * then times the rule cascade against the int8 decision tree and prints CPU
+ * cycles per classification plus each backend's verdict. Build it like
+ * src/main/main.ino (src/main on the include path) and read the results on the
+ * serial monitor at 115200 baud.
+ */
+
+#include <Arduino.h>
+#include <GestureClassifier.hpp>
+
+static const int      ITERS     = 2000;
+static const uint32_t FRAME_US  = 20000;
+static const uint8_t  MAX_CASES = 10;
+
+struct BenchCase {
+  const char*    name;
+  GestureDir     expected;
+  GestureEpisode ep;
+};
+
+static BenchCase g_cases[MAX_CASES];
+static uint8_t   g_numCases = 0;
+
+/*
+ * One sensor's view of a simulated pass: visible in [startMs, endMs), with the
+ * distance dipping linearly from farMm to nearMm at the middle and back
+ */
+struct Pass {
+  uint16_t startMs;
+  uint16_t endMs;
+  uint16_t farMm;
+  uint16_t nearMm;
+};
+
+static uint16_t passDistance(const Pass &p, uint32_t tMs) {
+  if (p.endMs <= p.startMs || tMs < p.startMs || tMs >= p.endMs) return 0xFFFF;
+  uint32_t half = (p.endMs - p.startMs) / 2;
+  uint32_t mid  = p.startMs + half;
+  uint32_t off  = tMs < mid ? mid - tMs : tMs - mid;
+  return (uint16_t)(p.nearMm + (uint32_t)(p.farMm - p.nearMm) * off / (half ? half : 1));
+}
+
+/*
+ * Runs one simulated gesture through a fresh preprocessor and keeps the episode
+ */
+static void addCase(const char* name, GestureDir expected,
+                    const Pass &l, const Pass &r, const Pass &t) {
+  if (g_numCases >= MAX_CASES) return;
+
+  GesturePreprocessor gp;
+  uint32_t baseUs = 1000000;
+  for (uint32_t k = 0; k < 200; ++k) {
+    uint32_t tMs = k * (FRAME_US / 1000);
+    uint16_t d[3]   = { passDistance(l, tMs), passDistance(r, tMs), passDistance(t, tMs) };
+    uint32_t tUs[3] = { baseUs, baseUs + 150, baseUs + 300 };
+    baseUs += FRAME_US;
+
+    if (gp.update(d, tUs) == GestureEvent::EpisodeReady) {
+      BenchCase &c = g_cases[g_numCases++];
+      c.name     = name;
+      c.expected = expected;
+      c.ep       = gp.lastEpisode();
+      return;
+    }
+  }
+  Serial.printf("%-12s no episode\n", name);
+}
+
+static const char* dirName(GestureDir d) {
+  switch (d) {
+    case GestureDir::Left:  return "LEFT";
+    case GestureDir::Right: return "RIGHT";
+    case GestureDir::Up:    return "UP";
+    case GestureDir::Down:  return "DOWN";
+    case GestureDir::Tap:   return "TAP";
+    default:                return "NONE";
+  }
+}
+
+static void buildCases() {
+  const Pass none = { 0, 0, 0, 0 };
+
+  addCase("right",      GestureDir::Right, { 0, 240, 110, 90 },  { 100, 340, 110, 90 }, none);
+  addCase("right-fast", GestureDir::Right, { 0, 120, 110, 80 },  { 40, 160, 110, 80 },  none);
+  addCase("left",       GestureDir::Left,  { 100, 340, 110, 90 }, { 0, 240, 110, 90 },   none);
+  addCase("left-fast",  GestureDir::Left,  { 40, 160, 110, 80 },  { 0, 120, 110, 80 },   none);
+  // Fast swipes close to the board: big swings on both sides, as in a tap
+  addCase("right-deep", GestureDir::Right, { 0, 160, 135, 55 },  { 60, 220, 135, 55 },  none);
+  addCase("left-deep",  GestureDir::Left,  { 60, 220, 135, 55 }, { 0, 160, 135, 55 },   none);
+  addCase("up",         GestureDir::Up,    { 0, 240, 110, 90 },  { 0, 240, 110, 90 },   { 120, 360, 110, 90 });
+  addCase("down",       GestureDir::Down,  { 120, 360, 110, 90 }, { 120, 360, 110, 90 }, { 0, 240, 110, 90 });
+  addCase("tap",        GestureDir::Tap,   { 0, 200, 135, 50 },  { 0, 200, 135, 50 },   none);
+  addCase("tap-skewed", GestureDir::Tap,   { 0, 200, 135, 50 },  { 20, 220, 135, 50 },  none);
+}
+
+/*
+ * Times one backend over all cases and prints cycles per classification
+ */
+static void benchBackend(const char* name, GestureDir (*fn)(const GestureEpisode&)) {
+  volatile uint8_t sink = 0;
+
+  uint32_t t0 = esp_cpu_get_cycle_count();
+  for (int it = 0; it < ITERS; ++it) {
+    for (uint8_t c = 0; c < g_numCases; ++c) {
+      sink += (uint8_t)fn(g_cases[c].ep);
+    }
+  }
+  uint32_t t1 = esp_cpu_get_cycle_count();
+
+  uint8_t correct = 0;
+  for (uint8_t c = 0; c < g_numCases; ++c) {
+    if (fn(g_cases[c].ep) == g_cases[c].expected) ++correct;
+  }
+
+  float cpc = (float)(t1 - t0) / (float)(ITERS * (g_numCases ? g_numCases : 1));
+  Serial.printf("%-6s %8.1f cyc/classification  %u/%u correct\n",
+                name, cpc, correct, g_numCases);
+  (void)sink;
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(1000);
+
+  buildCases();
+
+  Serial.printf("Classifier bench: %u episodes x %d iterations, %u tree nodes\n",
+                g_numCases, ITERS, GestureTree::NODE_COUNT);
+  for (uint8_t c = 0; c < g_numCases; ++c) {
+    Serial.printf("%-12s expected %-5s rules %-5s tree %-5s\n",
+                  g_cases[c].name, dirName(g_cases[c].expected),
+                  dirName(classifyRules(g_cases[c].ep)),
+                  dirName(GestureTree::classify(g_cases[c].ep)));
+  }
+
+  benchBackend("rules", classifyRules);
+  benchBackend("tree",  GestureTree::classify);
+}
+
+void loop() {
+  vTaskDelay(portMAX_DELAY);
+}
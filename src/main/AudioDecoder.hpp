@@ -0,0 +1,331 @@
+/*
+ * Audio Decoders
+ *
+ * Codec side of the Speaker decoder stage, kept free of SD and FreeRTOS code so
+ * it can be exercised on its own. The reader task feeds each decoder the track's
+ * data bytes as they come off the card and asks for PCM frames, any number at a
+ * time, so decoded tracks fill the same prefetch blocks as PCM ones and the
+ * output task never sees the difference.
+ *
+ *  - IMA ADPCM (WAV format 0x11): 4 bits per sample, about a quarter of the SD
+ *    traffic and card space of 16-bit PCM. Decoding is a table lookup and a few
+ *    adds per sample, and the decoder keeps only 8 frames of state, so it can
+ *    stop after any frame.
+ *  - MP3 (MPEG-1/2/2.5 layer III), optional with SPEAKER_MP3: streams through the
+ *    fixed-point Helix decoder (the ESP32-C6 has no FPU), one frame of PCM at a
+ *    time. Headers are parsed here without the library, so files can be listed
+ *    and indexed in any build.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 1 = decode MP3 tracks (needs the Helix MP3 library, e.g. arduino-libhelix)
+#ifndef SPEAKER_MP3
+#define SPEAKER_MP3 0
+#endif
+
+#if SPEAKER_MP3
+#if __has_include("mp3dec.h")
+#include "mp3dec.h"
+#elif __has_include("libhelix-mp3/mp3dec.h")
+#include "libhelix-mp3/mp3dec.h"
+#else
+#error "SPEAKER_MP3 needs the Helix MP3 decoder (mp3dec.h)"
+#endif
+#endif
+
+namespace AudioDecoder {
+
+  enum class Codec : uint8_t {
+    Pcm16 = 0,
+    ImaAdpcm,
+    Mp3
+  };
+
+  static const uint16_t WAVE_FORMAT_PCM       = 0x0001;
+  static const uint16_t WAVE_FORMAT_IMA_ADPCM = 0x0011;
+
+  inline const char* codecName(Codec c) {
+    switch (c) {
+      case Codec::ImaAdpcm: return "ima-adpcm";
+      case Codec::Mp3:      return "mp3";
+      default:              return "pcm";
+    }
+  }
+
+  // ========= IMA ADPCM =========
+
+  static const int16_t IMA_STEP[89] = {
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+  };
+
+  static const int8_t IMA_INDEX[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8
+  };
+
+  // Frames per block of a WAV IMA ADPCM file: the header sample plus 2 per data byte and channel
+  inline uint32_t imaFramesPerBlock(uint16_t blockAlign, uint8_t channels) {
+    if (!channels || blockAlign < 4u * channels) return 0;
+    return (uint32_t)(blockAlign - 4u * channels) * 2 / channels + 1;
+  }
+
+  /*
+   * Incremental decoder for the data chunk of a WAV IMA ADPCM file
+   * Input can arrive in any split. Each block starts with a 4-byte header per
+   * channel (the first sample and step index); after it, channels take turns in
+   * 4-byte groups of 8 samples, low nibble first. A group that does not fit the
+   * caller's buffer is decoded into `pend` and handed out on the next call.
+   */
+  struct ImaDecoder {
+    uint16_t blockAlign = 0;
+    uint8_t  ch         = 1;
+    uint16_t blockPos   = 0;       // bytes of the current block already consumed
+    int32_t  pred[2]    = {};
+    int8_t   index[2]   = {};
+    int16_t  pend[8 * 2];
+    uint8_t  pendFrames = 0;
+    uint8_t  pendPos    = 0;
+
+    void reset(uint16_t align, uint8_t channels) {
+      blockAlign = align;
+      ch         = channels == 2 ? 2 : 1;
+      blockPos   = 0;
+      pendFrames = pendPos = 0;
+      pred[0] = pred[1] = 0;
+      index[0] = index[1] = 0;
+    }
+
+    // Frames decoded but not handed out yet
+    bool pending() const { return pendPos < pendFrames; }
+
+    inline int16_t nibble(uint8_t c, uint8_t n) {
+      const int32_t step = IMA_STEP[index[c]];
+      int32_t diff = step >> 3;
+      if (n & 1) diff += step >> 2;
+      if (n & 2) diff += step >> 1;
+      if (n & 4) diff += step;
+      int32_t p = pred[c] + ((n & 8) ? -diff : diff);
+      p = p < -32768 ? -32768 : (p > 32767 ? 32767 : p);
+      pred[c] = p;
+      int32_t i = index[c] + IMA_INDEX[n];
+      index[c] = (int8_t)(i < 0 ? 0 : (i > 88 ? 88 : i));
+      return (int16_t)p;
+    }
+
+    // 8 frames from one group of 4 bytes per channel
+    inline void group(const uint8_t* in, int16_t* out) {
+      for (uint8_t c = 0; c < ch; ++c) {
+        const uint8_t* b = in + 4 * c;
+        for (uint8_t k = 0; k < 4; ++k) {
+          out[(2 * k) * ch + c]     = nibble(c, b[k] & 0x0F);
+          out[(2 * k + 1) * ch + c] = nibble(c, b[k] >> 4);
+        }
+      }
+    }
+
+    /*
+     * Decodes up to maxFrames interleaved frames from `len` input bytes
+     * Returns the frames written; `used` is the input consumed. Stops early only
+     * when the next header or group is not complete in the input.
+     */
+    size_t decode(const uint8_t* in, size_t len, size_t& used, int16_t* out, size_t maxFrames) {
+      size_t         n       = 0;
+      const uint16_t grpSize = 4 * ch;
+      used = 0;
+
+      while (n < maxFrames) {
+        if (pending()) {
+          for (uint8_t c = 0; c < ch; ++c) out[n * ch + c] = pend[pendPos * ch + c];
+          ++pendPos;
+          ++n;
+          continue;
+        }
+
+        if (blockPos == 0) {
+          if (len - used < grpSize) break;
+          for (uint8_t c = 0; c < ch; ++c) {
+            const uint8_t* h = in + used + 4 * c;
+            pred[c]  = (int16_t)((uint16_t)h[0] | ((uint16_t)h[1] << 8));
+            index[c] = (int8_t)(h[2] > 88 ? 88 : h[2]);
+            out[n * ch + c] = (int16_t)pred[c];
+          }
+          used    += grpSize;
+          blockPos = grpSize;
+          ++n;
+          continue;
+        }
+
+        // Trailing bytes too short for a group are padding: skip to the next block
+        if (blockPos + grpSize > blockAlign) {
+          const size_t skip = blockAlign - blockPos;
+          if (len - used < skip) break;
+          used    += skip;
+          blockPos = 0;
+          continue;
+        }
+
+        if (len - used < grpSize) break;
+        if (maxFrames - n >= 8) {
+          group(in + used, out + n * ch);
+          n += 8;
+        } else {
+          group(in + used, pend);
+          pendFrames = 8;
+          pendPos    = 0;
+        }
+        used     += grpSize;
+        blockPos += grpSize;
+        if (blockPos == blockAlign) blockPos = 0;
+      }
+      return n;
+    }
+  };
+
+  // ========= MPEG audio frame headers =========
+
+  struct MpegHeader {
+    uint32_t sampleRate    = 0;
+    uint32_t bitrate       = 0;   // bits per second
+    uint16_t frameBytes    = 0;
+    uint16_t framePcm      = 0;   // frames of PCM per MPEG frame
+    uint8_t  channels      = 0;
+    uint8_t  version       = 0;   // 1 = MPEG-1, 2 = MPEG-2, 3 = MPEG-2.5
+  };
+
+  /*
+   * Parses a 4-byte MPEG layer III frame header; false if h is not one
+   * Free-format streams (bitrate index 0) are rejected since their frame length
+   * is not in the header.
+   */
+  inline bool parseMpegHeader(const uint8_t* h, MpegHeader& out) {
+    static const uint16_t KBPS_V1[15] = { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 };
+    static const uint16_t KBPS_V2[15] = { 0,  8, 16, 24, 32, 40, 48, 56,  64,  80,  96, 112, 128, 144, 160 };
+    static const uint32_t RATE_V1[3]  = { 44100, 48000, 32000 };
+
+    if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) return false;
+    const uint8_t ver    = (h[1] >> 3) & 3;   // 0 = 2.5, 1 = reserved, 2 = MPEG-2, 3 = MPEG-1
+    const uint8_t layer  = (h[1] >> 1) & 3;   // 1 = layer III
+    const uint8_t brIdx  = h[2] >> 4;
+    const uint8_t srIdx  = (h[2] >> 2) & 3;
+    const uint8_t pad    = (h[2] >> 1) & 1;
+    if (ver == 1 || layer != 1 || brIdx == 0 || brIdx == 15 || srIdx == 3) return false;
+
+    const bool v1 = ver == 3;
+    out.version    = v1 ? 1 : (ver == 2 ? 2 : 3);
+    out.sampleRate = RATE_V1[srIdx] >> (v1 ? 0 : (ver == 2 ? 1 : 2));
+    out.bitrate    = (uint32_t)(v1 ? KBPS_V1[brIdx] : KBPS_V2[brIdx]) * 1000;
+    out.framePcm   = v1 ? 1152 : 576;
+    out.frameBytes = (uint16_t)((v1 ? 144 : 72) * out.bitrate / out.sampleRate + pad);
+    out.channels   = ((h[3] >> 6) & 3) == 3 ? 1 : 2;
+    return true;
+  }
+
+  // Size of an ID3v2 tag starting at h (10 header bytes), 0 if there is none
+  inline uint32_t id3v2Size(const uint8_t* h) {
+    if (memcmp(h, "ID3", 3) != 0) return 0;
+    if ((h[6] | h[7] | h[8] | h[9]) & 0x80) return 0;
+    const uint32_t body = ((uint32_t)h[6] << 21) | ((uint32_t)h[7] << 14) |
+                          ((uint32_t)h[8] << 7) | (uint32_t)h[9];
+    return 10 + body + ((h[5] & 0x10) ? 10 : 0);
+  }
+
+#if SPEAKER_MP3
+
+  // ========= MP3 streams (Helix) =========
+
+  static const uint16_t MP3_FRAME_PCM_MAX = 1152;
+
+  /*
+   * One MP3 decoder with its input buffer and one frame of decoded PCM
+   * Several KB of state each (plus the Helix heap allocation), so Speaker keeps
+   * a small pool of these and lends them only to slots that are playing.
+   */
+  struct Mp3Stream {
+    HMP3Decoder h = nullptr;
+    int16_t     pcm[MP3_FRAME_PCM_MAX * 2];
+    uint16_t    pcmFrames = 0;
+    uint16_t    pcmPos    = 0;
+    uint8_t     ch        = 2;
+    bool        inUse     = false;
+
+    // Fresh decoder state for a new track; Helix has no reset, so it is re-created
+    bool restart() {
+      if (h) MP3FreeDecoder(h);
+      h = MP3InitDecoder();
+      return h != nullptr;
+    }
+
+    void reset(uint8_t channels) {
+      ch        = channels == 2 ? 2 : 1;
+      pcmFrames = pcmPos = 0;
+    }
+
+    bool pending() const { return pcmPos < pcmFrames; }
+
+    // Hands out buffered frames; returns how many were copied
+    size_t take(int16_t* out, size_t maxFrames) {
+      size_t n = pcmFrames - pcmPos;
+      if (n > maxFrames) n = maxFrames;
+      memcpy(out, pcm + pcmPos * ch, n * ch * sizeof(int16_t));
+      pcmPos += (uint16_t)n;
+      return n;
+    }
+
+    enum class Result : uint8_t {
+      Frame,       // pcm holds a new frame
+      NeedInput,   // no complete frame in the input; refill after dropping `used`
+      Skipped      // a frame was consumed without output; try again
+    };
+
+    /*
+     * Decodes the next frame from in[0..len) into pcm; `used` is the input consumed
+     * Frames that fail to decode, or that change the channel count mid-stream,
+     * are skipped, like the first frames after a seek whose bit reservoir is
+     * missing.
+     */
+    Result decodeFrame(uint8_t* in, size_t len, size_t& used) {
+      const int off = MP3FindSyncWord(in, (int)len);
+      if (off < 0) {
+        used = len > 3 ? len - 3 : 0;   // keep a possible partial sync word
+        return Result::NeedInput;
+      }
+
+      unsigned char* p    = in + off;
+      int            left = (int)(len - off);
+      const int      err  = MP3Decode(h, &p, &left, pcm, 0);
+      if (err == ERR_MP3_INDATA_UNDERFLOW) {
+        used = (size_t)off;
+        return Result::NeedInput;
+      }
+      if (err != ERR_MP3_NONE) {
+        // Reservoir underflow consumes the frame; anything else resyncs past the header
+        used = err == ERR_MP3_MAINDATA_UNDERFLOW ? len - (size_t)left : (size_t)off + 1;
+        return Result::Skipped;
+      }
+      used = len - (size_t)left;
+
+      MP3FrameInfo fi;
+      MP3GetLastFrameInfo(h, &fi);
+      if (fi.nChans != ch || fi.outputSamps <= 0) return Result::Skipped;
+      pcmFrames = (uint16_t)(fi.outputSamps / fi.nChans);
+      pcmPos    = 0;
+      return Result::Frame;
+    }
+  };
+
+#endif // SPEAKER_MP3
+
+} // namespace AudioDecoder
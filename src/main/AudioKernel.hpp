@@ -0,0 +1,488 @@
+/*
+ * Audio Block Kernel
+ *
+ * Fixed-point sample processing shared by every Speaker playback path: channel
+ * conversion (stereo to mono, mono to stereo) and volume gain over whole blocks
+ * of 16-bit PCM. Gain is a Q15
+ * value (32768 = unity, up to 65536 = 2.0) computed once per block, so the inner
+ * loop is integer-only with saturation. Gain changes go through GainRamp, which
+ * interpolates per frame only for the frames still inside the ramp, and track
+ * changes can be blended with an equal-power crossfade from a quarter-sine table,
+ * so the per-block cost stays bounded. Resampler converts a stream to a fixed
+ * output rate with a 16.16 phase accumulator and either linear interpolation or
+ * an 8-tap, 64-phase windowed-sinc filter, carrying its history across blocks.
+ * On ESP32-S3 builds with ESP-DSP available the sub-unity gain path uses its
+ * PIE-accelerated 16-bit routines; every other target (including the ESP32-C6
+ * on the current board) uses the scalar loop.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef AUDIO_KERNEL_USE_ESP_DSP
+#if defined(CONFIG_IDF_TARGET_ESP32S3) && __has_include("esp_dsp.h")
+#define AUDIO_KERNEL_USE_ESP_DSP 1
+#else
+#define AUDIO_KERNEL_USE_ESP_DSP 0
+#endif
+#endif
+
+#if AUDIO_KERNEL_USE_ESP_DSP
+#include "esp_dsp.h"
+#endif
+
+namespace AudioKernel {
+
+  static const int32_t Q15_ONE      = 32768;
+  static const int32_t Q15_GAIN_MAX = 2 * Q15_ONE;
+
+  /*
+   * Converts a linear float gain (0.0 .. 2.0) to Q15, rounding to nearest
+   */
+  inline int32_t gainToQ15(float gain) {
+    if (gain <= 0.0f) return 0;
+    if (gain >= 2.0f) return Q15_GAIN_MAX;
+    return (int32_t)(gain * (float)Q15_ONE + 0.5f);
+  }
+
+  /*
+   * Saturates a 32-bit intermediate to the int16 range without branches on the
+   * common path (the compiler turns these into min/max on RISC-V and Xtensa)
+   */
+  inline int16_t sat16(int32_t x) {
+    x = x < -32768 ? -32768 : x;
+    x = x >  32767 ?  32767 : x;
+    return (int16_t)x;
+  }
+
+  inline int16_t scaleQ15(int32_t s, int32_t gainQ15) {
+    return sat16((s * gainQ15) >> 15);
+  }
+
+  /*
+   * Applies a Q15 gain to mono samples; out may alias in
+   */
+  inline void monoGain(const int16_t* in, int16_t* out, size_t n, int32_t gainQ15) {
+    if (gainQ15 == Q15_ONE) {
+      if (out != in) memcpy(out, in, n * sizeof(int16_t));
+      return;
+    }
+
+#if AUDIO_KERNEL_USE_ESP_DSP
+    // dsps_mulc_s16 computes (x * C) >> 15; it cannot overflow while C < 1.0
+    if (gainQ15 < Q15_ONE) {
+      dsps_mulc_s16(in, out, (int)n, (int16_t)gainQ15, 1, 1);
+      return;
+    }
+#endif
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      int16_t a = scaleQ15(in[i + 0], gainQ15);
+      int16_t b = scaleQ15(in[i + 1], gainQ15);
+      int16_t c = scaleQ15(in[i + 2], gainQ15);
+      int16_t d = scaleQ15(in[i + 3], gainQ15);
+      out[i + 0] = a;
+      out[i + 1] = b;
+      out[i + 2] = c;
+      out[i + 3] = d;
+    }
+    for (; i < n; ++i) out[i] = scaleQ15(in[i], gainQ15);
+  }
+
+  /*
+   * Downmixes interleaved stereo frames to mono ((L + R) >> 1) and applies a Q15 gain
+   * out may alias in (it is written at half the rate it is read).
+   */
+  inline void stereoToMonoGain(const int16_t* in, int16_t* out, size_t frames, int32_t gainQ15) {
+#if AUDIO_KERNEL_USE_ESP_DSP
+    if (gainQ15 <= Q15_ONE) {
+      dsps_add_s16(in, in + 1, out, (int)frames, 2, 2, 1, 1);
+      if (gainQ15 < Q15_ONE) dsps_mulc_s16(out, out, (int)frames, (int16_t)gainQ15, 1, 1);
+      return;
+    }
+#endif
+
+    size_t i = 0;
+    if (gainQ15 == Q15_ONE) {
+      for (; i < frames; ++i) {
+        out[i] = (int16_t)(((int32_t)in[2 * i] + (int32_t)in[2 * i + 1]) >> 1);
+      }
+      return;
+    }
+
+    for (; i + 4 <= frames; i += 4) {
+      const int16_t* p = in + 2 * i;
+      int16_t a = scaleQ15(((int32_t)p[0] + p[1]) >> 1, gainQ15);
+      int16_t b = scaleQ15(((int32_t)p[2] + p[3]) >> 1, gainQ15);
+      int16_t c = scaleQ15(((int32_t)p[4] + p[5]) >> 1, gainQ15);
+      int16_t d = scaleQ15(((int32_t)p[6] + p[7]) >> 1, gainQ15);
+      out[i + 0] = a;
+      out[i + 1] = b;
+      out[i + 2] = c;
+      out[i + 3] = d;
+    }
+    for (; i < frames; ++i) {
+      out[i] = scaleQ15(((int32_t)in[2 * i] + in[2 * i + 1]) >> 1, gainQ15);
+    }
+  }
+
+  /*
+   * Duplicates mono samples into interleaved stereo frames and applies a Q15 gain
+   * out must not alias in (it is written at twice the rate it is read).
+   */
+  inline void monoToStereoGain(const int16_t* in, int16_t* out, size_t frames, int32_t gainQ15) {
+    if (gainQ15 == Q15_ONE) {
+      for (size_t i = 0; i < frames; ++i) {
+        out[2 * i] = out[2 * i + 1] = in[i];
+      }
+      return;
+    }
+    for (size_t i = 0; i < frames; ++i) {
+      out[2 * i] = out[2 * i + 1] = scaleQ15(in[i], gainQ15);
+    }
+  }
+
+  /*
+   * Converts one block of 16-bit PCM with `channels` interleaved channels to
+   * gain-scaled mono. Returns the number of mono samples written.
+   */
+  inline size_t toMono(const int16_t* in, uint8_t channels, int16_t* out,
+                       size_t frames, int32_t gainQ15) {
+    if (channels == 2) {
+      stereoToMonoGain(in, out, frames, gainQ15);
+    } else {
+      monoGain(in, out, frames, gainQ15);
+    }
+    return frames;
+  }
+
+  /*
+   * Converts one block between channel layouts (1 or 2 channels each) with a Q15 gain
+   * Returns the number of int16 samples written to out. Callers that already have
+   * matching layouts at unity gain should skip this and use the input directly.
+   */
+  inline size_t convert(const int16_t* in, uint8_t inCh, int16_t* out, uint8_t outCh,
+                        size_t frames, int32_t gainQ15) {
+    if (outCh == 1) {
+      return toMono(in, inCh, out, frames, gainQ15);
+    }
+    if (inCh == 1) {
+      monoToStereoGain(in, out, frames, gainQ15);
+    } else {
+      monoGain(in, out, frames * 2, gainQ15);  // interleaved stereo, gain only
+    }
+    return frames * 2;
+  }
+
+  // ========= Gain ramps =========
+
+  // GainRamp keeps the gain with 8 extra fraction bits so slow ramps still move
+  static const int RAMP_SHIFT = 8;
+
+  /*
+   * Linear per-frame ramp from the current gain to a target gain
+   * Plain value type owned by the output task; copying it lets a second stream
+   * follow exactly the same gain curve.
+   */
+  struct GainRamp {
+    int32_t  cur    = 0;  // Q15 << RAMP_SHIFT
+    int32_t  target = 0;
+    int32_t  step   = 0;  // per frame
+    uint32_t left   = 0;  // frames until target is reached
+
+    void set(int32_t gainQ15) {
+      cur = target = gainQ15 << RAMP_SHIFT;
+      step = 0;
+      left = 0;
+    }
+
+    void rampTo(int32_t gainQ15, uint32_t frames) {
+      target = gainQ15 << RAMP_SHIFT;
+      if (frames == 0 || target == cur) {
+        set(gainQ15);
+        return;
+      }
+      step = (target - cur) / (int32_t)frames;
+      if (step == 0) step = target > cur ? 1 : -1;
+      left = frames;
+    }
+
+    bool    active() const { return left != 0; }
+    int32_t q15() const    { return cur >> RAMP_SHIFT; }
+  };
+
+  /*
+   * Same as convert(), but applies the gain of a ramp and advances it by `frames`
+   * Only the frames still inside the ramp take the per-frame path; the rest of
+   * the block goes through convert() at the settled gain.
+   */
+  inline size_t convertRamp(const int16_t* in, uint8_t inCh, int16_t* out, uint8_t outCh,
+                            size_t frames, GainRamp &r) {
+    if (!r.active()) return convert(in, inCh, out, outCh, frames, r.q15());
+
+    size_t n = frames < r.left ? frames : (size_t)r.left;
+    for (size_t i = 0; i < n; ++i) {
+      const int32_t g = r.cur >> RAMP_SHIFT;
+      r.cur += r.step;
+
+      if (inCh == 2 && outCh == 2) {
+        out[2 * i]     = scaleQ15(in[2 * i], g);
+        out[2 * i + 1] = scaleQ15(in[2 * i + 1], g);
+        continue;
+      }
+      int32_t s = inCh == 2 ? ((int32_t)in[2 * i] + in[2 * i + 1]) >> 1 : in[i];
+      if (outCh == 2) {
+        out[2 * i] = out[2 * i + 1] = scaleQ15(s, g);
+      } else {
+        out[i] = scaleQ15(s, g);
+      }
+    }
+
+    r.left -= n;
+    if (!r.left) r.cur = r.target;
+
+    if (n < frames) {
+      convert(in + n * inCh, inCh, out + n * outCh, outCh, frames - n, r.q15());
+    }
+    return frames * outCh;
+  }
+
+  // ========= Equal-power crossfade =========
+
+  // sin(k * pi / 128) in Q15 for k = 0..64 (a quarter period)
+  static const uint16_t QUARTER_SINE[65] = {
+        0,   804,  1608,  2411,  3212,  4011,  4808,  5602,
+     6393,  7180,  7962,  8740,  9512, 10279, 11039, 11793,
+    12540, 13279, 14010, 14733, 15447, 16151, 16846, 17531,
+    18205, 18868, 19520, 20160, 20788, 21403, 22006, 22595,
+    23170, 23732, 24279, 24812, 25330, 25833, 26320, 26791,
+    27246, 27684, 28106, 28511, 28899, 29269, 29622, 29957,
+    30274, 30572, 30853, 31114, 31357, 31581, 31786, 31972,
+    32138, 32286, 32413, 32522, 32610, 32679, 32729, 32758,
+    32768
+  };
+
+  static const uint32_t XFADE_PHASE_END = 64u << 16;
+
+  // Interpolated quarter sine; phase is a table index in 16.16, 0 .. XFADE_PHASE_END
+  inline int32_t quarterSineQ15(uint32_t phase) {
+    const uint32_t i = phase >> 16;
+    if (i >= 64) return QUARTER_SINE[64];
+    const int32_t a = QUARTER_SINE[i];
+    const int32_t b = QUARTER_SINE[i + 1];
+    return a + (int32_t)(((b - a) * (int32_t)(phase & 0xFFFF)) >> 16);
+  }
+
+  /*
+   * Blends an outgoing stream into an incoming one with equal-power gains
+   * Both buffers hold `frames` frames of `ch` interleaved channels; the result
+   * replaces `in`. pos/len give the position of the first frame within a fade of
+   * len frames; frames past the end of the fade keep the incoming stream only.
+   * sin^2 + cos^2 = 1 keeps the sum below 1.415 * 2^30, so int32 cannot overflow.
+   */
+  inline void crossfade(int16_t* in, const int16_t* out, size_t frames, uint8_t ch,
+                        uint32_t pos, uint32_t len) {
+    if (len == 0 || pos >= len) return;
+
+    // One division per block; the loop advances the phase incrementally
+    uint32_t phase = (uint32_t)(((uint64_t)pos << 22) / len);
+    const uint32_t step = (uint32_t)(((uint64_t)1 << 22) / len);
+
+    for (size_t i = 0; i < frames; ++i) {
+      if (phase > XFADE_PHASE_END) phase = XFADE_PHASE_END;
+      const int32_t gIn  = quarterSineQ15(phase);
+      const int32_t gOut = quarterSineQ15(XFADE_PHASE_END - phase);
+      for (uint8_t c = 0; c < ch; ++c) {
+        const size_t k = i * ch + c;
+        in[k] = sat16(((int32_t)in[k] * gIn + (int32_t)out[k] * gOut) >> 15);
+      }
+      phase += step;
+    }
+  }
+
+  // ========= Sample-rate conversion =========
+
+  enum class ResampleQuality : uint8_t {
+    Linear = 0,   // 2 taps; cheapest, some imaging above a few kHz
+    Polyphase     // 8-tap Blackman-windowed sinc, 64 interpolated phases
+  };
+
+  static const uint8_t  POLY_TAPS       = 8;
+  static const uint8_t  POLY_PHASE_BITS = 6;
+  static const uint16_t POLY_PHASES     = 1u << POLY_PHASE_BITS;
+  static const int32_t  Q14_ONE         = 16384;
+  static const uint32_t RATE_ONE        = 1u << 16;   // 16.16 step of a unity ratio
+
+  // One extra row: phase POLY_PHASES is phase 0 moved one tap, for interpolating the last phase
+  typedef int16_t PolyTable[POLY_PHASES + 1][POLY_TAPS];
+
+  // Polyphase coefficients in Q14 (the sum of |c| stays below 2, so 8 taps fit int32)
+  inline PolyTable& polyTableRef() {
+    static PolyTable t = {};
+    return t;
+  }
+
+  /*
+   * Fills the polyphase table; float math, so call once at startup, not per block
+   * cutoff is relative to the input Nyquist. Each phase is normalised to unity DC
+   * gain after rounding, so a constant input comes out unchanged.
+   */
+  inline void initPolyphase(float cutoff = 0.9f) {
+    const float PI_F = 3.14159265f;
+    const float half = POLY_TAPS / 2.0f;
+    PolyTable&  t    = polyTableRef();
+
+    for (uint16_t ph = 0; ph <= POLY_PHASES; ++ph) {
+      float c[POLY_TAPS];
+      float sum = 0.0f;
+      for (uint8_t k = 0; k < POLY_TAPS; ++k) {
+        // Distance of tap k from the output position, which sits between taps 3 and 4
+        const float d = (float)k - (half - 1.0f) - (float)ph / POLY_PHASES;
+        const float x = PI_F * cutoff * d;
+        const float sinc = fabsf(x) < 1e-6f ? 1.0f : sinf(x) / x;
+        const float w = 0.42f + 0.5f * cosf(PI_F * d / half) + 0.08f * cosf(2.0f * PI_F * d / half);
+        c[k] = sinc * (fabsf(d) < half ? w : 0.0f);
+        sum += c[k];
+      }
+      int32_t total = 0;
+      for (uint8_t k = 0; k < POLY_TAPS; ++k) {
+        t[ph][k] = (int16_t)lrintf(c[k] / sum * Q14_ONE);
+        total   += t[ph][k];
+      }
+      t[ph][POLY_TAPS / 2 - 1 + (ph >= POLY_PHASES / 2)] += (int16_t)(Q14_ONE - total);
+    }
+  }
+
+  /*
+   * Streaming sample-rate converter for interleaved 16-bit frames (1 or 2 channels)
+   * Plain value type owned by the output task; copying it forks the stream, which
+   * is how a crossfade keeps resampling the outgoing track where it left off.
+   * The last taps-1 input frames are kept as history, so block boundaries are
+   * seamless; output frame j of a fresh stream lines up with input frame j*ratio.
+   */
+  struct Resampler {
+    static const uint8_t MAX_HIST = POLY_TAPS - 1;
+
+    int16_t         hist[MAX_HIST * 2] = {};
+    uint32_t        pos     = 0;          // next output position, 16.16 frames from hist[0]
+    uint32_t        step    = RATE_ONE;   // input frames per output frame, 16.16
+    uint8_t         ch      = 1;
+    uint8_t         taps    = 2;
+    ResampleQuality quality = ResampleQuality::Linear;
+
+    uint8_t histLen() const { return taps - 1; }
+    bool    unity() const   { return step == RATE_ONE; }
+
+    /*
+     * Starts a new stream: clears the history (silence before the first frame)
+     */
+    void reset(uint32_t inRate, uint32_t outRate, uint8_t channels, ResampleQuality q) {
+      quality = q;
+      ch      = channels == 2 ? 2 : 1;
+      taps    = q == ResampleQuality::Polyphase ? POLY_TAPS : 2;
+      step    = (inRate && outRate) ? (uint32_t)(((uint64_t)inRate << 16) / outRate) : RATE_ONE;
+      if (step == 0) step = 1;
+      memset(hist, 0, sizeof(hist));
+      // Output position sits taps/2-1 frames into the window: start on the first new frame
+      pos = (uint32_t)(histLen() - (taps / 2 - 1)) << 16;
+    }
+
+    /*
+     * Keeps the history current while the stream is played without resampling,
+     * so the resampler can take over mid-stream (a crossfade forks it)
+     */
+    void track(const int16_t* in, size_t frames) {
+      const size_t h = histLen();
+      if (frames >= h) {
+        memcpy(hist, in + (frames - h) * ch, h * ch * sizeof(int16_t));
+      } else {
+        memmove(hist, hist + frames * ch, (h - frames) * ch * sizeof(int16_t));
+        memcpy(hist + (h - frames) * ch, in, frames * ch * sizeof(int16_t));
+      }
+    }
+
+    // One output frame from the window starting at w
+    inline void interp(const int16_t* w, uint32_t frac, int16_t* out) const {
+      if (quality == ResampleQuality::Linear) {
+        const int32_t f = (int32_t)(frac >> 1);   // Q15 keeps (b - a) * f inside int32
+        for (uint8_t c = 0; c < ch; ++c) {
+          const int32_t a = w[c];
+          const int32_t b = w[ch + c];
+          out[c] = (int16_t)(a + (((b - a) * f) >> 15));
+        }
+        return;
+      }
+      // Coefficients interpolated between the two nearest phases, once per frame
+      const uint32_t FRAC_BITS = 16 - POLY_PHASE_BITS;
+      const int16_t* k0 = polyTableRef()[frac >> FRAC_BITS];
+      const int16_t* k1 = k0 + POLY_TAPS;
+      const int32_t  f  = (int32_t)(frac & ((1u << FRAC_BITS) - 1));
+      int16_t k[POLY_TAPS];
+      for (uint8_t i = 0; i < POLY_TAPS; ++i) {
+        k[i] = (int16_t)(k0[i] + (((k1[i] - k0[i]) * f) >> FRAC_BITS));
+      }
+      for (uint8_t c = 0; c < ch; ++c) {
+        const int16_t* s = w + c;
+        int32_t acc = Q14_ONE / 2;
+        acc += (int32_t)s[0 * ch] * k[0] + (int32_t)s[1 * ch] * k[1];
+        acc += (int32_t)s[2 * ch] * k[2] + (int32_t)s[3 * ch] * k[3];
+        acc += (int32_t)s[4 * ch] * k[4] + (int32_t)s[5 * ch] * k[5];
+        acc += (int32_t)s[6 * ch] * k[6] + (int32_t)s[7 * ch] * k[7];
+        out[c] = sat16(acc >> 14);
+      }
+    }
+
+    /*
+     * Resamples up to `frames` input frames into at most outCap output frames
+     * Returns the frames written; `used` is how many input frames were consumed,
+     * so a call that stops on outCap is continued with in + used * ch. Once all
+     * input is used, the frames still needed by later windows sit in the history.
+     */
+    size_t process(const int16_t* in, size_t frames, int16_t* out, size_t outCap, size_t& used) {
+      const uint32_t h        = histLen();
+      size_t         produced = 0;
+
+      // Windows that start in the history run over history + the first input frames
+      int16_t       scratch[(MAX_HIST + POLY_TAPS) * 2];
+      const uint32_t m = frames < taps ? (uint32_t)frames : taps;
+      memcpy(scratch, hist, h * ch * sizeof(int16_t));
+      memcpy(scratch + h * ch, in, m * ch * sizeof(int16_t));
+      while (produced < outCap) {
+        const uint32_t ip = pos >> 16;
+        if (ip >= h || ip + taps > h + m) break;
+        interp(scratch + ip * ch, pos & 0xFFFF, out + produced * ch);
+        ++produced;
+        pos += step;
+      }
+
+      // The rest read straight from the input
+      while (produced < outCap) {
+        const uint32_t ip = pos >> 16;
+        if (ip < h || ip - h + taps > frames) break;
+        interp(in + (ip - h) * ch, pos & 0xFFFF, out + produced * ch);
+        ++produced;
+        pos += step;
+      }
+
+      // Drop the input frames no later window needs; the next h become the history
+      const uint32_t ip = pos >> 16;
+      const uint32_t u  = ip < frames ? ip : (uint32_t)frames;
+      int16_t next[MAX_HIST * 2];
+      for (uint32_t j = 0; j < h; ++j) {
+        const uint32_t v = u + j;
+        const int16_t* src = v < h ? hist + v * ch : in + (v - h) * ch;
+        for (uint8_t c = 0; c < ch; ++c) next[j * ch + c] = src[c];
+      }
+      memcpy(hist, next, h * ch * sizeof(int16_t));
+      pos -= u << 16;
+      used = u;
+      return produced;
+    }
+  };
+
+} // namespace AudioKernel
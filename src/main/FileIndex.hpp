@@ -0,0 +1,273 @@
+/*
+ * SD Directory Index
+ *
+ * RAM copy of the SD card root directory: name, size and, for PCM WAV files,
+ * sample rate, channels and duration. Built once at boot and kept current by
+ * the web upload/delete handlers, so file listings (and playlist building)
+ * never have to walk the card. Entries are kept sorted by name, which makes
+ * offset/limit pagination stable.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Logger.hpp>
+#include <SdBus.hpp>
+#include <Speaker.hpp>
+
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/semphr.h"
+}
+
+// Maximum number of files tracked; further files are left out of the index
+#ifndef FILE_INDEX_MAX
+#define FILE_INDEX_MAX 256
+#endif
+
+namespace FileIndex {
+
+  static const size_t NAME_MAX_LEN = 63;
+
+  struct Entry {
+    char     name[NAME_MAX_LEN + 1];  // without the leading '/'
+    uint32_t size       = 0;
+    uint32_t sampleRate = 0;          // 0 if not a PCM WAV file
+    uint32_t durationMs = 0;
+    uint8_t  channels   = 0;
+    uint8_t  bits       = 0;
+
+    bool isWav() const { return sampleRate != 0; }
+  };
+
+  // ------- internal shared state --------
+
+  inline Entry* entries() {
+    static Entry e[FILE_INDEX_MAX];
+    return e;
+  }
+
+  inline size_t& countRef() {
+    static size_t n = 0;
+    return n;
+  }
+
+  // Guards the entries; inserts move up to the whole table, so this is a mutex
+  inline SemaphoreHandle_t tableLockRef() {
+    static SemaphoreHandle_t m = xSemaphoreCreateMutex();
+    return m;
+  }
+
+  // Guards only countRef()/versionRef(), so count() stays cheap
+  inline portMUX_TYPE& lockRef() {
+    static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    return mux;
+  }
+
+  // Bumped on every change, so readers can tell their snapshot is stale
+  inline volatile uint32_t& versionRef() {
+    static volatile uint32_t v = 0;
+    return v;
+  }
+
+  // -------- helpers --------
+
+  class TableLock {
+  public:
+    TableLock()  { xSemaphoreTake(tableLockRef(), portMAX_DELAY); }
+    ~TableLock() { xSemaphoreGive(tableLockRef()); }
+
+    TableLock(const TableLock&) = delete;
+    TableLock& operator=(const TableLock&) = delete;
+  };
+
+  // Publishes a new entry count and bumps the version
+  inline void publish(size_t n) {
+    portENTER_CRITICAL(&lockRef());
+    countRef()   = n;
+    versionRef() = versionRef() + 1;
+    portEXIT_CRITICAL(&lockRef());
+  }
+
+  inline const char* stripSlash(const char* name) {
+    return (name && name[0] == '/') ? name + 1 : name;
+  }
+
+  /*
+   * Fills an entry from an open file; reads the WAV or MP3 header if there is one
+   * Caller holds the SD bus.
+   */
+  inline void describe(File& f, const char* name, Entry& e) {
+    strncpy(e.name, name, NAME_MAX_LEN);
+    e.name[NAME_MAX_LEN] = '\0';
+    e.size       = (uint32_t)f.size();
+    e.sampleRate = 0;
+    e.durationMs = 0;
+    e.channels   = 0;
+    e.bits       = 0;
+
+    Speaker::WavInfo info;
+    if (!f.isDirectory() && Speaker::parseTrackHeader(f, info) &&
+        info.sampleRate && info.numChannels) {
+      e.sampleRate = info.sampleRate;
+      e.channels   = (uint8_t)info.numChannels;
+      e.bits       = (uint8_t)info.bitsPerSample;
+      e.durationMs = Speaker::durationMs(info);
+    }
+  }
+
+  // Index of the first entry not less than name; call with the table lock held
+  inline size_t lowerBound(const char* name) {
+    size_t lo = 0, hi = countRef();
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (strcmp(entries()[mid].name, name) < 0) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  /*
+   * Inserts or replaces an entry, keeping the index sorted
+   * Returns false if the index is full.
+   */
+  inline bool put(const Entry& e) {
+    TableLock lock;
+    Entry*  list = entries();
+    size_t  n    = countRef();
+    size_t  i    = lowerBound(e.name);
+    if (i < n && strcmp(list[i].name, e.name) == 0) {
+      list[i] = e;
+    } else if (n < FILE_INDEX_MAX) {
+      memmove(&list[i + 1], &list[i], (n - i) * sizeof(Entry));
+      list[i] = e;
+      ++n;
+    } else {
+      return false;
+    }
+    publish(n);
+    return true;
+  }
+
+  inline int compareNames(const void* a, const void* b) {
+    return strcmp(((const Entry*)a)->name, ((const Entry*)b)->name);
+  }
+
+  // -------- public API --------
+
+  /*
+   * Rebuilds the index from the SD root directory
+   * Reads a few directory entries per SD bus acquisition so boot-time indexing
+   * does not hold the card for long. Entries are appended as found and sorted
+   * once at the end. Returns the number of files indexed.
+   */
+  inline size_t build() {
+    TableLock lock;
+    publish(0);
+
+    if (!SdBus::acquire(SdBus::Client::Web)) return 0;
+    File root = SD.open("/");
+    SdBus::release(SdBus::Client::Web);
+    if (!root) {
+      Logger::log(Logger::Level::Error, "FileIndex: failed to open SD root");
+      LOGGER_DEBUG(Serial.println("FileIndex: failed to open SD root"));
+      return 0;
+    }
+
+    size_t n       = 0;
+    size_t skipped = 0;
+    bool   done    = false;
+    while (!done) {
+      SdBus::acquire(SdBus::Client::Web);
+      for (uint8_t batch = 0; batch < 8; ++batch) {
+        File f = root.openNextFile();
+        if (!f) {
+          done = true;
+          break;
+        }
+        const char* name = stripSlash(f.name());
+        // Dot files are hidden, including an interrupted upload's temp file
+        if (f.isDirectory() || name[0] == '.' || strlen(name) > NAME_MAX_LEN) {
+          f.close();
+          ++skipped;
+          continue;
+        }
+        if (n == FILE_INDEX_MAX) {
+          f.close();
+          ++skipped;
+          continue;
+        }
+        describe(f, name, entries()[n++]);
+        f.close();
+      }
+      SdBus::release(SdBus::Client::Web);
+    }
+
+    SdBus::acquire(SdBus::Client::Web);
+    root.close();
+    SdBus::release(SdBus::Client::Web);
+
+    qsort(entries(), n, sizeof(Entry), compareNames);
+    publish(n);
+
+    Logger::logf(Logger::Level::Info, "FileIndex: %u files indexed, %u skipped",
+                 (unsigned)n, (unsigned)skipped);
+    return n;
+  }
+
+  /*
+   * Re-reads one file into the index, e.g. after an upload
+   * Caller holds the SD bus. Returns false if the file is missing or does not fit.
+   */
+  inline bool refreshLocked(const char* path) {
+    const char* name = stripSlash(path);
+    if (strlen(name) > NAME_MAX_LEN) return false;
+
+    File f = SD.open(path);
+    if (!f) return false;
+    Entry e;
+    describe(f, name, e);
+    f.close();
+    return put(e);
+  }
+
+  /*
+   * Drops a file from the index, e.g. after a delete
+   */
+  inline void remove(const char* path) {
+    const char* name = stripSlash(path);
+    TableLock lock;
+    Entry* list = entries();
+    size_t n    = countRef();
+    size_t i    = lowerBound(name);
+    if (i < n && strcmp(list[i].name, name) == 0) {
+      memmove(&list[i], &list[i + 1], (n - i - 1) * sizeof(Entry));
+      publish(n - 1);
+    }
+  }
+
+  inline size_t count() {
+    portENTER_CRITICAL(&lockRef());
+    size_t n = countRef();
+    portEXIT_CRITICAL(&lockRef());
+    return n;
+  }
+
+  inline uint32_t version() {
+    return versionRef();
+  }
+
+  /*
+   * Copies entry i into out; returns false past the end
+   */
+  inline bool get(size_t i, Entry& out) {
+    TableLock lock;
+    if (i >= countRef()) return false;
+    out = entries()[i];
+    return true;
+  }
+
+} // namespace FileIndex
@@ -5,19 +5,40 @@
  * Uses timing information and sensor activation patterns to distinguish between
  * left/right swipes, up/down swipes, and tap gestures. The classifier looks at which
  * sensors were triggered first and the velocity of the hand movement.
+ * Two backends sit behind classifyEpisode(): the rule cascade below and the
+ * int8 decision tree in GestureTree.hpp, selectable at build or run time.
  */
 
 #pragma once
 #include <Arduino.h>
 #include "GestureTypes.hpp"
 #include "GesturePreprocessor.hpp"
+#include "GestureTree.hpp"
+
+// Backend used by classifyEpisode() at boot: 0 = rule cascade, 1 = decision tree
+#ifndef GESTURE_CLASSIFIER_BACKEND
+#define GESTURE_CLASSIFIER_BACKEND 0
+#endif
+
+enum class ClassifierBackend : uint8_t {
+    Rules = 0,
+    Tree  = 1
+};
+
+inline volatile ClassifierBackend& classifierBackendRef() {
+    static volatile ClassifierBackend b = (ClassifierBackend)GESTURE_CLASSIFIER_BACKEND;
+    return b;
+}
+
+inline void setClassifierBackend(ClassifierBackend b) { classifierBackendRef() = b; }
+inline ClassifierBackend classifierBackend()          { return classifierBackendRef(); }
 
 /*
- * Classifies a gesture episode into a recognized direction
+ * Rule-cascade backend: classifies a gesture episode into a recognized direction
  * Analyzes sensor timing, swing magnitude, and velocity to determine the gesture type.
  * Returns the classified gesture direction or None if no clear gesture is detected.
  */
-GestureDir classifyEpisode(const GestureEpisode& ep) {
+inline GestureDir classifyRules(const GestureEpisode& ep) {
     auto swingOf = [&](int i)->uint16_t {
         if (ep.dMin[i] == 0xFFFF) return 0;
         return ep.dMax[i] - ep.dMin[i];
@@ -31,8 +52,6 @@ GestureDir classifyEpisode(const GestureEpisode& ep) {
     bool activeR = (swingR > 0);
     bool activeT = (swingT > 0);
 
-    uint32_t dur = ep.tEndMs - ep.tStartMs;
-
     int16_t maxV = ep.maxApproachVel[0];
     if (ep.maxApproachVel[1] > maxV) maxV = ep.maxApproachVel[1];
     if (ep.maxApproachVel[2] > maxV) maxV = ep.maxApproachVel[2];
@@ -48,18 +67,23 @@ GestureDir classifyEpisode(const GestureEpisode& ep) {
 
     // Detect LEFT/RIGHT swipe gestures
     // A horizontal swipe is detected by checking which sensor (left or right) sees
-    // the hand first, with a time gap between activations indicating direction
-    const uint32_t GAP_MIN = 5;
-    const uint32_t GAP_MAX = 1500;
+    // the hand first, with a time gap between activations indicating direction.
+    // Gaps come from per-sensor sample times, so they are resolved in microseconds.
+    const int32_t GAP_MIN_US = 5 * 1000;
+    const int32_t GAP_MAX_US = 1500 * 1000;
 
-    uint32_t tL = ep.firstSeenMs[0];
-    uint32_t tR = ep.firstSeenMs[1];
+    auto inGap = [&](int32_t gapUs)->bool {
+        return gapUs >= GAP_MIN_US && gapUs <= GAP_MAX_US;
+    };
 
-    if (activeL && activeR && tL && tR && (swingL > 5 || swingR > 5) && !activeT) {
-        if (tR > tL && (tR - tL) >= GAP_MIN && (tR - tL) <= GAP_MAX) {
+    // > 0 when L saw the hand before R
+    int32_t gapLR = (int32_t)(ep.firstSeenUs[1] - ep.firstSeenUs[0]);
+
+    if (activeL && activeR && ep.seen(0) && ep.seen(1) && (swingL > 5 || swingR > 5) && !activeT) {
+        if (inGap(gapLR)) {
             return GestureDir::Right;
         }
-        if (tL > tR && (tL - tR) >= GAP_MIN && (tL - tR) <= GAP_MAX) {
+        if (inGap(-gapLR)) {
             return GestureDir::Left;
         }
     }
@@ -68,19 +92,25 @@ GestureDir classifyEpisode(const GestureEpisode& ep) {
     // Vertical swipes are detected by comparing when the bottom sensors (left/right)
     // versus the top sensor first detect the hand. The timing difference indicates
     // whether the hand moved upward or downward through the sensor field
-    uint32_t tBottom = 0;
-    if (activeL && ep.firstSeenMs[0]) tBottom = ep.firstSeenMs[0];
-    if (activeR && ep.firstSeenMs[1]) {
-        if (tBottom == 0 || ep.firstSeenMs[1] < tBottom)
-            tBottom = ep.firstSeenMs[1];
+    bool     haveBottom = false;
+    uint32_t tBottom    = 0;
+    if (activeL && ep.seen(0)) {
+        tBottom    = ep.firstSeenUs[0];
+        haveBottom = true;
+    }
+    if (activeR && ep.seen(1)) {
+        if (!haveBottom || (int32_t)(ep.firstSeenUs[1] - tBottom) < 0)
+            tBottom = ep.firstSeenUs[1];
+        haveBottom = true;
     }
-    uint32_t tTop = ep.firstSeenMs[2];
 
-    if (tBottom && tTop && (swingL > 5 || swingR > 5 || swingT > 5)) {
-        if (tTop > tBottom && (tTop - tBottom) >= GAP_MIN && (tTop - tBottom) <= GAP_MAX) {
+    if (haveBottom && ep.seen(2) && (swingL > 5 || swingR > 5 || swingT > 5)) {
+        // > 0 when the bottom pair saw the hand before the top sensor
+        int32_t gapBT = (int32_t)(ep.firstSeenUs[2] - tBottom);
+        if (inGap(gapBT)) {
             return GestureDir::Up;
         }
-        if (tBottom > tTop && (tBottom - tTop) >= GAP_MIN && (tBottom - tTop) <= GAP_MAX) {
+        if (inGap(-gapBT)) {
             return GestureDir::Down;
         }
     }
@@ -88,3 +118,12 @@ GestureDir classifyEpisode(const GestureEpisode& ep) {
     return GestureDir::None;
 }
 
+/*
+ * Classifies a gesture episode with the selected backend
+ */
+inline GestureDir classifyEpisode(const GestureEpisode& ep) {
+    switch (classifierBackend()) {
+        case ClassifierBackend::Tree: return GestureTree::classify(ep);
+        default:                      return classifyRules(ep);
+    }
+}
@@ -17,8 +17,9 @@
  * to enable accurate gesture classification.
  */
 struct GestureEpisode {
-    uint32_t tStartMs = 0;
-    uint32_t tEndMs   = 0;
+    // micros() timestamps; compare with wrap-safe differences
+    uint32_t tStartUs = 0;
+    uint32_t tEndUs   = 0;
 
     uint16_t dMin[3]  = { 0xFFFF, 0xFFFF, 0xFFFF };
     uint16_t dMax[3]  = { 0, 0, 0 };
@@ -26,28 +27,95 @@ struct GestureEpisode {
     uint8_t  sampleCount   = 0;
     uint8_t  winnerChanges = 0;
 
-    // when each sensor first/last saw the object in this episode
-    uint32_t firstSeenMs[3] = { 0, 0, 0 };
-    uint32_t lastSeenMs[3]  = { 0, 0, 0 };
+    // bit i set once sensor i has seen the object in this episode
+    uint8_t  seenMask = 0;
+
+    // when each sensor first/last saw the object, from that sensor's own sample time
+    uint32_t firstSeenUs[3] = { 0, 0, 0 };
+    uint32_t lastSeenUs[3]  = { 0, 0, 0 };
 
     // peak approach velocity (mm/s) toward sensors per sensor
     int16_t  maxApproachVel[3] = { 0, 0, 0 };
+
+    // time between the two samples that produced maxApproachVel
+    uint32_t maxApproachDtUs[3] = { 0, 0, 0 };
+
+    // ---- running features, updated in O(1) per sample by appendSample() ----
+
+    // sample time at which dMin[i] was reached
+    uint32_t tMinUs[3] = { 0, 0, 0 };
+
+    // sum of (sample time - tStartUs) over the samples where sensor i saw the object
+    uint32_t seenSumUs[3] = { 0, 0, 0 };
+    uint8_t  seenCount[3] = { 0, 0, 0 };
+
+    // integrals of approach (toward the sensor) and recede velocity, i.e. mm travelled
+    uint16_t approachMm[3] = { 0, 0, 0 };
+    uint16_t recedeMm[3]   = { 0, 0, 0 };
+
+    /*
+     * Downsampled trajectory: nearest filtered distance per sensor over each run
+     * of trajStride samples (0xFFFF = not seen). When all TRAJ_LEN points are used,
+     * neighbouring points are merged and the stride doubles, so the whole episode
+     * always fits in fixed storage.
+     */
+    static const uint8_t TRAJ_LEN = 16;
+    uint16_t traj[TRAJ_LEN][3] = {};
+    uint8_t  trajLen    = 0;
+    uint8_t  trajStride = 1;
+    uint8_t  trajFill   = 0;   // samples already in the last point
+
+    bool     seen(int i)  const { return (seenMask >> i) & 1u; }
+    uint32_t durationUs() const { return tEndUs - tStartUs; }
+    uint32_t durationMs() const { return durationUs() / 1000u; }
+
+    // mean time at which sensor i saw the object, 0 if it never did
+    uint32_t centroidUs(int i) const {
+        return seenCount[i] ? tStartUs + seenSumUs[i] / seenCount[i] : 0;
+    }
 };
 
 class GesturePreprocessor {
 public:
     GesturePreprocessor() { reset(); }
 
+    /*
+     * Enables early decisions: update() returns Provisional as soon as the L/R
+     * or bottom/top ordering of the episode is unambiguous, and Cancelled if
+     * later samples contradict it or the episode is rejected in the end.
+     * Otherwise EpisodeReady follows at the end.
+     */
+    void setStreaming(bool on) { streaming = on; }
+    bool isStreaming() const   { return streaming; }
+
     /*
      * Processes raw sensor readings and updates the gesture detection state machine
      * Takes distance readings from three sensors, applies filtering and validation,
      * then determines if a gesture episode is starting, ongoing, or complete.
      * Returns EpisodeReady when a gesture has been captured and is ready for classification.
+     * All three readings share one millisecond timestamp; prefer the per-sensor overload.
      */
     GestureEvent update(uint16_t d0, uint16_t d1, uint16_t d2, uint32_t nowMs) {
-        uint16_t raw[3] = { d0, d1, d2 };
+        const uint16_t d[3]   = { d0, d1, d2 };
+        const uint32_t nowUs  = nowMs * 1000u;
+        const uint32_t tUs[3] = { nowUs, nowUs, nowUs };
+        return update(d, tUs);
+    }
+
+    /*
+     * Same as above, but with each sensor's own micros() sample time
+     * Episode first/last-seen times and velocities use the per-sensor times, so
+     * sensor ordering is resolved at sample resolution instead of frame resolution.
+     * The state machine itself advances on the newest timestamp of the frame.
+     */
+    GestureEvent update(const uint16_t d[3], const uint32_t tUs[3]) {
+        uint16_t raw[3] = { d[0], d[1], d[2] };
         filterDistances(raw);
 
+        uint32_t nowUs = tUs[0];
+        if ((int32_t)(tUs[1] - nowUs) > 0) nowUs = tUs[1];
+        if ((int32_t)(tUs[2] - nowUs) > 0) nowUs = tUs[2];
+
         uint16_t zMinFrame = 0xFFFF;
         for (int i = 0; i < 3; ++i) {
             if (inBand(filt[i]) && filt[i] < zMinFrame) {
@@ -65,7 +133,7 @@ public:
             }
         }
 
-        bool anyValid = valid[0] || valid[1] || valid[2];[2];
+        bool anyValid = valid[0] || valid[1] || valid[2];
 
         switch (state) {
             case State::Idle:
@@ -73,8 +141,8 @@ public:
                 if (anyValid) {
                     if (++enterCount >= ENTER_COUNT) {
                         LOGGER_DEBUG(Serial.println("[FSM] Idle -> Tracking"));
-                        startEpisode(nowMs);
-                        appendSample(valid, nowMs);
+                        startEpisode(nowUs);
+                        appendSample(valid, tUs);
                         state = State::Tracking;
                         enterCount = 0;
                     }
@@ -82,43 +150,45 @@ public:
                     enterCount = 0;
                 }
                 exitCount = 0;
-                break;eak;
+                break;
 
             case State::Tracking:
                 if (anyValid) {
                     exitCount = 0;
-                    appendSample(valid, nowMs);
+                    appendSample(valid, tUs);
 
-                    if (nowMs - ep.tStartMs > MAX_EPISODE_MS) {
+                    if (nowUs - ep.tStartUs <= MAX_EPISODE_MS * 1000u) {
+                        if (streaming) return streamDecision(nowUs);
+                    } else {
                         LOGGER_DEBUG(Serial.println("[FSM] Tracking timeout -> finalizeEpisode()"));
-                        if (finalizeEpisode(nowMs)) {
+                        if (finalizeEpisode(nowUs)) {
                             LOGGER_DEBUG(Serial.println("[FSM] Tracking -> Cooldown (timeout)"));
                             state = State::Cooldown;
-                            cooldownUntil = nowMs + COOLDOWN_MS;
+                            cooldownUntilUs = nowUs + COOLDOWN_MS * 1000u;
                             return GestureEvent::EpisodeReady;
                         } else {
                             LOGGER_DEBUG(Serial.println("[FSM] finalize FAIL -> Idle"));
-                            reset();
+                            return abandonEpisode();
                         }
                     }
                 } else {
                     if (++exitCount >= EXIT_COUNT) {
                         LOGGER_DEBUG(Serial.println("[FSM] Tracking exitCount reached -> finalizeEpisode()"));
-                        if (finalizeEpisode(nowMs)) {
+                        if (finalizeEpisode(nowUs)) {
                             LOGGER_DEBUG(Serial.println("[FSM] Tracking -> Cooldown (hand left)"));
                             state = State::Cooldown;
-                            cooldownUntil = nowMs + COOLDOWN_MS;
+                            cooldownUntilUs = nowUs + COOLDOWN_MS * 1000u;
                             return GestureEvent::EpisodeReady;
                         } else {
                             LOGGER_DEBUG(Serial.println("[FSM] finalize FAIL -> Idle"));
-                            reset();
+                            return abandonEpisode();
                         }
                     }
                 }
                 break;
 
             case State::Cooldown:
-                if (!anyValid && nowMs >= cooldownUntil) {
+                if (!anyValid && (int32_t)(nowUs - cooldownUntilUs) >= 0) {
                     LOGGER_DEBUG(Serial.println("[FSM] Cooldown -> Idle"));
                     reset();
                 }
@@ -135,6 +205,20 @@ public:
      */
     const GestureEpisode &lastEpisode() const { return ep; }
 
+    /*
+     * Returns the early decision of the current (or just completed) episode
+     * dir is None if streaming is off or no early decision was made.
+     */
+    const ProvisionalDecision &provisional() const { return prov; }
+
+    /*
+     * Returns true if a distance lies in the gesture band
+     * Also used by the sensor task to wake full-rate ranging from the idle scan.
+     */
+    static bool inBand(uint16_t d) {
+        return d >= D_MIN_MM && d <= D_MAX_MM;
+    }
+
 private:
     enum class State { Idle, Tracking, Cooldown };
 
@@ -158,13 +242,23 @@ private:
 
     static constexpr uint32_t COOLDOWN_MS     = 5;
 
+    // Early decisions: confidence grows from 0 at STREAM_GAP_MIN_US of first-seen
+    // gap to 100 at STREAM_GAP_FULL_US; below STREAM_MIN_CONFIDENCE nothing fires
+    // (a slightly skewed tap can show ~20 ms between L and R)
+    static constexpr uint32_t STREAM_GAP_MIN_US     = 10 * 1000;
+    static constexpr uint32_t STREAM_GAP_FULL_US    = 50 * 1000;
+    static constexpr uint32_t STREAM_GAP_MAX_US     = 1500 * 1000;
+    static constexpr uint8_t  STREAM_MIN_CONFIDENCE = 60;
+    // Top-sensor swing that contradicts an early Left/Right
+    static constexpr uint16_t STREAM_T_SWING_MM     = 5;
+
     // how many consecutive invalid frames before we clear filt[i]
     static constexpr uint8_t  INVALID_RESET_COUNT = 50;
 
     State    state;
     uint8_t  enterCount;
     uint8_t  exitCount;
-    uint32_t cooldownUntil;
+    uint32_t cooldownUntilUs;
 
     uint16_t rawHist[3][3];
     uint8_t  rawIdx;
@@ -173,15 +267,18 @@ private:
 
     // For velocity estimation
     uint16_t lastFiltForVel[3] = { 0, 0, 0 };
-    uint32_t lastTimeForVel[3] = { 0, 0, 0 };
+    uint32_t lastTimeForVelUs[3] = { 0, 0, 0 };
 
     GestureEpisode ep;
     int8_t  lastWinner;
 
+    bool                streaming = false;
+    ProvisionalDecision prov;
+
     void reset() {
         state = State::Idle;
         enterCount = exitCount = 0;
-        cooldownUntil = 0;
+        cooldownUntilUs = 0;
         rawIdx = 0;
         lastWinner = -1;
 
@@ -189,21 +286,37 @@ private:
             filt[i] = 0;
             invalidCount[i] = 0;
             lastFiltForVel[i] = 0;
-            lastTimeForVel[i] = 0;
+            lastTimeForVelUs[i] = 0;
             for (int j = 0; j < 3; ++j) rawHist[i][j] = 0;
             ep.dMin[i] = 0xFFFF;
             ep.dMax[i] = 0;
-            ep.firstSeenMs[i]    = 0;
-            ep.lastSeenMs[i]     = 0;
-            ep.maxApproachVel[i] = 0;
+            ep.firstSeenUs[i]     = 0;
+            ep.lastSeenUs[i]      = 0;
+            ep.maxApproachVel[i]  = 0;
+            ep.maxApproachDtUs[i] = 0;
         }
         ep.sampleCount   = 0;
         ep.winnerChanges = 0;
-        ep.tStartMs = ep.tEndMs = 0;
+        ep.seenMask      = 0;
+        ep.tStartUs = ep.tEndUs = 0;
+        resetFeatures();
+        prov = ProvisionalDecision();
     }
 
-    static bool inBand(uint16_t d) {
-        return d >= D_MIN_MM && d <= D_MAX_MM;
+    /*
+     * Clears the running features of the current episode
+     */
+    void resetFeatures() {
+        for (int i = 0; i < 3; ++i) {
+            ep.tMinUs[i]     = 0;
+            ep.seenSumUs[i]  = 0;
+            ep.seenCount[i]  = 0;
+            ep.approachMm[i] = 0;
+            ep.recedeMm[i]   = 0;
+        }
+        ep.trajLen    = 0;
+        ep.trajStride = 1;
+        ep.trajFill   = 0;
     }
 
     static uint16_t median3(uint16_t a, uint16_t b, uint16_t c) {
@@ -285,17 +398,21 @@ private:
      * Initializes a new gesture episode when hand enters sensor field
      * Resets all tracking variables to prepare for recording the new gesture.
      */
-    void startEpisode(uint32_t nowMs) {
-        ep.tStartMs = nowMs;
+    void startEpisode(uint32_t nowUs) {
+        ep.tStartUs = nowUs;
         ep.sampleCount   = 0;
         ep.winnerChanges = 0;
+        ep.seenMask      = 0;
         for (int i = 0; i < 3; ++i) {
             ep.dMin[i] = 0xFFFF;
             ep.dMax[i] = 0;
-            ep.firstSeenMs[i]    = 0;
-            ep.lastSeenMs[i]     = 0;
-            ep.maxApproachVel[i] = 0;
+            ep.firstSeenUs[i]     = 0;
+            ep.lastSeenUs[i]      = 0;
+            ep.maxApproachVel[i]  = 0;
+            ep.maxApproachDtUs[i] = 0;
         }
+        resetFeatures();
+        prov = ProvisionalDecision();
         lastWinner = -1;
     }
 
@@ -304,7 +421,7 @@ private:
      * Records timing, velocity, and distance information for each active sensor
      * to build up a complete picture of the hand movement.
      */
-    void appendSample(const bool valid[3], uint32_t nowMs) {
+    void appendSample(const bool valid[3], const uint32_t tUs[3]) {
         ep.sampleCount++;
 
         uint16_t best = 0xFFFF;
@@ -315,31 +432,46 @@ private:
 
             if (valid[i]) {
                 // mark first/last seen times for this sensor in this episode
-                if (ep.firstSeenMs[i] == 0) ep.firstSeenMs[i] = nowMs;
-                ep.lastSeenMs[i] = nowMs;
+                if (!ep.seen(i)) {
+                    ep.firstSeenUs[i] = tUs[i];
+                    ep.seenMask |= (uint8_t)(1u << i);
+                }
+                ep.lastSeenUs[i] = tUs[i];
+
+                uint32_t relUs = tUs[i] - ep.tStartUs;
+                if (relUs < 0x80000000u) ep.seenSumUs[i] += relUs;  // sample times before the start count as 0
+                ep.seenCount[i]++;
 
                 // compute per-sample approach velocity if we have a previous sample
-                if (lastFiltForVel[i] != 0 && d != 0 && lastTimeForVel[i] != 0) {
-                    uint32_t dt = nowMs - lastTimeForVel[i];
-                    if (dt > 0) {
-                        int16_t dv = (int16_t)lastFiltForVel[i] - (int16_t)d; // >0 = moving closer
+                if (lastFiltForVel[i] != 0 && d != 0) {
+                    uint32_t dtUs = tUs[i] - lastTimeForVelUs[i];
+                    if (dtUs > 0 && dtUs < 0x80000000u) {
+                        int32_t dv = (int32_t)lastFiltForVel[i] - (int32_t)d; // >0 = moving closer
+                        accumulate(dv > 0 ? ep.approachMm[i] : ep.recedeMm[i], dv > 0 ? dv : -dv);
                         if (dv > 0) {
-                            int16_t v = (int16_t)((dv * 1000) / (int32_t)dt); // mm/s
-                            if (v > ep.maxApproachVel[i]) ep.maxApproachVel[i] = v;
+                            int32_t v = (int32_t)(((int64_t)dv * 1000000) / (int64_t)dtUs); // mm/s
+                            if (v > 32767) v = 32767;
+                            if (v > ep.maxApproachVel[i]) {
+                                ep.maxApproachVel[i]  = (int16_t)v;
+                                ep.maxApproachDtUs[i] = dtUs;
+                            }
                         }
                     }
                 }
 
                 // update radial swing stats
-                if (d < ep.dMin[i]) ep.dMin[i] = d;
+                if (d < ep.dMin[i]) {
+                    ep.dMin[i]   = d;
+                    ep.tMinUs[i] = tUs[i];
+                }
                 if (d > ep.dMax[i]) ep.dMax[i] = d;
 
                 if (d < best) { best = d; winner = i; }
             }
 
             // update velocity history for next time
-            lastFiltForVel[i] = d;
-            lastTimeForVel[i] = nowMs;
+            lastFiltForVel[i]   = d;
+            lastTimeForVelUs[i] = tUs[i];
         }
 
         if (winner >= 0) {
@@ -348,6 +480,132 @@ private:
             }
             lastWinner = winner;
         }
+
+        appendTrajectory(valid);
+    }
+
+    static void accumulate(uint16_t &sum, int32_t v) {
+        uint32_t t = (uint32_t)sum + (uint32_t)v;
+        sum = t > 0xFFFF ? 0xFFFF : (uint16_t)t;
+    }
+
+    /*
+     * Folds the current sample into the downsampled trajectory
+     * Merging on overflow touches TRAJ_LEN points at most once per doubling of
+     * the episode, so the cost per sample stays bounded.
+     */
+    void appendTrajectory(const bool valid[3]) {
+        const uint8_t N = GestureEpisode::TRAJ_LEN;
+
+        if (ep.trajFill == 0) {
+            if (ep.trajLen == N) {
+                for (uint8_t k = 0; k < N / 2; ++k) {
+                    for (int i = 0; i < 3; ++i) {
+                        uint16_t a = ep.traj[2 * k][i];
+                        uint16_t b = ep.traj[2 * k + 1][i];
+                        ep.traj[k][i] = a < b ? a : b;
+                    }
+                }
+                ep.trajLen    = N / 2;
+                ep.trajStride = (uint8_t)(ep.trajStride * 2);
+            }
+            for (int i = 0; i < 3; ++i) ep.traj[ep.trajLen][i] = 0xFFFF;
+            ep.trajLen++;
+        }
+
+        uint16_t *p = ep.traj[ep.trajLen - 1];
+        for (int i = 0; i < 3; ++i) {
+            if (valid[i] && filt[i] < p[i]) p[i] = filt[i];
+        }
+
+        if (++ep.trajFill >= ep.trajStride) ep.trajFill = 0;
+    }
+
+    uint16_t swingOf(int i) const {
+        return ep.dMin[i] == 0xFFFF ? 0 : (uint16_t)(ep.dMax[i] - ep.dMin[i]);
+    }
+
+    static uint8_t gapConfidence(int32_t gapUs) {
+        uint32_t g = (uint32_t)(gapUs < 0 ? -gapUs : gapUs);
+        if (g > STREAM_GAP_MAX_US || g <= STREAM_GAP_MIN_US) return 0;
+        if (g >= STREAM_GAP_FULL_US) return 100;
+        return (uint8_t)((g - STREAM_GAP_MIN_US) * 100u / (STREAM_GAP_FULL_US - STREAM_GAP_MIN_US));
+    }
+
+    // > 0 when the bottom pair (earliest of L/R) saw the hand before the top sensor
+    int32_t gapBottomTop() const {
+        uint32_t tBottom = ep.firstSeenUs[ep.seen(0) ? 0 : 1];
+        if (ep.seen(0) && ep.seen(1) && (int32_t)(ep.firstSeenUs[1] - ep.firstSeenUs[0]) < 0)
+            tBottom = ep.firstSeenUs[1];
+        return (int32_t)(ep.firstSeenUs[2] - tBottom);
+    }
+
+    /*
+     * Drops an episode that failed finalizeEpisode() and returns to Idle
+     * An early decision already acted on is reported as Cancelled so the caller
+     * undoes it; provisional() still describes it until the next episode starts.
+     */
+    GestureEvent abandonEpisode() {
+        const ProvisionalDecision p = prov;
+        reset();
+        if (p.dir == GestureDir::None || p.cancelled) return GestureEvent::None;
+        prov           = p;
+        prov.cancelled = true;
+        return GestureEvent::Cancelled;
+    }
+
+    /*
+     * Makes, keeps or withdraws the early decision after each tracked frame
+     * Left/Right needs both bottom sensors and no top sensor; Up/Down needs the
+     * top sensor and a bottom one. Only one early decision is made per episode.
+     */
+    GestureEvent streamDecision(uint32_t nowUs) {
+        const bool haveLR = ep.seen(0) && ep.seen(1);
+        const bool haveBT = ep.seen(2) && (ep.seen(0) || ep.seen(1));
+        const int32_t gapLR = haveLR ? (int32_t)(ep.firstSeenUs[1] - ep.firstSeenUs[0]) : 0;
+
+        if (prov.dir != GestureDir::None) {
+            if (prov.cancelled) return GestureEvent::None;
+
+            bool contradicted = false;
+            if (prov.dir == GestureDir::Left || prov.dir == GestureDir::Right) {
+                contradicted = ep.seen(2) && swingOf(2) > STREAM_T_SWING_MM;
+            } else {
+                int32_t gapBT = gapBottomTop();
+                contradicted = haveLR &&
+                               gapConfidence(gapLR) > gapConfidence(gapBT);
+            }
+            if (contradicted) {
+                LOGGER_DEBUG(Serial.println("[FSM] early decision cancelled"));
+                prov.cancelled = true;
+                return GestureEvent::Cancelled;
+            }
+            return GestureEvent::None;
+        }
+
+        GestureDir dir  = GestureDir::None;
+        uint8_t    conf = 0;
+        if (haveLR && !ep.seen(2)) {
+            conf = gapConfidence(gapLR);
+            dir  = gapLR > 0 ? GestureDir::Right : GestureDir::Left;
+        } else if (haveBT) {
+            int32_t gapBT = gapBottomTop();
+            conf = gapConfidence(gapBT);
+            dir  = gapBT > 0 ? GestureDir::Up : GestureDir::Down;
+        }
+        if (conf < STREAM_MIN_CONFIDENCE) return GestureEvent::None;
+
+        prov.dir        = dir;
+        prov.confidence = conf;
+        prov.cancelled  = false;
+        prov.tUs        = nowUs;
+        LOGGER_DEBUG(Serial.println("[FSM] early decision"));
+        return GestureEvent::Provisional;
+    }
+
+    static void logReject(LogRecord::RejectReason reason) {
+        uint8_t r = (uint8_t)reason;
+        Logger::event(Logger::Level::Warn, LogRecord::Event::EpisodeRejected, &r, sizeof(r));
     }
 
     /*
@@ -355,20 +613,20 @@ private:
      * Checks if the recorded data meets minimum requirements for a valid gesture
      * (sufficient duration, movement magnitude, or velocity).
      */
-    bool finalizeEpisode(uint32_t nowMs) {s) {
-        ep.tEndMs = nowMs;
+    bool finalizeEpisode(uint32_t nowUs) {
+        ep.tEndUs = nowUs;
 
         LOGGER_DEBUG(Serial.println("---- finalizeEpisode ----"));
 
         if (ep.sampleCount < 2) {
-            Logger::log(Logger::Level::Warn, "Episode finalize failed: sampleCount < 2");
+            logReject(LogRecord::RejectReason::TooFewSamples);
             LOGGER_DEBUG(Serial.println("FAIL: sampleCount < 2"));
             return false;
         }
 
-        uint32_t dur = ep.tEndMs - ep.tStartMs;
+        uint32_t dur = ep.durationMs();
         if (dur < MIN_EPISODE_MS) {
-            Logger::log(Logger::Level::Warn, "Episode finalize failed: duration too short");
+            logReject(LogRecord::RejectReason::TooShort);
             LOGGER_DEBUG(Serial.println("FAIL: duration too short"));
             return false;
         }
@@ -386,7 +644,7 @@ private:
         if (ep.maxApproachVel[2] > maxV) maxV = ep.maxApproachVel[2];
 
         if (maxSwing < MIN_SWING_MM && maxV < 200) {
-            Logger::log(Logger::Level::Warn, "Episode finalize failed: weak swing + weak velocity");
+            logReject(LogRecord::RejectReason::WeakMotion);
             LOGGER_DEBUG(Serial.println("FAIL: weak swing + weak velocity"));
             return false;
         }
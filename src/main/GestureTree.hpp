@@ -0,0 +1,163 @@
+/*
+ * Quantized Decision-Tree Gesture Classifier
+ *
+ * Second classifier backend behind classifyEpisode(). Each episode is reduced to
+ * a fixed-length int8 feature vector (swings, peak velocity, first-seen, centroid
+ * and minimum-distance time gaps), then walked through a small binary decision
+ * tree stored as a constexpr table. No heap, no floats, a few dozen comparisons:
+ * well under a microsecond of work per classification on the target.
+ * Unlike the rule cascade it separates Tap from fast Left/Right by when the
+ * sensors were *centred* on the hand rather than when they first saw it, and
+ * falls back to first-seen gaps only when the centroids are inconclusive.
+ * The table is hand-derived from the rule thresholds; regenerate it from
+ * labelled captures when retraining.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <GestureTypes.hpp>
+#include <GesturePreprocessor.hpp>
+
+namespace GestureTree {
+
+  // Feature vector layout; times are signed gaps in units of TIME_Q_US
+  enum Feature : uint8_t {
+    SwingL = 0,   // dMax - dMin, mm / DIST_Q_MM
+    SwingR,
+    SwingT,
+    MaxVel,       // peak approach velocity over all sensors, mm/s / VEL_Q_MMS
+    GapLR,        // firstSeen R - firstSeen L     (> 0: L first)
+    GapBT,        // firstSeen T - first of L/R    (> 0: bottom first)
+    CenLR,        // centroid R - centroid L
+    CenBT,        // centroid T - mean centroid of L/R
+    MinLR,        // time of min distance R - L
+    Duration,     // episode length, unsigned units of TIME_Q_US
+    FEATURE_COUNT
+  };
+
+  static constexpr int32_t DIST_Q_MM  = 4;
+  static constexpr int32_t VEL_Q_MMS  = 64;
+  static constexpr int32_t TIME_Q_US  = 8000;   // +-127 units = +-1.016 s
+
+  /*
+   * One tree node: go left if x[feature] <= threshold, else right
+   * Leaves have feature = LEAF and store the GestureDir in `left`.
+   */
+  struct Node {
+    uint8_t feature;
+    int8_t  threshold;
+    uint8_t left;
+    uint8_t right;
+  };
+
+  static constexpr uint8_t LEAF = 0xFF;
+
+  // Leaf indices
+  enum : uint8_t { N_NONE = 15, N_LEFT, N_RIGHT, N_UP, N_DOWN, N_TAP };
+
+  static constexpr Node NODES[] = {
+    /*  0 */ { SwingT,  1, 1,  8 },          // top sensor barely moved: horizontal or tap
+    // ---- horizontal ----
+    /*  1 */ { CenLR,  -3, N_LEFT, 2 },      // R centred >= 24 ms before L
+    /*  2 */ { CenLR,   2, 3, N_RIGHT },     // L centred >= 24 ms before R
+    /*  3 */ { SwingL,  5, 6, 4 },           // simultaneous: big swing on both = tap
+    /*  4 */ { SwingR,  5, 6, 5 },
+    /*  5 */ { MaxVel,  0, 6, N_TAP },
+    /*  6 */ { GapLR,  -1, N_LEFT, 7 },      // fall back to first-seen order
+    /*  7 */ { GapLR,   0, N_NONE, N_RIGHT },
+    // ---- vertical ----
+    /*  8 */ { CenBT,  -3, N_DOWN, 9 },
+    /*  9 */ { CenBT,   2, 10, N_UP },
+    /* 10 */ { SwingL,  5, 13, 11 },
+    /* 11 */ { SwingR,  5, 13, 12 },
+    /* 12 */ { MaxVel,  0, 13, N_TAP },
+    /* 13 */ { GapBT,  -1, N_DOWN, 14 },
+    /* 14 */ { GapBT,   0, N_NONE, N_UP },
+    // ---- leaves ----
+    /* 15 */ { LEAF, 0, (uint8_t)GestureDir::None,  0 },
+    /* 16 */ { LEAF, 0, (uint8_t)GestureDir::Left,  0 },
+    /* 17 */ { LEAF, 0, (uint8_t)GestureDir::Right, 0 },
+    /* 18 */ { LEAF, 0, (uint8_t)GestureDir::Up,    0 },
+    /* 19 */ { LEAF, 0, (uint8_t)GestureDir::Down,  0 },
+    /* 20 */ { LEAF, 0, (uint8_t)GestureDir::Tap,   0 },
+  };
+
+  static constexpr uint8_t NODE_COUNT = sizeof(NODES) / sizeof(NODES[0]);
+
+  // Longest root-to-leaf path; bounds the walk even if the table is corrupt
+  static constexpr uint8_t MAX_DEPTH = 8;
+
+  inline int8_t q8(int32_t v) {
+    if (v > 127)  return 127;
+    if (v < -127) return -127;
+    return (int8_t)v;
+  }
+
+  // Signed gap b - a between two micros() times, quantized
+  inline int8_t gapQ(uint32_t a, uint32_t b) {
+    return q8((int32_t)(b - a) / TIME_Q_US);
+  }
+
+  /*
+   * Reduces an episode to the int8 feature vector
+   * Constant time: reads only the episode's summary and running features.
+   */
+  inline void extractFeatures(const GestureEpisode &ep, int8_t x[FEATURE_COUNT]) {
+    for (uint8_t i = 0; i < 3; ++i) {
+      int32_t swing = ep.dMin[i] == 0xFFFF ? 0 : (int32_t)(ep.dMax[i] - ep.dMin[i]);
+      x[SwingL + i] = q8(swing / DIST_Q_MM);
+    }
+
+    int16_t maxV = ep.maxApproachVel[0];
+    if (ep.maxApproachVel[1] > maxV) maxV = ep.maxApproachVel[1];
+    if (ep.maxApproachVel[2] > maxV) maxV = ep.maxApproachVel[2];
+    x[MaxVel] = q8(maxV / VEL_Q_MMS);
+
+    const bool seenL = ep.seen(0), seenR = ep.seen(1), seenT = ep.seen(2);
+
+    x[GapLR] = (seenL && seenR) ? gapQ(ep.firstSeenUs[0], ep.firstSeenUs[1]) : 0;
+    x[CenLR] = (seenL && seenR) ? gapQ(ep.centroidUs(0), ep.centroidUs(1)) : 0;
+    x[MinLR] = (seenL && seenR) ? gapQ(ep.tMinUs[0], ep.tMinUs[1]) : 0;
+
+    x[GapBT] = 0;
+    x[CenBT] = 0;
+    if (seenT && (seenL || seenR)) {
+      uint32_t firstBottom;
+      uint32_t cenBottom;
+      if (seenL && seenR) {
+        firstBottom = (int32_t)(ep.firstSeenUs[1] - ep.firstSeenUs[0]) < 0
+                      ? ep.firstSeenUs[1] : ep.firstSeenUs[0];
+        cenBottom   = ep.centroidUs(0) + (uint32_t)((int32_t)(ep.centroidUs(1) - ep.centroidUs(0)) / 2);
+      } else {
+        const uint8_t b = seenL ? 0 : 1;
+        firstBottom = ep.firstSeenUs[b];
+        cenBottom   = ep.centroidUs(b);
+      }
+      x[GapBT] = gapQ(firstBottom, ep.firstSeenUs[2]);
+      x[CenBT] = gapQ(cenBottom, ep.centroidUs(2));
+    }
+
+    x[Duration] = q8((int32_t)(ep.durationUs() / TIME_Q_US));
+  }
+
+  /*
+   * Walks the tree for one feature vector
+   */
+  inline GestureDir classifyFeatures(const int8_t x[FEATURE_COUNT]) {
+    uint8_t n = 0;
+    for (uint8_t depth = 0; depth < MAX_DEPTH && n < NODE_COUNT; ++depth) {
+      const Node &node = NODES[n];
+      if (node.feature == LEAF) return (GestureDir)node.left;
+      n = (x[node.feature] <= node.threshold) ? node.left : node.right;
+    }
+    if (n < NODE_COUNT && NODES[n].feature == LEAF) return (GestureDir)NODES[n].left;
+    return GestureDir::None;
+  }
+
+  inline GestureDir classify(const GestureEpisode &ep) {
+    int8_t x[FEATURE_COUNT];
+    extractFeatures(ep, x);
+    return classifyFeatures(x);
+  }
+
+} // namespace GestureTree
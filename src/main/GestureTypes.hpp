@@ -6,6 +6,7 @@
  */
 
 #pragma once
+#include <stdint.h>
 
 /*
  * Represents the classified direction of a recognized gesture
@@ -22,11 +23,25 @@ enum class GestureDir {
 
 /*
  * Events emitted by the gesture preprocessor state machine
- * Signals when a complete gesture episode is ready for classification.
+ * Signals when a complete gesture episode is ready for classification, and in
+ * streaming mode when an early decision is made or withdrawn mid-episode.
  */
 enum class GestureEvent {
     None = 0,
-    EpisodeReady
+    EpisodeReady,
+    Provisional,   // early decision available, see GesturePreprocessor::provisional()
+    Cancelled      // the provisional decision was contradicted by later samples
+};
+
+/*
+ * Early decision made while the hand is still in the sensor field
+ * confidence is 0..100; cancelled is set once later samples contradict it.
+ */
+struct ProvisionalDecision {
+    GestureDir dir        = GestureDir::None;
+    uint8_t    confidence = 0;
+    bool       cancelled  = false;
+    uint32_t   tUs        = 0;   // micros() time of the frame that made the decision
 };
 
 // Forward declaration; full definition is in GesturePreprocessor.hpp
@@ -0,0 +1,244 @@
+/*
+ * Binary Log Record Format
+ *
+ * Defines the compact on-card record layout written by Logger in binary mode
+ * (LOGGER_BINARY=1), and the text rendering shared by the device's text mode and
+ * the host-side decoder in tools/logdecode. Depends only on the C library so it
+ * builds unchanged on the ESP32 and on a PC.
+ *
+ * Every record is an 8-byte header followed by `len` payload bytes, little-endian:
+ *   sync(0xA5) | event | len | level | tMs (u32)
+ * The sync byte lets the decoder skip over a torn or corrupted record, or over
+ * text interleaved with records on a serial capture.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace LogRecord {
+
+  static const uint8_t SYNC = 0xA5;
+
+  enum class Event : uint8_t {
+    Text            = 0,  // payload: message bytes, no terminator
+    Boot            = 1,  // payload: none
+    Gesture         = 2,  // payload: EpisodePayload
+    EpisodeRejected = 3,  // payload: uint8_t RejectReason
+    FrameOverflow   = 4,  // payload: OverflowPayload
+    Frame           = 5,  // payload: FramePayload (sensor trace capture)
+    TraceLabel      = 6   // payload: uint8_t GestureDir performed next (trace capture)
+  };
+
+  enum class RejectReason : uint8_t {
+    TooFewSamples = 0,
+    TooShort      = 1,
+    WeakMotion    = 2
+  };
+
+#pragma pack(push, 1)
+
+  struct Header {
+    uint8_t  sync;
+    uint8_t  event;
+    uint8_t  len;
+    uint8_t  level;   // 0 = INFO, 1 = WARN, 2 = ERROR
+    uint32_t tMs;
+  };
+
+  /*
+   * One sensor's share of an episode
+   * Distances are mm, saturated at 254 (the gesture band ends well below);
+   * MM_UNSEEN marks a sensor that never saw the object.
+   */
+  struct SensorSummary {
+    uint8_t  dMin;
+    uint8_t  dMax;
+    uint8_t  maxApproachVel;  // peak approach speed in VEL_UNIT_MM_S, saturated
+    uint16_t firstSeenMs;     // since the episode start
+  };
+
+  /*
+   * The gesture episode behind a classification decision, sensor order L, R, T
+   */
+  struct EpisodePayload {
+    uint8_t       dirSeen;    // GestureDir in bits 0-3, seenMask in bits 4-6
+    uint8_t       sampleCount;
+    uint8_t       winnerChanges;
+    uint16_t      durationMs;
+    SensorSummary s[3];
+  };
+
+  struct OverflowPayload {
+    uint32_t dropped;
+    uint32_t total;
+    uint32_t highWater;
+  };
+
+  /*
+   * One raw sensor frame as fed to GesturePreprocessor::update(), L, R, T order
+   */
+  struct FramePayload {
+    uint16_t d[3];
+    uint32_t tUs[3];
+  };
+
+#pragma pack(pop)
+
+  static_assert(sizeof(Header) == 8, "LogRecord::Header layout changed");
+  static_assert(sizeof(EpisodePayload) == 20, "LogRecord::EpisodePayload layout changed");
+  static_assert(sizeof(FramePayload) == 18, "LogRecord::FramePayload layout changed");
+
+  static const size_t MAX_PAYLOAD = 255;
+
+  static const uint8_t MM_UNSEEN     = 0xFF;
+  static const uint8_t VEL_UNIT_MM_S = 16;
+
+  // -------- EpisodePayload packing --------
+
+  inline uint8_t packMm(uint16_t mm) {
+    return mm < MM_UNSEEN ? (uint8_t)mm : MM_UNSEEN - 1;
+  }
+
+  inline uint8_t packVelocity(int32_t mmPerS) {
+    if (mmPerS <= 0) return 0;
+    const int32_t v = (mmPerS + VEL_UNIT_MM_S / 2) / VEL_UNIT_MM_S;
+    return v > 0xFF ? 0xFF : (uint8_t)v;
+  }
+
+  inline uint16_t packMs(uint32_t us) {
+    const uint32_t ms = (us + 500) / 1000;
+    return ms > 0xFFFF ? 0xFFFF : (uint16_t)ms;
+  }
+
+  inline uint8_t episodeDir(const EpisodePayload& p)  { return p.dirSeen & 0x0F; }
+  inline uint8_t episodeSeen(const EpisodePayload& p) { return (p.dirSeen >> 4) & 0x07; }
+
+  inline unsigned swingMm(const SensorSummary& s) {
+    return s.dMin == MM_UNSEEN ? 0 : (unsigned)(s.dMax - s.dMin);
+  }
+
+  /*
+   * Writes header + payload into out, which must hold sizeof(Header) + len bytes
+   * len must not exceed MAX_PAYLOAD. Returns the record size.
+   */
+  inline size_t encode(uint8_t* out, uint8_t level, Event ev, uint32_t tMs,
+                       const void* payload, size_t len) {
+    Header h;
+    h.sync  = SYNC;
+    h.event = (uint8_t)ev;
+    h.len   = (uint8_t)len;
+    h.level = level;
+    h.tMs   = tMs;
+    memcpy(out, &h, sizeof(h));
+    if (len) memcpy(out + sizeof(h), payload, len);
+    return sizeof(h) + len;
+  }
+
+  inline const char* levelName(uint8_t level) {
+    switch (level) {
+      case 0:  return "INFO";
+      case 1:  return "WARN";
+      default: return "ERROR";
+    }
+  }
+
+  inline const char* eventName(uint8_t event) {
+    switch ((Event)event) {
+      case Event::Text:            return "text";
+      case Event::Boot:            return "boot";
+      case Event::Gesture:         return "gesture";
+      case Event::EpisodeRejected: return "episode_rejected";
+      case Event::FrameOverflow:   return "frame_overflow";
+      case Event::Frame:           return "frame";
+      case Event::TraceLabel:      return "trace_label";
+      default:                     return "unknown";
+    }
+  }
+
+  // Indexed by GestureDir
+  inline const char* dirName(uint8_t dir) {
+    static const char* const names[] = { "NONE", "LEFT", "RIGHT", "UP", "DOWN", "TAP" };
+    return dir < sizeof(names) / sizeof(names[0]) ? names[dir] : "?";
+  }
+
+  inline const char* rejectText(uint8_t reason) {
+    switch ((RejectReason)reason) {
+      case RejectReason::TooFewSamples: return "sampleCount < 2";
+      case RejectReason::TooShort:      return "duration too short";
+      case RejectReason::WeakMotion:    return "weak swing + weak velocity";
+      default:                          return "unknown reason";
+    }
+  }
+
+  /*
+   * Renders a record body (without timestamp/level prefix) as one line of text
+   * Returns the snprintf-style length. Malformed payloads render as "<bad payload>".
+   */
+  inline int formatBody(char* out, size_t outLen,
+                        uint8_t event, const uint8_t* payload, size_t len) {
+    switch ((Event)event) {
+      case Event::Text:
+        return snprintf(out, outLen, "%.*s", (int)len, (const char*)payload);
+
+      case Event::Boot:
+        return snprintf(out, outLen, "=== Logger started ===");
+
+      case Event::Gesture: {
+        if (len != sizeof(EpisodePayload)) break;
+        EpisodePayload p;
+        memcpy(&p, payload, sizeof(p));
+        return snprintf(out, outLen,
+                        "Gesture recognized: %s (dur=%u ms samples=%u "
+                        "swing(L,R,T)=%u,%u,%u maxV(L,R,T)=%u,%u,%u mm/s "
+                        "first(L,R,T)=%u,%u,%u ms)",
+                        dirName(episodeDir(p)),
+                        (unsigned)p.durationMs,
+                        (unsigned)p.sampleCount,
+                        swingMm(p.s[0]), swingMm(p.s[1]), swingMm(p.s[2]),
+                        (unsigned)(p.s[0].maxApproachVel * VEL_UNIT_MM_S),
+                        (unsigned)(p.s[1].maxApproachVel * VEL_UNIT_MM_S),
+                        (unsigned)(p.s[2].maxApproachVel * VEL_UNIT_MM_S),
+                        (unsigned)p.s[0].firstSeenMs,
+                        (unsigned)p.s[1].firstSeenMs,
+                        (unsigned)p.s[2].firstSeenMs);
+      }
+
+      case Event::EpisodeRejected:
+        if (len != 1) break;
+        return snprintf(out, outLen, "Episode finalize failed: %s", rejectText(payload[0]));
+
+      case Event::FrameOverflow: {
+        if (len != sizeof(OverflowPayload)) break;
+        OverflowPayload p;
+        memcpy(&p, payload, sizeof(p));
+        return snprintf(out, outLen,
+                        "Sensor frame ring overflow: %lu dropped (total %lu, high water %lu)",
+                        (unsigned long)p.dropped,
+                        (unsigned long)p.total,
+                        (unsigned long)p.highWater);
+      }
+
+      case Event::Frame: {
+        if (len != sizeof(FramePayload)) break;
+        FramePayload p;
+        memcpy(&p, payload, sizeof(p));
+        return snprintf(out, outLen, "Frame d(L,R,T)=%u,%u,%u t(L,R,T)=%lu,%lu,%lu us",
+                        (unsigned)p.d[0], (unsigned)p.d[1], (unsigned)p.d[2],
+                        (unsigned long)p.tUs[0], (unsigned long)p.tUs[1],
+                        (unsigned long)p.tUs[2]);
+      }
+
+      case Event::TraceLabel:
+        if (len != 1) break;
+        return snprintf(out, outLen, "Trace label: %s", dirName(payload[0]));
+
+      default:
+        return snprintf(out, outLen, "event %u (%u bytes)", (unsigned)event, (unsigned)len);
+    }
+    return snprintf(out, outLen, "<bad payload>");
+  }
+
+} // namespace LogRecord
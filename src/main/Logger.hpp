@@ -2,7 +2,12 @@
  * System Logger and LED Status Indicator
  * 
  * Provides thread-safe logging to SD card with RGB LED status indication.
- * Uses FreeRTOS semaphores to ensure safe concurrent access to the SD card.
+ * Log calls only format into a preallocated RAM ring and return immediately;
+ * a low-priority flush task keeps the log file open and writes the ring out in
+ * sector-aligned batches, taking the SD bus (SdBus, log priority) only for the
+ * write itself and stopping between chunks when the audio stream needs the card.
+ * With LOGGER_BINARY=1 entries are stored as compact LogRecord records instead
+ * of text; decode them on a PC with tools/logdecode.
  * LED colors indicate system state: green (idle), blue (processing gesture),
  * yellow (weak gesture), cyan (WiFi active), red (error).
  */
@@ -12,6 +17,11 @@
 #include <SD.h>
 #include <stdarg.h>
 
+#include <LogRecord.hpp>
+#include <Profiler.hpp>
+#include <SdBus.hpp>
+#include <TaskConfig.hpp>
+
 #ifndef LOGGER_ENABLE_SERIAL_DEBUG
 #define LOGGER_ENABLE_SERIAL_DEBUG 0
 #endif
@@ -22,9 +32,31 @@
 #define LOGGER_DEBUG(code) do { (void)0; } while (0)
 #endif
 
+// 1 = write binary LogRecord records instead of text lines
+#ifndef LOGGER_BINARY
+#define LOGGER_BINARY 0
+#endif
+
+// RAM ring size; power of two and a whole number of SD sectors
+#ifndef LOGGER_RING_BYTES
+#define LOGGER_RING_BYTES 8192
+#endif
+
+// Flush once this many bytes are queued (written in whole sectors)
+#ifndef LOGGER_FLUSH_BYTES
+#define LOGGER_FLUSH_BYTES 2048
+#endif
+
+// ...and drain whatever is queued at least this often
+#ifndef LOGGER_FLUSH_INTERVAL_MS
+#define LOGGER_FLUSH_INTERVAL_MS 1000
+#endif
+
+
 extern "C" {
   #include "freertos/FreeRTOS.h"
   #include "freertos/semphr.h"
+  #include "freertos/task.h"
 }
 
 namespace Logger {
@@ -35,12 +67,29 @@ enum class Level : uint8_t {
   Error
 };
 
-// -------- internal state (function-local statics to avoid multiple defs) --------
+static const uint32_t SECTOR_BYTES = 512;
 
-inline SemaphoreHandle_t& sdMutexRef() {
-  static SemaphoreHandle_t h = nullptr;
-  return h;
-}
+static_assert((LOGGER_RING_BYTES & (LOGGER_RING_BYTES - 1)) == 0,
+              "LOGGER_RING_BYTES must be a power of two");
+static_assert(LOGGER_RING_BYTES % SECTOR_BYTES == 0,
+              "LOGGER_RING_BYTES must be a multiple of the sector size");
+static_assert(LOGGER_FLUSH_BYTES < LOGGER_RING_BYTES,
+              "LOGGER_FLUSH_BYTES must be smaller than the ring");
+
+/*
+ * Counters describing logger throughput and loss
+ * linesDropped counts lines rejected because the ring was full.
+ */
+struct Stats {
+  uint32_t linesQueued   = 0;
+  uint32_t linesDropped  = 0;
+  uint32_t bytesWritten  = 0;
+  uint32_t flushes       = 0;
+  uint32_t flushFailures = 0;
+  uint32_t ringHighWater = 0;
+};
+
+// -------- internal state (function-local statics to avoid multiple defs) --------
 
 inline const char*& logPathRef() {
   static const char* p = "/system.log";   // keep it out of /tracks
@@ -56,6 +105,42 @@ inline bool& initializedRef() {
   return b;
 }
 
+// Ring storage; head/tail are free-running byte counts, masked on access
+inline uint8_t* ringBuf() {
+  static uint8_t buf[LOGGER_RING_BYTES];
+  return buf;
+}
+inline uint32_t& ringHeadRef() { static uint32_t v = 0; return v; }
+inline uint32_t& ringTailRef() { static uint32_t v = 0; return v; }
+
+// Producers may be any task; the spinlock only covers the memcpy into the ring
+inline portMUX_TYPE& ringLockRef() {
+  static portMUX_TYPE m = portMUX_INITIALIZER_UNLOCKED;
+  return m;
+}
+
+inline Stats& statsRef() {
+  static Stats s;
+  return s;
+}
+
+inline TaskHandle_t& flushTaskRef() {
+  static TaskHandle_t t = nullptr;
+  return t;
+}
+
+// Log file kept open by the flush task
+inline File& logFileRef() {
+  static File f;
+  return f;
+}
+
+// Current log file size, used to keep batches sector-aligned
+inline uint32_t& fileSizeRef() { static uint32_t v = 0; return v; }
+
+// End of the bytes a failed write left past fileSizeRef(); 0 once overwritten
+inline uint32_t& tornEndRef() { static uint32_t v = 0; return v; }
+
 // -------- LED helpers --------
 
 /*
@@ -80,18 +165,228 @@ inline void ledWarn() { setLed(true,  true,  false); } // yellow - weak/unclear
 inline void ledWifi() { setLed(false, true,  true ); } // cyan - WiFi active
 inline void ledError(){ setLed(true,  false, false); } // red - error or system disabled
 
+// -------- ring + flush task --------
+
+/*
+ * Copies one complete line into the ring, or drops it if it does not fit
+ * Never blocks on the SD card; wakes the flush task once a batch is ready.
+ */
+inline bool enqueue(const void* src, size_t len) {
+  const uint8_t* data = (const uint8_t*)src;
+  uint8_t* buf = ringBuf();
+  bool     wake;
+
+  portENTER_CRITICAL(&ringLockRef());
+  uint32_t head = ringHeadRef();
+  uint32_t used = head - ringTailRef();
+  if (len > LOGGER_RING_BYTES - used) {
+    statsRef().linesDropped++;
+    portEXIT_CRITICAL(&ringLockRef());
+    return false;
+  }
+
+  uint32_t pos   = head & (LOGGER_RING_BYTES - 1);
+  size_t   first = LOGGER_RING_BYTES - pos;
+  if (first > len) first = len;
+  memcpy(buf + pos, data, first);
+  memcpy(buf, data + first, len - first);
+  ringHeadRef() = head + len;
+
+  used += len;
+  Stats& st = statsRef();
+  st.linesQueued++;
+  if (used > st.ringHighWater) st.ringHighWater = used;
+  wake = (used >= LOGGER_FLUSH_BYTES) && (used - len < LOGGER_FLUSH_BYTES);
+  portEXIT_CRITICAL(&ringLockRef());
+
+  TaskHandle_t t = flushTaskRef();
+  if (wake && t) xTaskNotifyGive(t);
+  return true;
+}
+
+/*
+ * Writes queued bytes to the log file (flush task, or flush() callers)
+ * With partial=false only whole sectors are written, so each batch ends on a
+ * sector boundary of the file; partial=true drains everything. Writes go out in
+ * SDBUS_CHUNK_BYTES pieces and stop early if the audio stream wants the bus;
+ * the rest stays queued for the next flush. After a short write the batch
+ * stays queued too, and the next flush writes it over the partial bytes.
+ * Returns false if the SD card was busy or the file could not be opened.
+ */
+inline bool flushRing(bool partial, TickType_t mutexWait) {
+  portENTER_CRITICAL(&ringLockRef());
+  bool empty = (ringHeadRef() == ringTailRef());
+  portEXIT_CRITICAL(&ringLockRef());
+  if (empty) return true;
+
+  // The SD bus also serializes flushers, so tail only moves under it
+  if (!SdBus::acquire(SdBus::Client::Log, mutexWait)) {
+    return false;
+  }
+
+  // Opened first, so the sector alignment below uses the real file size
+  File& f = logFileRef();
+  if (!f && tornEndRef()) {
+    // Write over what a failed write left behind, so records stay contiguous
+    f = SD.open(logPathRef(), "r+");
+    if (f && !f.seek(fileSizeRef())) f.close();
+    if (!f) tornEndRef() = 0;  // cannot rewind: append after the torn bytes
+  }
+  if (!f) {
+    f = SD.open(logPathRef(), FILE_APPEND);
+    if (f) fileSizeRef() = f.size();
+  }
+  if (!f) {
+    SdBus::release(SdBus::Client::Log);
+    portENTER_CRITICAL(&ringLockRef());
+    statsRef().flushFailures++;
+    portEXIT_CRITICAL(&ringLockRef());
+    ledError();
+    return false;
+  }
+
+  uint32_t tail = ringTailRef();
+  portENTER_CRITICAL(&ringLockRef());
+  uint32_t avail = ringHeadRef() - tail;
+  portEXIT_CRITICAL(&ringLockRef());
+
+  uint32_t n = avail;
+  if (!partial) {
+    // Only what reaches the next sector boundary; less than that waits for more
+    uint32_t excess = (fileSizeRef() + avail) % SECTOR_BYTES;
+    n = excess > avail ? 0 : avail - excess;
+  }
+  if (n == 0) {
+    SdBus::release(SdBus::Client::Log);
+    return true;
+  }
+
+  // The region [tail, tail+n) is only ever touched by this function
+  uint8_t* buf     = ringBuf();
+  uint32_t written = 0;
+  bool     failed  = false;
+  while (written < n) {
+    uint32_t pos = (tail + written) & (LOGGER_RING_BYTES - 1);
+    uint32_t len = n - written;
+    if (len > LOGGER_RING_BYTES - pos) len = LOGGER_RING_BYTES - pos;
+    if (len > SDBUS_CHUNK_BYTES) len = SDBUS_CHUNK_BYTES;
+
+    size_t w = f.write(buf + pos, len);
+    written += w;
+    if (w != len) {
+      failed = true;
+      break;
+    }
+    if (written < n && SdBus::shouldYield(SdBus::Client::Log)) break;
+  }
+  f.flush();
+
+  // A failed batch stays queued whole and is rewritten from the same offset
+  if (failed) {
+    if (fileSizeRef() + written > tornEndRef()) tornEndRef() = fileSizeRef() + written;
+    written = 0;
+  }
+  fileSizeRef() += written;
+  if (fileSizeRef() >= tornEndRef()) tornEndRef() = 0;
+
+  portENTER_CRITICAL(&ringLockRef());
+  ringTailRef() = tail + written;
+  Stats& st = statsRef();
+  st.bytesWritten += written;
+  st.flushes++;
+  if (failed) st.flushFailures++;
+  portEXIT_CRITICAL(&ringLockRef());
+
+  if (failed) f.close();  // reopen next time
+  SdBus::release(SdBus::Client::Log);
+  return !failed;
+}
+
+/*
+ * Low-priority background task that drains the ring to the SD card
+ * Wakes when a full batch is queued, or every LOGGER_FLUSH_INTERVAL_MS to write
+ * out whatever is pending, so no line sits in RAM much longer than that.
+ * If the SD card is busy, the data simply stays queued until the next wake.
+ */
+inline void flushTask(void* /*arg*/) {
+  for (;;) {
+    uint32_t woke = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(LOGGER_FLUSH_INTERVAL_MS));
+    // Woken by a full batch: sector-aligned write; timeout: drain everything
+    flushRing(woke == 0, pdMS_TO_TICKS(50));
+  }
+}
+
+// -------- low-level write helpers --------
+
+/*
+ * Internal helper that queues one binary record (header + payload)
+ * Payloads longer than LogRecord::MAX_PAYLOAD are truncated.
+ */
+inline void writeRecord(Level level, LogRecord::Event ev,
+                        const void* payload, size_t len) {
+  if (len > LogRecord::MAX_PAYLOAD) len = LogRecord::MAX_PAYLOAD;
+
+  uint8_t buf[sizeof(LogRecord::Header) + LogRecord::MAX_PAYLOAD];
+  enqueue(buf, LogRecord::encode(buf, (uint8_t)level, ev, millis(), payload, len));
+}
+
+/*
+ * Internal helper that queues a timestamped log line
+ * Text mode formats "[t ms][LEVEL] line" into the ring; binary mode stores the
+ * line as a Text record with no formatting at all. Returns immediately; the
+ * flush task writes it to the SD card later.
+ */
+inline void writeLine(Level level, const char* line) {
+  if (!initializedRef() || !line) return;
+  PROFILE_SCOPE(Profiler::Probe::LogLine);
+
+#if LOGGER_BINARY
+  writeRecord(level, LogRecord::Event::Text, line, strlen(line));
+#else
+  char buf[256];
+  int len = snprintf(buf, sizeof(buf), "[%lu ms][%s] %s\r\n",
+                     (unsigned long)millis(), LogRecord::levelName((uint8_t)level), line);
+  if (len <= 0) return;
+  if ((size_t)len >= sizeof(buf)) {
+    // Truncated: keep the line terminator
+    len = sizeof(buf) - 1;
+    buf[len - 2] = '\r';
+    buf[len - 1] = '\n';
+  }
+
+  enqueue(buf, (size_t)len);
+#endif
+}
+
 // -------- init --------
 
 /*
- * Initializes the logger with SD card mutex and LED pins
- * Sets up the RGB LED pins and writes a startup message to the log file.
- * Must be called before using any logging functions.
+ * Starts the background flush task, if it is not running yet
+ * Until then log calls only fill the RAM ring, so a boot can log before the
+ * SD card is mounted and defer the first file open until it is.
  */
-inline void init(SemaphoreHandle_t sdMutex,
-                 const char* logPath,
-                 int pinR, int pinG, int pinB)
+inline void startFlushing() {
+  if (flushTaskRef()) return;
+  xTaskCreatePinnedToCore(flushTask,
+                          "logFlush",
+                          LOGGER_FLUSH_TASK_STACK,
+                          nullptr,
+                          LOGGER_FLUSH_TASK_PRIO,
+                          &flushTaskRef(),
+                          LOGGER_FLUSH_TASK_CORE);
+}
+
+/*
+ * Initializes the logger with its log file and LED pins
+ * Sets up the RGB LED pins, starts the background flush task (unless
+ * startFlush is false; call startFlushing() later) and queues a startup
+ * message. SdBus::begin() must have been called first. Must be called before
+ * using any logging functions.
+ */
+inline void init(const char* logPath,
+                 int pinR, int pinG, int pinB,
+                 bool startFlush = true)
 {
-  sdMutexRef() = sdMutex;
   if (logPath && logPath[0] != '\0') {
     logPathRef() = logPath;
   }
@@ -106,58 +401,41 @@ inline void init(SemaphoreHandle_t sdMutex,
 
   ledIdle();
 
-  // Write a header line, best effort (short timeout)
-  SemaphoreHandle_t m = sdMutexRef();
-  if (m && xSemaphoreTake(m, pdMS_TO_TICKS(10)) == pdTRUE) {
-    File f = SD.open(logPathRef(), FILE_WRITE);
-    if (f) {
-      f.println("=== Logger started ===");
-      f.close();
-    }
-    xSemaphoreGive(m);
-  }
+  if (startFlush) startFlushing();
 
   initializedRef() = true;
-}
 
-// -------- low-level write helper --------
+#if LOGGER_BINARY
+  writeRecord(Level::Info, LogRecord::Event::Boot, nullptr, 0);
+#else
+  static const char header[] = "=== Logger started ===\r\n";
+  enqueue(header, sizeof(header) - 1);
+#endif
+}
 
 /*
- * Internal helper that writes a timestamped log line to the SD card
- * Uses non-blocking semaphore acquisition to avoid interfering with audio playback.
+ * Writes everything queued so far to the SD card, waiting for the SD bus
+ * Use before a deliberate restart or power-down.
  */
-inline void writeLine(Level level, const char* line) {
-  if (!initializedRef() || !line) return;
-
-  SemaphoreHandle_t m = sdMutexRef();
-  if (!m) return;
-
-  // Don’t block long – if SD is busy (audio), drop the log
-  if (xSemaphoreTake(m, pdMS_TO_TICKS(5)) != pdTRUE) {
-    return;
-  }
-
-  File f = SD.open(logPathRef(), FILE_WRITE);
-  if (f) {
-    uint32_t t = millis();
-    const char* lvlStr =
-      (level == Level::Info)  ? "INFO"  :
-      (level == Level::Warn)  ? "WARN"  :
-                                "ERROR";
-
-    f.print('[');
-    f.print(t);
-    f.print(" ms][");
-    f.print(lvlStr);
-    f.print("] ");
-    f.println(line);
-    f.close();
-  }
-  else {
-    ledError();
+inline bool flush(TickType_t mutexWait = pdMS_TO_TICKS(500)) {
+  // flushRing may stop early to let audio in; keep going until the ring is empty
+  for (;;) {
+    if (!flushRing(true, mutexWait)) return false;
+    portENTER_CRITICAL(&ringLockRef());
+    bool empty = (ringHeadRef() == ringTailRef());
+    portEXIT_CRITICAL(&ringLockRef());
+    if (empty) return true;
   }
+}
 
-  xSemaphoreGive(m);
+/*
+ * Returns a snapshot of the logger counters
+ */
+inline Stats stats() {
+  portENTER_CRITICAL(&ringLockRef());
+  Stats s = statsRef();
+  portEXIT_CRITICAL(&ringLockRef());
+  return s;
 }
 
 // -------- public logging API --------
@@ -176,6 +454,28 @@ inline void log(Level level, const char* msg) {
   writeLine(level, msg);
 }
 
+/*
+ * Logs a structured event with a small binary payload (see LogRecord.hpp)
+ * Binary mode stores the payload as-is; text mode renders it with the same
+ * formatter the host decoder uses, so both produce identical text.
+ */
+inline void event(Level level, LogRecord::Event ev,
+                  const void* payload, size_t len) {
+  if (!initializedRef()) return;
+
+  if (level == Level::Error) {
+    ledError();
+  }
+
+#if LOGGER_BINARY
+  writeRecord(level, ev, payload, len);
+#else
+  char body[192];
+  LogRecord::formatBody(body, sizeof(body), (uint8_t)ev, (const uint8_t*)payload, len);
+  writeLine(level, body);
+#endif
+}
+
 /*
  * Logs a formatted message with the specified severity level
  * Similar to printf - accepts format strings and variable arguments.
@@ -0,0 +1,669 @@
+/*
+ * SD Playlist Index
+ *
+ * Track source for Speaker built from the WAV (and, with SPEAKER_MP3, MP3) files
+ * in PLAYLIST_DIR and kept in a binary index file on the card, so a boot only
+ * reads the index header instead of opening and parsing every track. The index is also what bounds
+ * RAM use: nothing per track is kept in memory, each lookup reads one entry
+ * and its name from the card.
+ *
+ * File layout (little endian):
+ *   DiskHeader
+ *   DiskEntry[capacity]      fixed slots, filled in playlist order
+ *   names                    entry names (relative to PLAYLIST_DIR), no terminators
+ *
+ * Uploads append a slot (or rewrite the slot of a file with the same name) and
+ * deletes mark the slot removed, so playlist indices stay stable while the
+ * player runs. Removed slots are compacted by the next rebuild, which happens
+ * at boot once they are the majority, when an upload found the index full or
+ * the index is invalid, or on request (serial console 'p').
+ *
+ * The index file stays open between lookups. A rebuild scans into a temp file
+ * without the playlist lock and only takes it to swap the files, so lookups
+ * keep being served from the old index meanwhile.
+ *
+ * Lock order: the playlist lock is always taken before the SD bus.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include <string.h>
+
+#include <Logger.hpp>
+#include <SdBus.hpp>
+#include <Speaker.hpp>
+
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/semphr.h"
+}
+
+// Directory scanned for tracks; "/" is where the web file manager uploads to
+#ifndef PLAYLIST_DIR
+#define PLAYLIST_DIR "/"
+#endif
+
+#ifndef PLAYLIST_INDEX_PATH
+#define PLAYLIST_INDEX_PATH "/.playlist.idx"
+#endif
+
+// Slots reserved in a new index file (40 bytes each on the card, none in RAM)
+#ifndef PLAYLIST_CAPACITY
+#define PLAYLIST_CAPACITY 2048
+#endif
+
+// Longest the reader task waits for the index lock before reporting the lookup busy
+#ifndef PLAYLIST_LOOKUP_WAIT_MS
+#define PLAYLIST_LOOKUP_WAIT_MS 50
+#endif
+
+namespace Playlist {
+
+  static const uint32_t MAGIC        = 0x31494C50;  // "PLI1"
+  static const uint16_t VERSION      = 2;
+  static const size_t   NAME_MAX_LEN = 63;
+  static const uint8_t  FLAG_REMOVED = 0x01;    // DiskEntry::flags
+  static const uint32_t HDR_TRUNCATED = 0x01;   // DiskHeader::flags: an upload found no free slot
+
+  struct DiskHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entryBytes;
+    uint32_t capacity;
+    uint32_t count;        // slots used, removed ones included
+    uint32_t live;         // slots not removed
+    uint32_t namesBytes;   // bytes used in the names region
+    uint32_t flags;        // HDR_*
+    uint32_t reserved;
+  };
+
+  struct DiskEntry {
+    uint32_t nameOffset;   // into the names region
+    uint32_t nameHash;     // FNV-1a of the name, for lookups by name
+    uint32_t fileSize;     // the stored header is trusted while the size matches
+    uint32_t sampleRate;
+    uint32_t dataOffset;
+    uint32_t dataSize;
+    uint32_t durationMs;
+    uint8_t  nameLen;
+    uint8_t  channels;
+    uint8_t  bits;
+    uint8_t  flags;
+    uint16_t blockAlign;   // WavInfo::blockAlign
+    uint8_t  codec;        // AudioDecoder::Codec
+    uint8_t  reserved[5];
+  };
+
+  static_assert(sizeof(DiskHeader) == 32, "Playlist::DiskHeader layout changed");
+  static_assert(sizeof(DiskEntry) == 40, "Playlist::DiskEntry layout changed");
+
+  // ------- internal shared state --------
+
+  inline SemaphoreHandle_t& lockRef() {
+    static SemaphoreHandle_t m = nullptr;
+    return m;
+  }
+
+  // Copy of the on-card header; only changed with the lock held
+  inline DiskHeader& headerRef() {
+    static DiskHeader h = {};
+    return h;
+  }
+
+  // The index file, kept open for lookups and edits; only used with the lock held
+  inline File& indexRef() {
+    static File f;
+    return f;
+  }
+
+  // Set while a rebuild scans into the temp file; only changed with the lock held
+  inline bool& rebuildingRef() {
+    static bool busy = false;
+    return busy;
+  }
+
+  // Set by edits to the index during a scan, which then has to run again
+  inline bool& editedRef() {
+    static bool edited = false;
+    return edited;
+  }
+
+  inline volatile uint32_t& countRef() {
+    static volatile uint32_t n = 0;
+    return n;
+  }
+
+  // Set by begin(true) when the index needs a rebuild that has not run yet
+  inline bool& rebuildPendingRef() {
+    static bool pending = false;
+    return pending;
+  }
+
+  // -------- helpers --------
+
+  class Lock {
+  public:
+    explicit Lock(TickType_t wait = portMAX_DELAY)
+      : ok_(lockRef() && xSemaphoreTake(lockRef(), wait) == pdTRUE) {}
+    ~Lock() { if (ok_) xSemaphoreGive(lockRef()); }
+
+    Lock(const Lock&) = delete;
+    Lock& operator=(const Lock&) = delete;
+
+    bool ok() const { return ok_; }
+
+  private:
+    bool ok_;
+  };
+
+  inline uint32_t hashName(const char* name, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+      h ^= (uint8_t)name[i];
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  inline uint32_t entryPos(uint32_t slot) {
+    return sizeof(DiskHeader) + slot * sizeof(DiskEntry);
+  }
+
+  inline uint32_t namesPos(const DiskHeader& h) {
+    return sizeof(DiskHeader) + h.capacity * sizeof(DiskEntry);
+  }
+
+  /*
+   * Builds "PLAYLIST_DIR/name"; returns false if it does not fit
+   */
+  inline bool joinPath(char* out, size_t outLen, const char* name, size_t nameLen) {
+    const char*  dir    = PLAYLIST_DIR;
+    const size_t dirLen = strlen(dir);
+    const bool   slash  = dirLen == 0 || dir[dirLen - 1] != '/';
+    if (dirLen + (slash ? 1 : 0) + nameLen + 1 > outLen) return false;
+    memcpy(out, dir, dirLen);
+    size_t n = dirLen;
+    if (slash) out[n++] = '/';
+    memcpy(out + n, name, nameLen);
+    out[n + nameLen] = '\0';
+    return true;
+  }
+
+  /*
+   * Returns the name of path relative to PLAYLIST_DIR, or nullptr if the file
+   * is not directly inside it
+   */
+  inline const char* relativeName(const char* path) {
+    if (!path) return nullptr;
+    const char*  dir    = PLAYLIST_DIR;
+    size_t       dirLen = strlen(dir);
+    while (dirLen && dir[dirLen - 1] == '/') --dirLen;
+    if (strncmp(path, dir, dirLen) != 0 || path[dirLen] != '/') return nullptr;
+    const char* name = path + dirLen + 1;
+    return (*name && !strchr(name, '/')) ? name : nullptr;
+  }
+
+  // Candidate tracks: visible *.wav (and *.mp3 with SPEAKER_MP3) files with names that fit an entry
+  inline bool isTrackName(const char* name) {
+    const size_t len = strlen(name);
+    if (len <= 4 || len > NAME_MAX_LEN || name[0] == '.') return false;
+    return strcasecmp(name + len - 4, ".wav") == 0 ||
+           (SPEAKER_MP3 && Speaker::isMp3Name(name));
+  }
+
+  /*
+   * Fills an entry from an open track file; false if the player cannot stream it
+   * Caller holds the SD bus.
+   */
+  inline bool describe(File& f, DiskEntry& e) {
+    Speaker::WavInfo info;
+    if (f.isDirectory() || !Speaker::parseTrackHeader(f, info) || !Speaker::isPlayable(info)) {
+      return false;
+    }
+    e.fileSize   = (uint32_t)f.size();
+    e.sampleRate = info.sampleRate;
+    e.dataOffset = info.dataOffset;
+    e.dataSize   = info.dataSize;
+    e.durationMs = Speaker::durationMs(info);
+    e.channels   = (uint8_t)info.numChannels;
+    e.bits       = (uint8_t)info.bitsPerSample;
+    e.flags      = 0;
+    e.blockAlign = info.blockAlign;
+    e.codec      = (uint8_t)info.codec;
+    memset(e.reserved, 0, sizeof(e.reserved));
+    return true;
+  }
+
+  inline bool writeAt(File& f, uint32_t pos, const void* data, size_t len) {
+    return f.seek(pos) && (size_t)f.write((const uint8_t*)data, len) == len;
+  }
+
+  inline bool readAt(File& f, uint32_t pos, void* data, size_t len) {
+    return f.seek(pos) && (size_t)f.read((uint8_t*)data, len) == len;
+  }
+
+  /*
+   * Writes entry e named `name` into the next free slot of an open index and
+   * updates h; the caller writes the header afterwards. Caller holds the SD bus.
+   */
+  inline bool appendLocked(File& idx, DiskHeader& h, DiskEntry& e, const char* name, size_t len) {
+    if (h.count >= h.capacity) return false;
+    e.nameOffset = h.namesBytes;
+    e.nameLen    = (uint8_t)len;
+    e.nameHash   = hashName(name, len);
+    if (!writeAt(idx, namesPos(h) + h.namesBytes, name, len)) return false;
+    if (!writeAt(idx, entryPos(h.count), &e, sizeof(e))) return false;
+    h.namesBytes += len;
+    h.count++;
+    h.live++;
+    return true;
+  }
+
+  /*
+   * Finds the slot holding `name` in the open index; -1 if there is none
+   * Reads the slot table a chunk per bus acquisition. Caller holds the lock.
+   */
+  inline int32_t findSlot(File& idx, const char* name, size_t len, DiskEntry& out) {
+    static DiskEntry chunk[SDBUS_CHUNK_BYTES / sizeof(DiskEntry)];
+    static const uint32_t PER_CHUNK = sizeof(chunk) / sizeof(chunk[0]);
+
+    const DiskHeader& h    = headerRef();
+    const uint32_t    hash = hashName(name, len);
+    char              buf[NAME_MAX_LEN];
+
+    for (uint32_t base = 0; base < h.count; base += PER_CHUNK) {
+      const uint32_t n = (h.count - base) < PER_CHUNK ? (h.count - base) : PER_CHUNK;
+      SdBus::Guard bus(SdBus::Client::Web, pdMS_TO_TICKS(500));
+      if (!bus.ok() || !readAt(idx, entryPos(base), chunk, n * sizeof(DiskEntry))) return -1;
+
+      for (uint32_t i = 0; i < n; ++i) {
+        const DiskEntry& e = chunk[i];
+        if (e.nameHash != hash || e.nameLen != len) continue;
+        if (!readAt(idx, namesPos(h) + e.nameOffset, buf, len)) return -1;
+        if (memcmp(buf, name, len) == 0) {
+          out = e;
+          return (int32_t)(base + i);
+        }
+      }
+    }
+    return -1;
+  }
+
+  inline bool headerValid(const DiskHeader& h, uint32_t fileSize) {
+    return h.magic == MAGIC && h.version == VERSION &&
+           h.entryBytes == sizeof(DiskEntry) && h.capacity > 0 &&
+           h.count <= h.capacity && h.live <= h.count &&
+           fileSize >= namesPos(h) + h.namesBytes;
+  }
+
+  /*
+   * Returns the index file, opening it if it is not open yet
+   * Caller holds the lock and the SD bus.
+   */
+  inline File& openIndexLocked() {
+    File& idx = indexRef();
+    if (!idx) idx = SD.open(PLAYLIST_INDEX_PATH, "r+");
+    return idx;
+  }
+
+  /*
+   * Writes a fresh index of PLAYLIST_DIR to `path`, leaving its header in h
+   * Headers are parsed a few files per bus acquisition, at web priority. Runs
+   * without the playlist lock. `dropped` counts tracks that found no free slot.
+   */
+  inline bool scanInto(const char* path, DiskHeader& h, size_t& skipped, size_t& dropped) {
+    static const uint8_t zeros[512] = {};
+
+    h            = DiskHeader();
+    h.magic      = MAGIC;
+    h.version    = VERSION;
+    h.entryBytes = sizeof(DiskEntry);
+    h.capacity   = PLAYLIST_CAPACITY;
+    skipped      = 0;
+    dropped      = 0;
+
+    File idx;
+    File dir;
+    bool ok = true;
+    {
+      SdBus::Guard bus(SdBus::Client::Web);
+      idx = SD.open(path, "w");
+      dir = SD.open(PLAYLIST_DIR);
+    }
+    if (!idx || !dir || !dir.isDirectory()) {
+      Logger::log(Logger::Level::Error, "Playlist: cannot open track directory or index file");
+      LOGGER_DEBUG(Serial.println("Playlist: cannot open track directory or index file"));
+      SdBus::Guard bus(SdBus::Client::Web);
+      if (idx) idx.close();
+      if (dir) dir.close();
+      return false;
+    }
+
+    // Header and empty slot table, one chunk per bus acquisition
+    for (uint32_t off = 0; ok && off < namesPos(h); ) {
+      SdBus::Guard bus(SdBus::Client::Web);
+      for (uint32_t k = 0; ok && k < SDBUS_CHUNK_BYTES && off < namesPos(h); k += sizeof(zeros)) {
+        uint32_t len = namesPos(h) - off;
+        if (len > sizeof(zeros)) len = sizeof(zeros);
+        ok = idx.write(zeros, len) == len;
+        off += len;
+      }
+    }
+
+    bool done = false;
+    while (ok && !done) {
+      SdBus::Guard bus(SdBus::Client::Web);
+      for (uint8_t batch = 0; batch < 8; ++batch) {
+        File f = dir.openNextFile();
+        if (!f) {
+          done = true;
+          break;
+        }
+        const char* full = f.name();
+        const char* base = strrchr(full, '/');
+        if (base) full = base + 1;
+        if (!isTrackName(full)) {
+          f.close();
+          continue;
+        }
+        // f.name() does not outlive the file
+        char name[NAME_MAX_LEN + 1];
+        strcpy(name, full);
+        DiskEntry e = {};
+        const bool playable = describe(f, e);
+        f.close();
+        if (!playable) {
+          ++skipped;
+        } else if (h.count >= h.capacity) {
+          ++dropped;
+        } else if (!appendLocked(idx, h, e, name, strlen(name))) {
+          ok = false;
+          break;
+        }
+      }
+    }
+
+    SdBus::Guard bus(SdBus::Client::Web);
+    dir.close();
+    ok = ok && writeAt(idx, 0, &h, sizeof(h));
+    idx.close();
+    if (!ok) SD.remove(path);
+    return ok;
+  }
+
+  // -------- public API --------
+
+  inline size_t count() {
+    return countRef();
+  }
+
+  inline size_t live() {
+    return headerRef().live;
+  }
+
+  /*
+   * Speaker track source: resolves slot i to its path and stored track header
+   * Removed slots are Unplayable; Busy means the lock stayed taken (a rebuild
+   * swapping the index in, or an upload) and the lookup should be retried.
+   */
+  inline Speaker::TrackStatus lookup(size_t i, Speaker::TrackRef& out) {
+    Lock lock(pdMS_TO_TICKS(PLAYLIST_LOOKUP_WAIT_MS));
+    if (!lock.ok()) return Speaker::TrackStatus::Busy;
+    if (i >= countRef()) return Speaker::TrackStatus::Unplayable;
+
+    const DiskHeader& h = headerRef();
+    DiskEntry e;
+    char      name[NAME_MAX_LEN];
+    {
+      SdBus::Guard bus(SdBus::Client::Audio);
+      File& idx = openIndexLocked();
+      if (!idx ||
+          !readAt(idx, entryPos((uint32_t)i), &e, sizeof(e)) ||
+          (e.flags & FLAG_REMOVED) || e.nameLen > NAME_MAX_LEN ||
+          !readAt(idx, namesPos(h) + e.nameOffset, name, e.nameLen)) {
+        return Speaker::TrackStatus::Unplayable;
+      }
+    }
+
+    if (!joinPath(out.path, sizeof(out.path), name, e.nameLen)) return Speaker::TrackStatus::Unplayable;
+    out.info.sampleRate    = e.sampleRate;
+    out.info.numChannels   = e.channels;
+    out.info.bitsPerSample = e.bits;
+    out.info.dataOffset    = e.dataOffset;
+    out.info.dataSize      = e.dataSize;
+    out.info.blockAlign    = e.blockAlign;
+    out.info.codec         = (AudioDecoder::Codec)e.codec;
+    out.info.byteRate      = 0;
+    out.fileSize           = e.fileSize;
+    return Speaker::TrackStatus::Ok;
+  }
+
+  /*
+   * Rescans PLAYLIST_DIR into a fresh index file and swaps it in
+   * The scan runs without the playlist lock, so the player keeps looking up
+   * tracks in the old index; only the swap holds it. Uploads and deletes
+   * during the scan make it run again. Returns the track count.
+   */
+  inline size_t rebuild() {
+    static const char* TMP_PATH = PLAYLIST_INDEX_PATH ".tmp";
+
+    {
+      Lock lock;
+      if (!lock.ok() || rebuildingRef()) return countRef();  // one scan at a time
+      rebuildingRef() = true;
+      editedRef()     = false;
+    }
+
+    DiskHeader h;
+    size_t     skipped;
+    size_t     dropped;
+    bool       scanned;
+    bool       ok;
+    for (uint8_t pass = 0; ; ++pass) {
+      scanned = scanInto(TMP_PATH, h, skipped, dropped);
+
+      Lock lock;
+      if (scanned && editedRef() && pass < 2) {
+        editedRef() = false;
+        continue;
+      }
+
+      ok = scanned;
+      if (scanned) {
+        SdBus::Guard bus(SdBus::Client::Web);
+        indexRef().close();
+        SD.remove(PLAYLIST_INDEX_PATH);
+        ok = SD.rename(TMP_PATH, PLAYLIST_INDEX_PATH);
+        openIndexLocked();
+      }
+      if (ok) {
+        headerRef() = h;
+        countRef()  = h.count;
+      } else if (scanned) {
+        // The old index is gone as well
+        headerRef() = DiskHeader();
+        countRef()  = 0;
+      }
+      rebuildingRef() = false;
+      break;
+    }
+
+    if (!scanned) {
+      Logger::log(Logger::Level::Error, "Playlist: rescan failed, keeping the old index");
+      LOGGER_DEBUG(Serial.println("Playlist: rescan failed, keeping the old index"));
+      return countRef();
+    }
+
+    Speaker::tracksChanged();
+    if (!ok) {
+      Logger::log(Logger::Level::Error, "Playlist: writing the index failed");
+      LOGGER_DEBUG(Serial.println("Playlist: writing the index failed"));
+      return 0;
+    }
+
+    Logger::logf(Logger::Level::Info, "Playlist: indexed %lu tracks in %s, %u skipped",
+                 (unsigned long)h.count, PLAYLIST_DIR, (unsigned)skipped);
+    if (dropped) {
+      Logger::logf(Logger::Level::Warn, "Playlist: index full, %u tracks left out",
+                   (unsigned)dropped);
+    }
+    return h.count;
+  }
+
+  /*
+   * Loads the index header, rebuilding the index if it is missing, invalid,
+   * mostly removed slots, or turned away an upload, and attaches the playlist
+   * to the player
+   * With deferRebuild the rebuild is left to finishRebuild(), so a boot with a
+   * good index starts playing without waiting for a directory scan (and one
+   * without has no tracks until the rebuild runs).
+   * Call after SD.begin() and before Speaker::startPlayer().
+   */
+  inline bool begin(bool deferRebuild = false) {
+    if (!lockRef()) lockRef() = xSemaphoreCreateMutex();
+    if (!lockRef()) return false;
+
+    bool valid = false;
+    {
+      Lock lock;
+      SdBus::Guard bus(SdBus::Client::Web);
+      File& idx = openIndexLocked();
+      DiskHeader h;
+      if (idx && readAt(idx, 0, &h, sizeof(h)) && headerValid(h, (uint32_t)idx.size())) {
+        headerRef() = h;
+        countRef()  = h.count;
+        valid = true;
+      }
+    }
+
+    const DiskHeader& h = headerRef();
+    if (!valid || (h.flags & HDR_TRUNCATED) || (h.count > 64 && h.live * 2 < h.count)) {
+      if (deferRebuild) rebuildPendingRef() = true;
+      else rebuild();
+    } else {
+      Logger::logf(Logger::Level::Info, "Playlist: loaded %lu tracks (%lu slots) from index",
+                   (unsigned long)h.live, (unsigned long)h.count);
+    }
+
+    Speaker::setTrackSource(count, lookup);
+    return true;
+  }
+
+  /*
+   * Runs the rebuild that begin(true) deferred, if any; returns whether one ran
+   */
+  inline bool finishRebuild() {
+    if (!rebuildPendingRef()) return false;
+    rebuildPendingRef() = false;
+    rebuild();
+    return true;
+  }
+
+  /*
+   * Adds or refreshes one track after an upload
+   * Files outside PLAYLIST_DIR, or that are not playable tracks, are ignored
+   * (a previous entry under that name is removed). Do not hold the SD bus.
+   */
+  inline bool add(const char* path) {
+    const char* name = relativeName(path);
+    if (!name || !isTrackName(name)) return false;
+    const size_t len = strlen(name);
+
+    DiskEntry e = {};
+    bool playable;
+    {
+      SdBus::Guard bus(SdBus::Client::Web);
+      File f = SD.open(path, FILE_READ);
+      playable = f && describe(f, e);
+      if (f) f.close();
+    }
+
+    Lock lock;
+    if (!lock.ok()) return false;
+    if (rebuildingRef()) editedRef() = true;
+
+    File* idx;
+    {
+      SdBus::Guard bus(SdBus::Client::Web);
+      idx = &openIndexLocked();
+    }
+    if (!*idx) return false;
+
+    DiskHeader& h = headerRef();
+    DiskEntry   old;
+    int32_t     slot = findSlot(*idx, name, len, old);
+
+    bool ok    = true;
+    bool full  = false;
+    {
+      SdBus::Guard bus(SdBus::Client::Web);
+      if (slot >= 0) {
+        // Same name: rewrite in place so indices stay stable
+        const bool wasLive = !(old.flags & FLAG_REMOVED);
+        if (playable) {
+          e.nameOffset = old.nameOffset;
+          e.nameHash   = old.nameHash;
+          e.nameLen    = old.nameLen;
+        } else {
+          e = old;
+          e.flags |= FLAG_REMOVED;
+        }
+        ok = writeAt(*idx, entryPos((uint32_t)slot), &e, sizeof(e));
+        if (ok && wasLive && !playable) h.live--;
+        if (ok && !wasLive && playable) h.live++;
+      } else if (playable) {
+        full = h.count >= h.capacity;
+        ok   = !full && appendLocked(*idx, h, e, name, len);
+      }
+      // A full index is rebuilt at the next boot, which may compact room for it
+      if (full) h.flags |= HDR_TRUNCATED;
+      if (ok || full) ok = writeAt(*idx, 0, &h, sizeof(h)) && ok;
+      idx->flush();
+    }
+    countRef() = h.count;
+    if (slot >= 0) Speaker::tracksChanged();
+
+    if (!ok) {
+      Logger::logf(Logger::Level::Warn, "Playlist: could not index %s%s",
+                   path, full ? " (index full)" : "");
+      LOGGER_DEBUG(Serial.println("Playlist: could not index upload"));
+    }
+    return ok && playable;
+  }
+
+  /*
+   * Marks a deleted file's slot removed; do not hold the SD bus
+   */
+  inline void remove(const char* path) {
+    const char* name = relativeName(path);
+    if (!name || !isTrackName(name)) return;
+    const size_t len = strlen(name);
+
+    Lock lock;
+    if (!lock.ok()) return;
+    if (rebuildingRef()) editedRef() = true;
+
+    File* idx;
+    {
+      SdBus::Guard bus(SdBus::Client::Web);
+      idx = &openIndexLocked();
+    }
+    if (!*idx) return;
+
+    DiskHeader& h = headerRef();
+    DiskEntry   e;
+    int32_t     slot = findSlot(*idx, name, len, e);
+
+    SdBus::Guard bus(SdBus::Client::Web);
+    if (slot >= 0 && !(e.flags & FLAG_REMOVED)) {
+      e.flags |= FLAG_REMOVED;
+      if (writeAt(*idx, entryPos((uint32_t)slot), &e, sizeof(e))) {
+        h.live--;
+        writeAt(*idx, 0, &h, sizeof(h));
+      }
+      idx->flush();
+    }
+  }
+
+} // namespace Playlist
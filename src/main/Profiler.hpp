@@ -0,0 +1,322 @@
+/*
+ * Hot-Path Cycle Profiler
+ *
+ * CPU cycle probes (esp_cpu_get_cycle_count) around the code that decides
+ * whether a frame or an audio block is late: sensor reads, preprocessing,
+ * classification, log line formatting, SD reads, I2S writes, SD bus waits and
+ * audio resampling.
+ * Each probe keeps a log2 histogram for the long-run distribution plus a ring
+ * of its most recent samples, so a dump also shows what happened just now.
+ * Task stack high-water marks and per-task CPU load are read from FreeRTOS on
+ * demand and cost nothing in between.
+ *
+ * Probes compile to nothing unless PROFILER_ENABLE is 1, like LOGGER_DEBUG.
+ * This header must not include Logger.hpp or SdBus.hpp: both are instrumented.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_cpu.h"
+
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+}
+
+// Enable/disable the cycle probes
+#ifndef PROFILER_ENABLE
+#define PROFILER_ENABLE 0
+#endif
+
+// Most recent samples kept per probe
+#ifndef PROFILER_RING
+#define PROFILER_RING 16
+#endif
+
+// Most tasks reported by taskSnapshot()
+#ifndef PROFILER_MAX_TASKS
+#define PROFILER_MAX_TASKS 24
+#endif
+
+#if PROFILER_ENABLE
+#define PROFILER_CAT2(a, b) a##b
+#define PROFILER_CAT(a, b) PROFILER_CAT2(a, b)
+// Times the rest of the enclosing scope
+#define PROFILE_SCOPE(probe) Profiler::Scope PROFILER_CAT(profScope_, __LINE__)(probe)
+// Records a duration measured elsewhere with micros()
+#define PROFILE_RECORD_US(probe, us) Profiler::recordUs((probe), (us))
+#else
+#define PROFILE_SCOPE(probe) do { } while (0)
+#define PROFILE_RECORD_US(probe, us) do { } while (0)
+#endif
+
+namespace Profiler {
+
+  enum class Probe : uint8_t {
+    SensorRead = 0,   // VL53L0X result read (readRange + status)
+    GestureUpdate,    // GesturePreprocessor::update()
+    Classify,         // classifyEpisode()
+    LogLine,          // Logger::writeLine()
+    SdRead,           // one f.read() in the audio reader, bus already held
+    I2sWrite,         // one g_i2s.write(), including DMA back-pressure
+    SdWaitAudio,      // SdBus::acquire() wait, audio client
+    SdWaitOther,      // SdBus::acquire() wait, log and web clients
+    Resample,         // CPU time of one resampled audio block, I2S writes excluded
+    Decode            // one ADPCM/MP3 decoder call in the audio reader
+  };
+  static const uint8_t PROBE_COUNT = 10;
+
+  // Bucket 0 is < 2^HIST_BASE_BITS cycles, bucket b < 2^(HIST_BASE_BITS + b); the last is open
+  static const uint8_t HIST_BUCKETS   = 20;
+  static const uint8_t HIST_BASE_BITS = 8;
+
+  struct ProbeStats {
+    uint32_t count       = 0;
+    uint32_t maxCycles   = 0;
+    uint64_t totalCycles = 0;
+    uint32_t hist[HIST_BUCKETS] = {};
+    uint32_t recent[PROFILER_RING] = {};
+    uint8_t  recentHead  = 0;   // next slot to overwrite
+  };
+
+  struct TaskInfo {
+    char     name[16];
+    uint8_t  priority;
+    uint32_t stackFree;          // stack high-water mark, bytes never used
+    uint16_t cpuPermille;        // share of CPU time since the previous snapshot
+  };
+
+  // ------- internal shared state --------
+
+  inline ProbeStats* statsArray() {
+    static ProbeStats s[PROBE_COUNT];
+    return s;
+  }
+
+  inline portMUX_TYPE& lockRef() {
+    static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    return mux;
+  }
+
+  inline uint8_t histBucket(uint32_t cycles) {
+    uint8_t bits = cycles ? (uint8_t)(32 - __builtin_clz(cycles)) : 0;
+    if (bits <= HIST_BASE_BITS) return 0;
+    uint8_t b = (uint8_t)(bits - HIST_BASE_BITS);
+    return b < HIST_BUCKETS - 1 ? b : HIST_BUCKETS - 1;
+  }
+
+  // -------- recording --------
+
+  inline uint32_t cycles() {
+    return (uint32_t)esp_cpu_get_cycle_count();
+  }
+
+  inline void record(Probe p, uint32_t c) {
+    portENTER_CRITICAL(&lockRef());
+    ProbeStats& st = statsArray()[(uint8_t)p];
+    st.count++;
+    st.totalCycles += c;
+    if (c > st.maxCycles) st.maxCycles = c;
+    st.hist[histBucket(c)]++;
+    st.recent[st.recentHead] = c;
+    st.recentHead = (uint8_t)((st.recentHead + 1) % PROFILER_RING);
+    portEXIT_CRITICAL(&lockRef());
+  }
+
+  inline void recordUs(Probe p, uint32_t us) {
+    const uint64_t c = (uint64_t)us * getCpuFrequencyMhz();
+    record(p, c > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)c);
+  }
+
+  /*
+   * Records the cycles between construction and destruction
+   */
+  class Scope {
+  public:
+    explicit Scope(Probe p) : probe_(p), t0_(cycles()) {}
+    ~Scope() { record(probe_, cycles() - t0_); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    Probe    probe_;
+    uint32_t t0_;
+  };
+
+  // -------- reporting --------
+
+  inline bool enabled() {
+    return PROFILER_ENABLE != 0;
+  }
+
+  inline const char* probeName(Probe p) {
+    switch (p) {
+      case Probe::SensorRead:    return "sensor_read";
+      case Probe::GestureUpdate: return "gesture_update";
+      case Probe::Classify:      return "classify";
+      case Probe::LogLine:       return "log_line";
+      case Probe::SdRead:        return "sd_read";
+      case Probe::I2sWrite:      return "i2s_write";
+      case Probe::SdWaitAudio:   return "sd_wait_audio";
+      case Probe::SdWaitOther:   return "sd_wait_other";
+      case Probe::Resample:      return "resample";
+      default:                   return "decode";
+    }
+  }
+
+  /*
+   * Returns a consistent snapshot of one probe's counters
+   */
+  inline ProbeStats stats(Probe p) {
+    portENTER_CRITICAL(&lockRef());
+    ProbeStats s = statsArray()[(uint8_t)p];
+    portEXIT_CRITICAL(&lockRef());
+    return s;
+  }
+
+  inline void reset() {
+    portENTER_CRITICAL(&lockRef());
+    for (uint8_t i = 0; i < PROBE_COUNT; ++i) statsArray()[i] = ProbeStats();
+    portEXIT_CRITICAL(&lockRef());
+  }
+
+  /*
+   * Upper bound of the histogram bucket holding the given fraction (permille)
+   * of samples; the open last bucket reports the observed maximum
+   */
+  inline uint32_t percentile(const ProbeStats& s, uint16_t permille) {
+    if (!s.count) return 0;
+    const uint64_t target = ((uint64_t)s.count * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint8_t b = 0; b < HIST_BUCKETS - 1; ++b) {
+      seen += s.hist[b];
+      if (seen >= target) {
+        uint32_t bound = 1u << (HIST_BASE_BITS + b);
+        return bound < s.maxCycles ? bound : s.maxCycles;
+      }
+    }
+    return s.maxCycles;
+  }
+
+  inline uint32_t recentMax(const ProbeStats& s) {
+    uint32_t m = 0;
+    for (uint8_t i = 0; i < PROFILER_RING; ++i) if (s.recent[i] > m) m = s.recent[i];
+    return m;
+  }
+
+  /*
+   * Renders one probe as a single text line, cycles and microseconds
+   */
+  inline int formatProbe(char* out, size_t outLen, Probe p) {
+    ProbeStats s = stats(p);
+    const uint32_t mhz  = getCpuFrequencyMhz() ? getCpuFrequencyMhz() : 1;
+    const uint32_t mean = s.count ? (uint32_t)(s.totalCycles / s.count) : 0;
+    return snprintf(out, outLen,
+                    "%-14s n=%lu mean=%lu p50<=%lu p99<=%lu max=%lu recentMax=%lu cyc "
+                    "(mean %lu us, max %lu us)",
+                    probeName(p), (unsigned long)s.count, (unsigned long)mean,
+                    (unsigned long)percentile(s, 500), (unsigned long)percentile(s, 990),
+                    (unsigned long)s.maxCycles, (unsigned long)recentMax(s),
+                    (unsigned long)(mean / mhz), (unsigned long)(s.maxCycles / mhz));
+  }
+
+  /*
+   * Renders one probe as a JSON object, histogram included
+   */
+  inline int formatProbeJson(char* out, size_t outLen, Probe p) {
+    ProbeStats s = stats(p);
+    int n = snprintf(out, outLen,
+                     "{\"name\":\"%s\",\"count\":%lu,\"meanCyc\":%lu,\"p50Cyc\":%lu,"
+                     "\"p99Cyc\":%lu,\"maxCyc\":%lu,\"recentMaxCyc\":%lu,\"hist\":[",
+                     probeName(p), (unsigned long)s.count,
+                     (unsigned long)(s.count ? s.totalCycles / s.count : 0),
+                     (unsigned long)percentile(s, 500), (unsigned long)percentile(s, 990),
+                     (unsigned long)s.maxCycles, (unsigned long)recentMax(s));
+    for (uint8_t b = 0; b < HIST_BUCKETS && n > 0 && (size_t)n < outLen; ++b) {
+      n += snprintf(out + n, outLen - n, b ? ",%lu" : "%lu", (unsigned long)s.hist[b]);
+    }
+    if (n > 0 && (size_t)n < outLen) n += snprintf(out + n, outLen - n, "]}");
+    return n;
+  }
+
+  /*
+   * Fills out with every task's priority, stack high-water mark and CPU share
+   * since the previous call (since boot on the first). Returns the task count,
+   * or 0 if FreeRTOS was built without trace facility.
+   */
+  inline size_t taskSnapshot(TaskInfo* out, size_t maxTasks) {
+#if configUSE_TRACE_FACILITY
+    static TaskStatus_t status[PROFILER_MAX_TASKS];
+    static uint32_t     prevRun[PROFILER_MAX_TASKS];
+    static UBaseType_t  prevNum[PROFILER_MAX_TASKS];
+    static size_t       prevCount = 0;
+    static uint32_t     prevTotal = 0;
+    static portMUX_TYPE snapLock  = portMUX_INITIALIZER_UNLOCKED;
+
+    // One snapshot at a time: status[] and the previous run times are shared
+    static volatile bool busy = false;
+    portENTER_CRITICAL(&snapLock);
+    const bool mine = !busy;
+    busy = true;
+    portEXIT_CRITICAL(&snapLock);
+    if (!mine) return 0;
+
+    uint32_t total = 0;
+    size_t n = uxTaskGetSystemState(status, PROFILER_MAX_TASKS, &total);
+    const uint32_t totalDelta = total - prevTotal;
+
+    size_t count = 0;
+    for (size_t i = 0; i < n && count < maxTasks; ++i) {
+      const TaskStatus_t& t = status[i];
+      TaskInfo& info = out[count++];
+      strncpy(info.name, t.pcTaskName ? t.pcTaskName : "?", sizeof(info.name) - 1);
+      info.name[sizeof(info.name) - 1] = '\0';
+      info.priority  = (uint8_t)t.uxCurrentPriority;
+      info.stackFree = (uint32_t)t.usStackHighWaterMark;
+      info.cpuPermille = 0;
+#if configGENERATE_RUN_TIME_STATS
+      uint32_t before = 0;
+      for (size_t k = 0; k < prevCount; ++k) {
+        if (prevNum[k] == t.xTaskNumber) { before = prevRun[k]; break; }
+      }
+      if (totalDelta) {
+        info.cpuPermille = (uint16_t)((uint64_t)(t.ulRunTimeCounter - before) * 1000 / totalDelta);
+      }
+#endif
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      prevNum[i] = status[i].xTaskNumber;
+#if configGENERATE_RUN_TIME_STATS
+      prevRun[i] = status[i].ulRunTimeCounter;
+#endif
+    }
+    prevCount = n;
+    prevTotal = total;
+
+    busy = false;
+    return count;
+#else
+    (void)out;
+    (void)maxTasks;
+    return 0;
+#endif
+  }
+
+  inline int formatTask(char* out, size_t outLen, const TaskInfo& t) {
+    return snprintf(out, outLen, "task %-16s prio=%u stackFree=%lu B cpu=%u.%u%%",
+                    t.name, (unsigned)t.priority, (unsigned long)t.stackFree,
+                    (unsigned)(t.cpuPermille / 10), (unsigned)(t.cpuPermille % 10));
+  }
+
+  inline int formatTaskJson(char* out, size_t outLen, const TaskInfo& t) {
+    return snprintf(out, outLen,
+                    "{\"name\":\"%s\",\"prio\":%u,\"stackFree\":%lu,\"cpuPermille\":%u}",
+                    t.name, (unsigned)t.priority, (unsigned long)t.stackFree,
+                    (unsigned)t.cpuPermille);
+  }
+
+} // namespace Profiler
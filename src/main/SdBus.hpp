@@ -0,0 +1,258 @@
+/*
+ * SD Bus Arbitration
+ *
+ * Owns the mutex that serializes every SD card access (audio read-ahead, log
+ * flushes, web uploads/downloads) and gives the audio stream precedence over the
+ * rest. Lower-priority clients hold the bus for at most one SDBUS_CHUNK_BYTES
+ * transfer at a time, and before each one they stand back while the audio
+ * reader is waiting for the bus or its prefetch queue is running low, up to
+ * SDBUS_YIELD_MAX_MS, so background traffic is delayed rather than starved.
+ * Wait and hold times are recorded per client, with a wait-time histogram, to
+ * confirm that web and log traffic never push audio into an underrun.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <stdio.h>
+
+#include <Profiler.hpp>
+
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+  #include "freertos/semphr.h"
+}
+
+// Largest transfer a low-priority client should make per bus acquisition
+#ifndef SDBUS_CHUNK_BYTES
+#define SDBUS_CHUNK_BYTES 4096
+#endif
+
+// Longest a low-priority client defers to a hungry audio stream before going ahead
+#ifndef SDBUS_YIELD_MAX_MS
+#define SDBUS_YIELD_MAX_MS 20
+#endif
+
+namespace SdBus {
+
+  enum class Client : uint8_t {
+    Audio = 0,  // Speaker reader task; highest priority
+    Log   = 1,  // Logger flush task
+    Web   = 2   // WebFileManager handlers
+  };
+  static const uint8_t CLIENT_COUNT = 3;
+
+  // Upper bounds (us) of the wait-time histogram buckets; the last bucket is open
+  static const uint8_t  HIST_BUCKETS = 6;
+  static const uint32_t HIST_BOUND_US[HIST_BUCKETS - 1] = { 100, 1000, 5000, 20000, 100000 };
+
+  struct ClientStats {
+    uint32_t acquired    = 0;
+    uint32_t timeouts    = 0;
+    uint32_t deferred    = 0;  // low priority only: waited for the audio stream first
+    uint32_t waitMaxUs   = 0;
+    uint32_t holdMaxUs   = 0;
+    uint64_t waitTotalUs = 0;
+    uint32_t waitHist[HIST_BUCKETS] = {};
+  };
+
+  // ------- internal shared state --------
+
+  inline SemaphoreHandle_t& mutexRef() {
+    static SemaphoreHandle_t m = nullptr;
+    return m;
+  }
+
+  inline portMUX_TYPE& statsLockRef() {
+    static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    return mux;
+  }
+
+  inline ClientStats* statsArray() {
+    static ClientStats s[CLIENT_COUNT];
+    return s;
+  }
+
+  inline uint32_t* holdStartRef() {
+    static uint32_t t[CLIENT_COUNT];
+    return t;
+  }
+
+  // Number of audio acquisitions in progress (waiting for the mutex)
+  inline volatile uint8_t& audioWaitingRef() {
+    static volatile uint8_t n = 0;
+    return n;
+  }
+
+  // Set by the reader while its prefetch queue is below half full
+  inline volatile bool& audioHungryRef() {
+    static volatile bool h = false;
+    return h;
+  }
+
+  inline uint8_t histBucket(uint32_t us) {
+    uint8_t b = 0;
+    while (b < HIST_BUCKETS - 1 && us >= HIST_BOUND_US[b]) ++b;
+    return b;
+  }
+
+  // -------- public API --------
+
+  /*
+   * Creates the bus mutex; call once before any client starts
+   * Returns false if the mutex could not be created.
+   */
+  inline bool begin() {
+    if (!mutexRef()) mutexRef() = xSemaphoreCreateMutex();
+    return mutexRef() != nullptr;
+  }
+
+  inline const char* clientName(Client c) {
+    switch (c) {
+      case Client::Audio: return "audio";
+      case Client::Log:   return "log";
+      default:            return "web";
+    }
+  }
+
+  /*
+   * Reports whether the audio stream currently has precedence
+   */
+  inline bool audioContended() {
+    return audioWaitingRef() != 0 || audioHungryRef();
+  }
+
+  /*
+   * Low-priority clients call this between chunks of a longer transfer and stop
+   * (release the bus, retry later) when it returns true
+   */
+  inline bool shouldYield(Client c) {
+    return c != Client::Audio && audioContended();
+  }
+
+  /*
+   * Called by the audio reader with its prefetch state after every block
+   */
+  inline void setAudioHungry(bool hungry) {
+    audioHungryRef() = hungry;
+  }
+
+  /*
+   * Takes the SD bus for client c, waiting at most `wait` ticks in total
+   * Low-priority clients first defer to the audio stream (bounded by
+   * SDBUS_YIELD_MAX_MS). Returns false on timeout or if begin() was not called.
+   */
+  inline bool acquire(Client c, TickType_t wait = portMAX_DELAY) {
+    SemaphoreHandle_t m = mutexRef();
+    if (!m) return false;
+
+    const uint32_t   t0    = micros();
+    const TickType_t start = xTaskGetTickCount();
+    bool deferred = false;
+
+    if (c == Client::Audio) {
+      portENTER_CRITICAL(&statsLockRef());
+      audioWaitingRef() = audioWaitingRef() + 1;
+      portEXIT_CRITICAL(&statsLockRef());
+    } else {
+      const TickType_t maxDefer = pdMS_TO_TICKS(SDBUS_YIELD_MAX_MS);
+      while (audioContended()) {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= maxDefer || (wait != portMAX_DELAY && elapsed >= wait)) break;
+        deferred = true;
+        vTaskDelay(1);
+      }
+    }
+
+    TickType_t remaining = wait;
+    if (wait != portMAX_DELAY) {
+      TickType_t elapsed = xTaskGetTickCount() - start;
+      remaining = elapsed >= wait ? 0 : wait - elapsed;
+    }
+    const bool ok = xSemaphoreTake(m, remaining) == pdTRUE;
+
+    const uint32_t now    = micros();
+    const uint32_t waitUs = now - t0;
+    PROFILE_RECORD_US(c == Client::Audio ? Profiler::Probe::SdWaitAudio
+                                         : Profiler::Probe::SdWaitOther, waitUs);
+
+    portENTER_CRITICAL(&statsLockRef());
+    if (c == Client::Audio) audioWaitingRef() = audioWaitingRef() - 1;
+    ClientStats& st = statsArray()[(uint8_t)c];
+    if (deferred) st.deferred++;
+    if (ok) {
+      st.acquired++;
+      st.waitTotalUs += waitUs;
+      if (waitUs > st.waitMaxUs) st.waitMaxUs = waitUs;
+      st.waitHist[histBucket(waitUs)]++;
+      holdStartRef()[(uint8_t)c] = now;
+    } else {
+      st.timeouts++;
+    }
+    portEXIT_CRITICAL(&statsLockRef());
+    return ok;
+  }
+
+  /*
+   * Releases the SD bus taken by acquire(c)
+   */
+  inline void release(Client c) {
+    const uint32_t holdUs = micros() - holdStartRef()[(uint8_t)c];
+
+    portENTER_CRITICAL(&statsLockRef());
+    ClientStats& st = statsArray()[(uint8_t)c];
+    if (holdUs > st.holdMaxUs) st.holdMaxUs = holdUs;
+    portEXIT_CRITICAL(&statsLockRef());
+
+    xSemaphoreGive(mutexRef());
+  }
+
+  /*
+   * Holds the bus for the lifetime of a scope; check ok() before touching the card
+   */
+  class Guard {
+  public:
+    explicit Guard(Client c, TickType_t wait = portMAX_DELAY)
+      : client_(c), ok_(acquire(c, wait)) {}
+    ~Guard() { if (ok_) release(client_); }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+    bool ok() const { return ok_; }
+
+  private:
+    Client client_;
+    bool   ok_;
+  };
+
+  /*
+   * Returns a consistent snapshot of one client's counters
+   */
+  inline ClientStats stats(Client c) {
+    portENTER_CRITICAL(&statsLockRef());
+    ClientStats s = statsArray()[(uint8_t)c];
+    portEXIT_CRITICAL(&statsLockRef());
+    return s;
+  }
+
+  /*
+   * Renders one client's counters as a single log line
+   * Histogram buckets are <100us, <1ms, <5ms, <20ms, <100ms, >=100ms.
+   */
+  inline int formatStats(char* out, size_t outLen, Client c) {
+    ClientStats s = stats(c);
+    return snprintf(out, outLen,
+                    "SdBus %s: acq=%lu timeouts=%lu deferred=%lu "
+                    "wait avg/max=%lu/%lu us hold max=%lu us hist=%lu/%lu/%lu/%lu/%lu/%lu",
+                    clientName(c),
+                    (unsigned long)s.acquired, (unsigned long)s.timeouts,
+                    (unsigned long)s.deferred,
+                    (unsigned long)(s.acquired ? s.waitTotalUs / s.acquired : 0),
+                    (unsigned long)s.waitMaxUs, (unsigned long)s.holdMaxUs,
+                    (unsigned long)s.waitHist[0], (unsigned long)s.waitHist[1],
+                    (unsigned long)s.waitHist[2], (unsigned long)s.waitHist[3],
+                    (unsigned long)s.waitHist[4], (unsigned long)s.waitHist[5]);
+  }
+
+} // namespace SdBus
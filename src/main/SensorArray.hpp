@@ -0,0 +1,792 @@
+/*
+ * Ranging Sensor Acquisition
+ *
+ * Runs the three VL53L0X Time-of-Flight sensors in back-to-back continuous ranging
+ * mode so they all measure in parallel, instead of one blocking single-shot ranging
+ * per sensor. Each measurement is collected and timestamped the moment the sensor
+ * reports it complete, either via the GPIO1 data-ready interrupt or by timed polling
+ * when GPIO1 is not wired. Samples are grouped into frames for the gesture pipeline.
+ * Optionally duty-cycles the sensors: a slow idle scan while nothing is in the
+ * gesture band, full rate with a short timing budget as soon as something is.
+ * Sensors may sit on two I2C buses; the second bus is read out by its own task,
+ * so readouts on the two buses overlap instead of queuing on one controller.
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <Adafruit_VL53L0X.h>
+#include <stdio.h>
+
+#include <Logger.hpp>
+#include <Profiler.hpp>
+#include <TaskConfig.hpp>
+
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+  #include "freertos/queue.h"
+  #include "freertos/semphr.h"
+}
+
+// VL53L0X supply current while ranging and between measurements (datasheet typ.),
+// used to estimate the sensors' average draw from the duty cycle
+#ifndef SENSORARRAY_RANGING_UA
+#define SENSORARRAY_RANGING_UA 19000
+#endif
+
+#ifndef SENSORARRAY_STANDBY_UA
+#define SENSORARRAY_STANDBY_UA 5
+#endif
+
+namespace SensorArray {
+
+  static const uint8_t NUM_SENSORS = 3;
+  static const uint8_t NUM_BUSES   = 2;  // bus 0: read by the caller, bus 1: by its own task
+
+  // Distance reported for out-of-range / failed measurements
+  static const uint16_t INVALID_MM = 0xFFFF;
+
+  /*
+   * A single completed measurement from one sensor
+   * tUs is the micros() time at which the sensor signalled data-ready.
+   */
+  struct RangeSample {
+    uint8_t  sensor   = 0;
+    uint16_t distance = INVALID_MM;
+    uint32_t tUs      = 0;
+  };
+
+  /*
+   * One fresh sample from every sensor, with each sensor's own timestamp
+   * Sensors that produced nothing before the frame timeout report INVALID_MM.
+   */
+  struct SensorFrame {
+    uint16_t d[NUM_SENSORS]   = { INVALID_MM, INVALID_MM, INVALID_MM };
+    uint32_t tUs[NUM_SENSORS] = { 0, 0, 0 };
+  };
+
+  /*
+   * Power/performance modes for duty-cycled sensing
+   * Active: all sensors, full rate, short timing budget, while a hand may be present.
+   * Idle:   a low-rate scan on a subset of sensors while nothing is in the band.
+   */
+  enum class Mode : uint8_t { Active = 0, Idle = 1 };
+  static const uint8_t MODE_COUNT = 2;
+
+  /*
+   * How the sensors range in one mode
+   * budgetUs = 0 uses each sensor's own budget from its SensorConfig.
+   */
+  struct ModeConfig {
+    uint8_t  sensorMask = 0x07;   // bit i set = sensor i ranges in this mode
+    uint16_t periodMs   = 33;     // inter-measurement period
+    uint32_t budgetUs   = 0;      // measurement timing budget
+  };
+
+  /*
+   * Duty-cycle counters; wake latency runs from the idle frame that saw something
+   * in the band to the first complete full-rate frame, i.e. what the switch adds
+   * to the start of an episode.
+   */
+  struct PowerStats {
+    uint32_t wakeups        = 0;
+    uint32_t sleeps         = 0;
+    uint32_t switchFailures = 0;
+    uint32_t activeFrames   = 0;
+    uint32_t idleFrames     = 0;
+    uint64_t activeUs       = 0;
+    uint64_t idleUs         = 0;
+    uint32_t wakeLastUs     = 0;
+    uint32_t wakeMaxUs      = 0;
+    uint64_t wakeTotalUs    = 0;
+  };
+
+  /*
+   * Per-sensor ranging configuration, applied once at init
+   * Starts from one of the library's sense profiles and then overrides single
+   * parameters; zero fields keep the profile's value. Shorter budgets give a
+   * higher frame rate but noisier distances, so pair changes here with the
+   * GesturePreprocessor band/swing thresholds. VCSEL periods are set before the
+   * budget, since changing them invalidates the budget's internal timeouts.
+   */
+  struct SensorConfig {
+    Adafruit_VL53L0X::VL53L0X_Sense_config_t profile =
+      Adafruit_VL53L0X::VL53L0X_SENSE_DEFAULT;
+    uint32_t budgetUs        = 0;     // measurement timing budget (>= 20000)
+    uint8_t  vcselPrePclks   = 0;     // pre-range VCSEL period: 12..18, even
+    uint8_t  vcselFinalPclks = 0;     // final-range VCSEL period: 8..14, even
+    float    signalRateMcps  = 0.0f;  // minimum return signal rate
+    float    sigmaMm         = 0.0f;  // maximum range sigma
+  };
+
+  // Library profiles plus their usual parameters (ST API user manual, ranging profiles)
+  inline SensorConfig defaultConfig() {
+    return SensorConfig();
+  }
+
+  inline SensorConfig highSpeedConfig() {
+    SensorConfig c;
+    c.profile        = Adafruit_VL53L0X::VL53L0X_SENSE_HIGH_SPEED;
+    c.budgetUs       = 20000;
+    c.signalRateMcps = 0.25f;
+    c.sigmaMm        = 32.0f;
+    return c;
+  }
+
+  inline SensorConfig highAccuracyConfig() {
+    SensorConfig c;
+    c.profile        = Adafruit_VL53L0X::VL53L0X_SENSE_HIGH_ACCURACY;
+    c.budgetUs       = 200000;
+    c.signalRateMcps = 0.25f;
+    c.sigmaMm        = 18.0f;
+    return c;
+  }
+
+  inline SensorConfig longRangeConfig() {
+    SensorConfig c;
+    c.profile         = Adafruit_VL53L0X::VL53L0X_SENSE_LONG_RANGE;
+    c.budgetUs        = 33000;
+    c.vcselPrePclks   = 18;
+    c.vcselFinalPclks = 14;
+    c.signalRateMcps  = 0.1f;
+    c.sigmaMm         = 60.0f;
+    return c;
+  }
+
+  /*
+   * Result of the startup self-test for one sensor
+   */
+  struct SelfTestResult {
+    uint16_t samples         = 0;
+    uint16_t invalid         = 0;      // out of range / failed status
+    uint32_t rateMilliHz     = 0;      // achieved sample rate
+    uint32_t expectedMilliHz = 0;
+    bool     ok              = false;  // ranging and within 80% of the expected rate
+  };
+
+  // ========= internal state =========
+
+  static Adafruit_VL53L0X* g_sensors[NUM_SENSORS] = { nullptr, nullptr, nullptr };
+  static int8_t            g_irqPin[NUM_SENSORS]  = { -1, -1, -1 };
+  static bool              g_present[NUM_SENSORS] = { false, false, false };  // started in begin()
+  static bool              g_active[NUM_SENSORS]  = { false, false, false };  // ranging right now
+  static uint16_t          g_periodMs             = 33;
+  static uint32_t          g_baseBudgetUs[NUM_SENSORS] = { 33000, 33000, 33000 };  // from SensorConfig
+  static uint8_t           g_bus[NUM_SENSORS]     = { 0, 0, 0 };
+
+  // Second-bus readout: worker task, the samples it read, and a lock for its I2C bus
+  static TaskHandle_t      g_auxTask = nullptr;
+  static QueueHandle_t     g_auxQ    = nullptr;
+  static SemaphoreHandle_t g_auxLock = nullptr;
+
+  // Duty-cycle state, only touched from the task that reads frames
+  static ModeConfig g_modeCfg[MODE_COUNT];
+  static Mode       g_mode         = Mode::Active;
+  static uint32_t   g_idleAfterUs  = 0;      // 0 = duty cycling disabled
+  static uint32_t   g_modeSinceUs  = 0;
+  static uint32_t   g_lastNearUs   = 0;
+  static uint32_t   g_wakeFromUs   = 0;
+  static bool       g_wakePending  = false;
+  static PowerStats g_power;
+
+  // Written by the data-ready ISR, consumed by poll()
+  static volatile bool     g_irqPending[NUM_SENSORS] = { false, false, false };
+  static volatile uint32_t g_irqUs[NUM_SENSORS]      = { 0, 0, 0 };
+
+  // Task blocked in readFrame(), woken by the data-ready ISR
+  static volatile TaskHandle_t g_waitTask = nullptr;
+
+  // Frame assembly state
+  static RangeSample g_pending[NUM_SENSORS];
+  static bool        g_havePending[NUM_SENSORS] = { false, false, false };
+  static uint8_t     g_nextPoll[NUM_BUSES] = { 0, 0 };  // per bus; each bus has one reader
+
+  /*
+   * GPIO1 data-ready interrupt (falling edge, sensor drives it low)
+   * Only timestamps the sample; the I2C readout happens in task context.
+   */
+  static void IRAM_ATTR dataReadyISR(void* arg) {
+    uint8_t i = (uint8_t)(uintptr_t)arg;
+    g_irqUs[i]      = micros();
+    g_irqPending[i] = true;
+
+    TaskHandle_t t = g_bus[i] ? g_auxTask : g_waitTask;
+    if (t) {
+      BaseType_t woken = pdFALSE;
+      vTaskNotifyGiveFromISR(t, &woken);
+      portYIELD_FROM_ISR(woken);
+    }
+  }
+
+  /*
+   * Holds the second bus against its worker while the caller reconfigures sensors
+   * No-op when there is no second bus.
+   */
+  class AuxLock {
+  public:
+    AuxLock()  : held_(g_auxLock && xSemaphoreTake(g_auxLock, portMAX_DELAY) == pdTRUE) {}
+    ~AuxLock() { if (held_) xSemaphoreGive(g_auxLock); }
+
+    AuxLock(const AuxLock&) = delete;
+    AuxLock& operator=(const AuxLock&) = delete;
+
+  private:
+    bool held_;
+  };
+
+  /*
+   * Returns true if at least one sensor is ranging
+   */
+  inline bool anyActive() {
+    for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+      if (g_active[i]) return true;
+    }
+    return false;
+  }
+
+  /*
+   * Reads out one completed measurement from a sensor on the given bus (non-blocking)
+   * Sensors are checked round-robin so a fast sensor cannot starve the others.
+   * Interrupt-driven sensors are timestamped in the ISR; polled ones when the
+   * poll first sees them complete.
+   */
+  inline bool pollBus(uint8_t bus, RangeSample &out) {
+    for (uint8_t k = 0; k < NUM_SENSORS; ++k) {
+      uint8_t i = (uint8_t)((g_nextPoll[bus] + k) % NUM_SENSORS);
+      if (!g_active[i] || g_bus[i] != bus) continue;
+
+      Adafruit_VL53L0X* s = g_sensors[i];
+      uint32_t tUs;
+
+      if (g_irqPin[i] >= 0) {
+        if (!g_irqPending[i]) continue;
+        g_irqPending[i] = false;
+        tUs = g_irqUs[i];
+      } else {
+        if (!s->isRangeComplete()) continue;
+        tUs = micros();
+      }
+
+      uint16_t mm;
+      uint8_t  st;
+      {
+        PROFILE_SCOPE(Profiler::Probe::SensorRead);
+        mm = s->readRange();
+        st = s->readRangeStatus();
+      }
+      if (g_irqPin[i] >= 0) s->clearInterruptMask(false);
+
+      out.sensor   = i;
+      out.distance = (st != 4) ? mm : INVALID_MM;
+      out.tUs      = tUs;
+
+      g_nextPoll[bus] = (uint8_t)((i + 1) % NUM_SENSORS);
+      return true;
+    }
+    return false;
+  }
+
+  /*
+   * Second-bus worker: reads its sensors as they complete and hands the
+   * samples to poll(), waking the frame reader
+   */
+  static void auxBusTask(void*) {
+    for (;;) {
+      RangeSample s;
+      bool got;
+      {
+        AuxLock lock;
+        got = pollBus(1, s);
+      }
+      if (got) {
+        xQueueSend(g_auxQ, &s, 0);  // a full queue drops the sample, like a late sensor
+        TaskHandle_t t = g_waitTask;
+        if (t) xTaskNotifyGive(t);
+        continue;
+      }
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1));
+    }
+  }
+
+  /*
+   * Starts the second-bus worker if any sensor is on bus 1
+   * Runs at SENSORARRAY_AUX_TASK_PRIO, the frame reader's priority, since it is
+   * the same readout, just on another controller. Returns false if the worker
+   * was needed but could not be created.
+   */
+  inline bool startAuxBus() {
+    bool needed = false;
+    for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+      if (g_present[i] && g_bus[i] == 1) needed = true;
+    }
+    if (!needed || g_auxTask) return true;
+
+    if (!g_auxQ)    g_auxQ    = xQueueCreate(2 * NUM_SENSORS, sizeof(RangeSample));
+    if (!g_auxLock) g_auxLock = xSemaphoreCreateMutex();
+    if (!g_auxQ || !g_auxLock ||
+        xTaskCreatePinnedToCore(auxBusTask, "sensorBus1", SENSORARRAY_AUX_TASK_STACK, nullptr,
+                                SENSORARRAY_AUX_TASK_PRIO, &g_auxTask, SENSOR_TASK_CORE) != pdPASS) {
+      g_auxTask = nullptr;
+      Logger::log(Logger::Level::Error, "SensorArray: second I2C bus worker failed to start");
+      LOGGER_DEBUG(Serial.println("SensorArray: second I2C bus worker failed to start"));
+      return false;
+    }
+    return true;
+  }
+
+  /*
+   * Reads out one completed measurement, if any sensor has one (non-blocking)
+   * Samples the second-bus worker already read come first, then bus 0.
+   */
+  inline bool poll(RangeSample &out) {
+    if (g_auxQ && xQueueReceive(g_auxQ, &out, 0) == pdTRUE) return true;
+    return pollBus(0, out);
+  }
+
+  /*
+   * Applies everything in cfg beyond the sense profile to an initialized sensor
+   * The profile itself is passed to Adafruit_VL53L0X::begin(). Returns false if
+   * the sensor rejected any parameter; the rest are still applied.
+   */
+  inline bool configureSensor(Adafruit_VL53L0X &s, const SensorConfig &cfg) {
+    bool ok = true;
+    if (cfg.vcselPrePclks &&
+        !s.setVcselPulsePeriod(VL53L0X_VCSEL_PERIOD_PRE_RANGE, cfg.vcselPrePclks)) ok = false;
+    if (cfg.vcselFinalPclks &&
+        !s.setVcselPulsePeriod(VL53L0X_VCSEL_PERIOD_FINAL_RANGE, cfg.vcselFinalPclks)) ok = false;
+    if (cfg.signalRateMcps > 0.0f &&
+        !s.setLimitCheckValue(VL53L0X_CHECKENABLE_SIGNAL_RATE_FINAL_RANGE,
+                              (FixPoint1616_t)(cfg.signalRateMcps * 65536.0f))) ok = false;
+    if (cfg.sigmaMm > 0.0f &&
+        !s.setLimitCheckValue(VL53L0X_CHECKENABLE_SIGMA_FINAL_RANGE,
+                              (FixPoint1616_t)(cfg.sigmaMm * 65536.0f))) ok = false;
+    if (cfg.budgetUs && !s.setMeasurementTimingBudgetMicroSeconds(cfg.budgetUs)) ok = false;
+    return ok;
+  }
+
+  /*
+   * Puts every initialized sensor into continuous ranging mode
+   * sensors[] must already be addressed (see initSensor in main.ino); entries that
+   * are null or fail to start are skipped. irqPins[] gives the ESP32 pin wired to
+   * each sensor's GPIO1, or -1 to fall back to polling that sensor.
+   * periodMs is the inter-measurement period; setting it at or below the sensor's
+   * timing budget makes the sensor range back-to-back.
+   * buses[] gives the I2C bus (0 or 1) each sensor was initialized on, or null
+   * for all on bus 0; sensors on bus 1 are read by a worker task.
+   */
+  inline bool begin(Adafruit_VL53L0X* const sensors[NUM_SENSORS],
+                    const int8_t irqPins[NUM_SENSORS],
+                    uint16_t periodMs = 33,
+                    const uint8_t buses[NUM_SENSORS] = nullptr) {
+    g_periodMs = periodMs;
+    g_nextPoll[0] = g_nextPoll[1] = 0;
+
+    for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+      g_sensors[i]     = sensors[i];
+      g_irqPin[i]      = irqPins ? irqPins[i] : -1;
+      g_bus[i]         = (buses && buses[i] < NUM_BUSES) ? buses[i] : 0;
+      g_present[i]     = false;
+      g_active[i]      = false;
+      g_havePending[i] = false;
+      g_irqPending[i]  = false;
+
+      Adafruit_VL53L0X* s = g_sensors[i];
+      if (!s) continue;
+
+      // Mode switches restore this when their own budget is 0
+      uint32_t budget = s->getMeasurementTimingBudgetMicroSeconds();
+      g_baseBudgetUs[i] = budget ? budget : 33000;
+
+      if (g_irqPin[i] >= 0) {
+        if (s->setGpioConfig(VL53L0X_DEVICEMODE_CONTINUOUS_RANGING,
+                             VL53L0X_GPIOFUNCTIONALITY_NEW_MEASURE_READY,
+                             VL53L0X_INTERRUPTPOLARITY_LOW) != VL53L0X_ERROR_NONE) {
+          Logger::logf(Logger::Level::Warn,
+                       "SensorArray: GPIO1 config failed on sensor %u, polling instead",
+                       i);
+          LOGGER_DEBUG(
+            Serial.print("SensorArray: GPIO1 config failed, polling sensor ");
+            Serial.println(i);
+          );
+          g_irqPin[i] = -1;
+        } else {
+          pinMode(g_irqPin[i], INPUT_PULLUP);
+          attachInterruptArg(digitalPinToInterrupt(g_irqPin[i]),
+                             dataReadyISR,
+                             (void*)(uintptr_t)i,
+                             FALLING);
+        }
+      }
+
+      if (!s->startRangeContinuous(g_periodMs)) {
+        Logger::logf(Logger::Level::Error,
+                     "SensorArray: continuous start failed on sensor %u",
+                     i);
+        LOGGER_DEBUG(
+          Serial.print("SensorArray: continuous start failed on sensor ");
+          Serial.println(i);
+        );
+        if (g_irqPin[i] >= 0) detachInterrupt(digitalPinToInterrupt(g_irqPin[i]));
+        continue;
+      }
+
+      if (g_irqPin[i] >= 0) s->clearInterruptMask(false);
+      g_present[i] = true;
+      g_active[i]  = true;
+    }
+
+    g_mode        = Mode::Active;
+    g_idleAfterUs = 0;
+    g_modeSinceUs = micros();
+
+    if (!startAuxBus()) {
+      // Without the worker nobody reads bus 1; keep those sensors out of frames
+      for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+        if (g_bus[i] && g_active[i]) {
+          g_sensors[i]->stopRangeContinuous();
+          g_active[i] = false;
+        }
+      }
+    }
+    return anyActive();
+  }
+
+  /*
+   * Stops continuous ranging on all sensors and detaches interrupts
+   */
+  inline void stop() {
+    AuxLock lock;
+    for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+      if (!g_present[i]) continue;
+      if (g_irqPin[i] >= 0) detachInterrupt(digitalPinToInterrupt(g_irqPin[i]));
+      if (g_active[i]) g_sensors[i]->stopRangeContinuous();
+      g_active[i]  = false;
+      g_present[i] = false;
+    }
+  }
+
+  /*
+   * Blocks until every active sensor has delivered a fresh sample, then returns them as a frame
+   * If some sensor is late by more than timeoutMs after the first sample of the
+   * frame (or nothing arrives within timeoutMs at all), the frame is emitted anyway
+   * with the missing sensors marked INVALID_MM, so a dead sensor cannot stall the
+   * pipeline. Returns false if no sensor is ranging.
+   */
+  inline bool readFrame(SensorFrame &frame, uint32_t timeoutMs) {
+    if (!anyActive()) return false;
+
+    bool anyIrq = false;
+    for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+      if (g_active[i] && g_irqPin[i] >= 0) anyIrq = true;
+    }
+    if (g_auxTask) anyIrq = true;  // the worker notifies too
+    g_waitTask = xTaskGetCurrentTaskHandle();
+
+    uint32_t enterUs = micros();
+    uint32_t firstUs = 0;
+    bool     started = false;
+
+    for (;;) {
+      RangeSample s;
+      while (poll(s)) {
+        if (!started) {
+          started = true;
+          firstUs = s.tUs;
+        }
+        // Newer sample for a sensor already in this frame replaces the old one
+        g_pending[s.sensor]     = s;
+        g_havePending[s.sensor] = true;
+      }
+
+      bool complete = true;
+      for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+        if (g_active[i] && !g_havePending[i]) complete = false;
+      }
+
+      uint32_t refUs = started ? firstUs : enterUs;
+      bool late = (micros() - refUs) >= timeoutMs * 1000u;
+
+      if (complete || late) break;
+
+      // Sleep until the next data-ready edge, or re-poll after one tick
+      if (anyIrq) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1));
+      } else {
+        vTaskDelay(pdMS_TO_TICKS(1));
+      }
+    }
+
+    g_waitTask = nullptr;
+
+    for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+      if (g_havePending[i]) {
+        frame.d[i]   = g_pending[i].distance;
+        frame.tUs[i] = g_pending[i].tUs;
+      } else {
+        frame.d[i]   = INVALID_MM;
+        frame.tUs[i] = micros();
+      }
+      g_havePending[i] = false;
+    }
+    return true;
+  }
+
+  /*
+   * Measures each ranging sensor's achieved sample rate over windowMs
+   * Polls the sensors directly, so run it before the sensor task starts. The
+   * expected rate follows from the longer of the sensor's budget and the
+   * ranging period. Logs one line per sensor; returns true if all ranging
+   * sensors reached at least 80% of their expected rate.
+   */
+  inline bool selfTest(uint32_t windowMs, SelfTestResult results[NUM_SENSORS]) {
+    for (uint8_t i = 0; i < NUM_SENSORS; ++i) results[i] = SelfTestResult();
+
+    const uint32_t startUs = micros();
+    while (micros() - startUs < windowMs * 1000u) {
+      RangeSample smp;
+      bool any = false;
+      while (poll(smp)) {
+        any = true;
+        SelfTestResult &r = results[smp.sensor];
+        if (r.samples < 0xFFFF) r.samples++;
+        if (smp.distance == INVALID_MM && r.invalid < 0xFFFF) r.invalid++;
+      }
+      if (!any) vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    const uint32_t elapsedUs = micros() - startUs;
+
+    bool allOk = true;
+    for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+      SelfTestResult &r = results[i];
+      if (!g_active[i]) continue;
+
+      uint32_t budgetUs;
+      {
+        AuxLock lock;
+        budgetUs = g_sensors[i]->getMeasurementTimingBudgetMicroSeconds();
+      }
+      if (!budgetUs) budgetUs = g_baseBudgetUs[i];
+      uint32_t cycleUs = (uint32_t)g_periodMs * 1000u;
+      if (budgetUs > cycleUs) cycleUs = budgetUs;
+
+      r.rateMilliHz     = elapsedUs ? (uint32_t)((uint64_t)r.samples * 1000000000ull / elapsedUs) : 0;
+      r.expectedMilliHz = cycleUs ? (uint32_t)(1000000000ull / cycleUs) : 0;
+      r.ok = r.samples > 0 && (uint64_t)r.rateMilliHz * 5 >= (uint64_t)r.expectedMilliHz * 4;
+      if (!r.ok) allOk = false;
+
+      Logger::logf(r.ok ? Logger::Level::Info : Logger::Level::Warn,
+                   "SensorArray: sensor %u self-test %lu.%03lu Hz (expected %lu.%03lu), "
+                   "%u samples, %u invalid, budget %lu us",
+                   i,
+                   (unsigned long)(r.rateMilliHz / 1000), (unsigned long)(r.rateMilliHz % 1000),
+                   (unsigned long)(r.expectedMilliHz / 1000), (unsigned long)(r.expectedMilliHz % 1000),
+                   r.samples, r.invalid, (unsigned long)budgetUs);
+      LOGGER_DEBUG(
+        Serial.print("SensorArray: sensor ");
+        Serial.print(i);
+        Serial.print(" self-test mHz=");
+        Serial.print(r.rateMilliHz);
+        Serial.print(" expected=");
+        Serial.println(r.expectedMilliHz);
+      );
+    }
+    return allOk;
+  }
+
+  // ========= duty-cycled sensing =========
+
+  /*
+   * Restarts continuous ranging with one mode's sensor set, period and budget
+   * Sensors outside the mask are stopped (they drop to standby between
+   * measurements anyway, but stopped sensors draw nothing for ranging). Call from
+   * the task that reads frames. Returns false if no sensor could be started.
+   */
+  inline bool applyMode(Mode m) {
+    const ModeConfig& c = g_modeCfg[(uint8_t)m];
+    bool any = false;
+    AuxLock lock;
+
+    for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+      if (!g_present[i]) continue;
+      Adafruit_VL53L0X* s = g_sensors[i];
+
+      if (g_active[i]) {
+        s->stopRangeContinuous();
+        g_active[i] = false;
+      }
+      g_havePending[i] = false;
+      g_irqPending[i]  = false;
+
+      if (!(c.sensorMask & (1u << i))) continue;
+
+      const uint32_t budgetUs = c.budgetUs ? c.budgetUs : g_baseBudgetUs[i];
+      if (!s->setMeasurementTimingBudgetMicroSeconds(budgetUs)) {
+        Logger::logf(Logger::Level::Warn,
+                     "SensorArray: timing budget %lu us rejected by sensor %u",
+                     (unsigned long)budgetUs, i);
+      }
+      if (!s->startRangeContinuous(c.periodMs)) {
+        Logger::logf(Logger::Level::Error,
+                     "SensorArray: continuous restart failed on sensor %u", i);
+        LOGGER_DEBUG(
+          Serial.print("SensorArray: continuous restart failed on sensor ");
+          Serial.println(i);
+        );
+        continue;
+      }
+      if (g_irqPin[i] >= 0) s->clearInterruptMask(false);
+      g_active[i] = true;
+      any = true;
+    }
+
+    const uint32_t now = micros();
+    if (g_mode == Mode::Active) g_power.activeUs += now - g_modeSinceUs;
+    else                        g_power.idleUs   += now - g_modeSinceUs;
+    g_modeSinceUs = now;
+    g_mode        = m;
+    g_periodMs    = c.periodMs;
+    g_nextPoll[0] = g_nextPoll[1] = 0;
+    if (g_auxQ) xQueueReset(g_auxQ);
+    return any;
+  }
+
+  /*
+   * Sets the two mode configurations and switches to Active
+   * idleAfterMs is how long no sensor may see anything in the band before the
+   * idle scan takes over; 0 keeps the sensors in Active permanently. Call after
+   * begin() and before (or from) the task that reads frames.
+   */
+  inline bool configureModes(const ModeConfig& active, const ModeConfig& idle,
+                             uint32_t idleAfterMs) {
+    g_modeCfg[(uint8_t)Mode::Active] = active;
+    g_modeCfg[(uint8_t)Mode::Idle]   = idle;
+    g_idleAfterUs = idleAfterMs * 1000u;
+    g_lastNearUs  = micros();
+    g_wakePending = false;
+    return applyMode(Mode::Active);
+  }
+
+  inline Mode mode() {
+    return g_mode;
+  }
+
+  // Current inter-measurement period; frame timeouts should scale with it
+  inline uint16_t periodMs() {
+    return g_periodMs;
+  }
+
+  /*
+   * Feeds the duty-cycle policy with the frame just read
+   * near is true if any sensor saw something in the gesture band. An idle frame
+   * with near set switches to Active immediately; Active falls back to Idle after
+   * idleAfterMs without anything near. Returns the mode for the next frame.
+   */
+  inline Mode updateMode(const SensorFrame& frame, bool near) {
+    if (!g_idleAfterUs) return g_mode;
+
+    uint32_t newestUs = frame.tUs[0];
+    for (uint8_t i = 1; i < NUM_SENSORS; ++i) {
+      if ((int32_t)(frame.tUs[i] - newestUs) > 0) newestUs = frame.tUs[i];
+    }
+
+    if (g_mode == Mode::Idle) {
+      g_power.idleFrames++;
+      if (!near) return g_mode;
+
+      g_wakeFromUs  = newestUs;
+      g_wakePending = true;
+      g_lastNearUs  = micros();
+      g_power.wakeups++;
+      if (!applyMode(Mode::Active)) {
+        g_power.switchFailures++;
+        g_wakePending = false;
+        applyMode(Mode::Idle);
+      }
+      return g_mode;
+    }
+
+    g_power.activeFrames++;
+    if (g_wakePending) {
+      const uint32_t us = newestUs - g_wakeFromUs;
+      g_power.wakeLastUs   = us;
+      g_power.wakeTotalUs += us;
+      if (us > g_power.wakeMaxUs) g_power.wakeMaxUs = us;
+      g_wakePending = false;
+    }
+
+    const uint32_t now = micros();
+    if (near) {
+      g_lastNearUs = now;
+    } else if (now - g_lastNearUs >= g_idleAfterUs) {
+      g_power.sleeps++;
+      if (!applyMode(Mode::Idle)) {
+        g_power.switchFailures++;
+        applyMode(Mode::Active);
+      }
+    }
+    return g_mode;
+  }
+
+  /*
+   * Estimated average sensor supply current in one mode (uA)
+   * Each ranging sensor draws SENSORARRAY_RANGING_UA for its timing budget out of
+   * every period and SENSORARRAY_STANDBY_UA otherwise; stopped sensors draw standby.
+   */
+  inline uint32_t modeCurrentUa(Mode m) {
+    const ModeConfig& c = g_modeCfg[(uint8_t)m];
+    uint32_t ua = 0;
+    for (uint8_t i = 0; i < NUM_SENSORS; ++i) {
+      if (!g_present[i]) continue;
+      uint32_t budgetUs = c.budgetUs ? c.budgetUs : g_baseBudgetUs[i];
+      uint32_t periodUs = (uint32_t)c.periodMs * 1000u;
+      uint32_t dutyPpm  = 0;
+      if (c.sensorMask & (1u << i)) {
+        dutyPpm = (periodUs == 0 || budgetUs >= periodUs)
+                  ? 1000000u : (uint32_t)((uint64_t)budgetUs * 1000000u / periodUs);
+      }
+      ua += (uint32_t)(((uint64_t)SENSORARRAY_RANGING_UA * dutyPpm +
+                        (uint64_t)SENSORARRAY_STANDBY_UA * (1000000u - dutyPpm)) / 1000000u);
+    }
+    return ua;
+  }
+
+  /*
+   * Returns the duty-cycle counters, with time in the current mode included
+   */
+  inline PowerStats powerStats() {
+    PowerStats p = g_power;
+    const uint32_t inMode = micros() - g_modeSinceUs;
+    if (g_mode == Mode::Active) p.activeUs += inMode;
+    else                        p.idleUs   += inMode;
+    return p;
+  }
+
+  /*
+   * Renders the duty-cycle counters and the time-weighted current estimate as one log line
+   */
+  inline int formatPowerStats(char* out, size_t outLen) {
+    PowerStats p = powerStats();
+    const uint64_t totalUs = p.activeUs + p.idleUs;
+    uint32_t avgUa = modeCurrentUa(Mode::Active);
+    if (g_idleAfterUs && totalUs) {
+      avgUa = (uint32_t)(((uint64_t)modeCurrentUa(Mode::Active) * p.activeUs +
+                          (uint64_t)modeCurrentUa(Mode::Idle) * p.idleUs) / totalUs);
+    }
+    return snprintf(out, outLen,
+                    "Sensors: mode=%s active/idle=%lu/%lu s frames=%lu/%lu "
+                    "wakeups=%lu sleeps=%lu failures=%lu wake last/avg/max=%lu/%lu/%lu us "
+                    "est=%lu uA (active %lu, idle %lu)",
+                    g_mode == Mode::Active ? "active" : "idle",
+                    (unsigned long)(p.activeUs / 1000000u), (unsigned long)(p.idleUs / 1000000u),
+                    (unsigned long)p.activeFrames, (unsigned long)p.idleFrames,
+                    (unsigned long)p.wakeups, (unsigned long)p.sleeps,
+                    (unsigned long)p.switchFailures,
+                    (unsigned long)p.wakeLastUs,
+                    (unsigned long)(p.wakeups ? p.wakeTotalUs / p.wakeups : 0),
+                    (unsigned long)p.wakeMaxUs,
+                    (unsigned long)avgUa,
+                    (unsigned long)modeCurrentUa(Mode::Active),
+                    (unsigned long)modeCurrentUa(Mode::Idle));
+  }
+
+} // namespace SensorArray
@@ -1,10 +1,25 @@
 /*
  * Audio Playback System
  * 
- * Handles WAV file playback through I2S to a MAX98357A amplifier.
+ * Handles WAV (and optionally MP3) playback through I2S to a MAX98357A amplifier.
  * Manages a playlist with controls for play/pause, track navigation, and volume adjustment.
- * Runs audio playback in a dedicated FreeRTOS task to avoid blocking gesture recognition.
- * Supports mono and stereo WAV files with automatic format conversion.
+ * Background playback is split into two FreeRTOS tasks: a reader that prefetches
+ * sector-aligned runs of the track file and decodes them into a pool of PCM buffers,
+ * and an output task that only converts and feeds I2S, so SD stalls are absorbed
+ * by the buffered blocks. The decoder stage handles 16-bit PCM, IMA ADPCM and,
+ * with SPEAKER_MP3, MP3 (AudioDecoder.hpp).
+ * Supports mono and stereo tracks with automatic format conversion; blocks that
+ * already match the I2S layout at unity gain are written without any copy.
+ * I2S normally follows each track's sample rate; with SPEAKER_FIXED_RATE it stays
+ * at one rate and other tracks are resampled in the output task instead, so
+ * switching tracks never restarts the peripheral and any two tracks can crossfade.
+ * Volume changes, pause and track starts are ramped per sample, and next/prev
+ * can crossfade the outgoing track into the new one, so nothing hard-cuts.
+ * The reader takes the SD bus (SdBus) at audio priority for every card access and
+ * reports when its prefetch queue runs low, so other SD users back off.
+ * Controls are timestamped commands on FreeRTOS queues (safe from tasks and
+ * ISRs), and the time from each command to the block that makes it audible is
+ * tracked in Stats.
  */
 
 #pragma once
@@ -14,14 +29,92 @@
 #include <string.h>
 
 #include <Logger.hpp>
+#include <AudioKernel.hpp>
+#include <AudioDecoder.hpp>
+#include <Profiler.hpp>
+#include <SdBus.hpp>
+#include <TaskConfig.hpp>
+
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+  #include "freertos/queue.h"
+}
+
+// Number of prefetch buffers between the SD reader and the I2S output task
+#ifndef SPEAKER_PREFETCH_BUFFERS
+#define SPEAKER_PREFETCH_BUFFERS 4
+#endif
+
+// Parsed track headers kept in RAM so re-opening a track skips parseTrackHeader
+#ifndef SPEAKER_INFO_CACHE
+#define SPEAKER_INFO_CACHE 4
+#endif
+
+// Size of each prefetch buffer; a multiple of the 512-byte SD sector
+#ifndef SPEAKER_BLOCK_BYTES
+#define SPEAKER_BLOCK_BYTES 4096
+#endif
+
+// Length of the gain ramp used for volume changes, pause/resume and track starts
+#ifndef SPEAKER_RAMP_MS
+#define SPEAKER_RAMP_MS 20
+#endif
+
+// Equal-power crossfade on next/prev; 0 = cut over with a ramp-in instead
+#ifndef SPEAKER_XFADE_MS
+#define SPEAKER_XFADE_MS 250
+#endif
+
+// Depth of each control command queue
+#ifndef SPEAKER_CMD_QUEUE
+#define SPEAKER_CMD_QUEUE 16
+#endif
+
+// Longest track path handed over by the track source, terminator included
+#ifndef SPEAKER_PATH_MAX
+#define SPEAKER_PATH_MAX 96
+#endif
+
+// 1 = run I2S in stereo slot mode so stereo files stream without a downmix
+#ifndef SPEAKER_I2S_STEREO
+#define SPEAKER_I2S_STEREO 0
+#endif
+
+// I2S rate in Hz kept for every track, other rates are resampled; 0 = reconfigure I2S per track
+#ifndef SPEAKER_FIXED_RATE
+#define SPEAKER_FIXED_RATE 0
+#endif
+
+// Resampler used at a fixed rate: 0 = linear, 1 = 8-tap polyphase
+#ifndef SPEAKER_RESAMPLE_QUALITY
+#define SPEAKER_RESAMPLE_QUALITY 1
+#endif
+
+// Output frames per resampling pass (one I2S write each)
+#ifndef SPEAKER_RESAMPLE_FRAMES
+#define SPEAKER_RESAMPLE_FRAMES 512
+#endif
+
+// Per-track input buffer for ADPCM/MP3 data; must hold the largest MP3 frame
+#ifndef SPEAKER_CODED_BYTES
+#define SPEAKER_CODED_BYTES (SPEAKER_MP3 ? 2048 : 1024)
+#endif
+
+// MP3 decoders, lent to the playing and the crossfading-out track
+#ifndef SPEAKER_MP3_STREAMS
+#define SPEAKER_MP3_STREAMS 2
+#endif
 
 namespace Speaker {
 
-  // ========= WAV header parsing =========
+  // ========= Track header parsing =========
 
   /*
-   * Stores parsed WAV file audio format information
-   * Contains sample rate, channel count, and data location within the file.
+   * Stores parsed track format information
+   * Contains sample rate, channel count, codec, and data location within the file.
+   * bitsPerSample is the coded size (4 for IMA ADPCM, 0 for MP3); every codec
+   * decodes to 16-bit PCM.
    */
   struct WavInfo {
     uint32_t sampleRate    = 0;
@@ -29,12 +122,15 @@ namespace Speaker {
     uint16_t bitsPerSample = 0;
     uint32_t dataOffset    = 0;
     uint32_t dataSize      = 0;
+    AudioDecoder::Codec codec = AudioDecoder::Codec::Pcm16;
+    uint16_t blockAlign    = 0;   // bytes per coded block (IMA ADPCM) or frame (PCM)
+    uint32_t byteRate      = 0;   // data bytes per second, for durations
   };
 
   /*
    * Parses the header of a WAV file to extract audio format information
    * Validates the file format and locates the audio data chunk.
-   * Only supports PCM WAV files (the most common uncompressed format).
+   * Supports PCM and IMA ADPCM WAV files.
    */
   inline bool parseWavHeader(File &f, WavInfo &info) {
     if (!f) return false;
@@ -64,15 +160,31 @@ namespace Speaker {
       ((uint32_t)header[25] << 8) |
       ((uint32_t)header[26] << 16) |
       ((uint32_t)header[27] << 24);
+    uint32_t byteRate =
+      (uint32_t)header[28] |
+      ((uint32_t)header[29] << 8) |
+      ((uint32_t)header[30] << 16) |
+      ((uint32_t)header[31] << 24);
+    uint16_t blockAlign =
+      (uint16_t)header[32] |
+      ((uint16_t)header[33] << 8);
     uint16_t bitsPerSample =
       (uint16_t)header[34] |
       ((uint16_t)header[35] << 8);
 
-    if (audioFormat != 1) return false; // PCM only
+    if (audioFormat == AudioDecoder::WAVE_FORMAT_PCM) {
+      info.codec = AudioDecoder::Codec::Pcm16;
+    } else if (audioFormat == AudioDecoder::WAVE_FORMAT_IMA_ADPCM) {
+      info.codec = AudioDecoder::Codec::ImaAdpcm;
+    } else {
+      return false;
+    }
 
     info.sampleRate    = sampleRate;
     info.numChannels   = numChannels;
     info.bitsPerSample = bitsPerSample;
+    info.blockAlign    = blockAlign;
+    info.byteRate      = byteRate;
 
     // Find "data" chunk (fmt chunk can be >16 bytes)
     uint32_t pos = 12 + 8 + fmtChunkSize;
@@ -99,26 +211,139 @@ namespace Speaker {
     }
   }
 
+  /*
+   * Locates the MPEG audio frames of an MP3 file
+   * Skips an ID3v2 tag, then takes the first layer III header that is followed
+   * by another one exactly a frame later, so stray sync bytes in leftover tag
+   * data are not mistaken for audio. A trailing ID3v1 tag is left out of
+   * dataSize. The format comes from that first frame; byteRate is its bitrate,
+   * so durations of VBR files are estimates.
+   */
+  inline bool parseMp3Header(File &f, WavInfo &info) {
+    if (!f) return false;
+
+    const uint32_t size = (uint32_t)f.size();
+    uint8_t        buf[512];
+
+    f.seek(0);
+    if (f.read(buf, 10) != 10) return false;
+    uint32_t start = AudioDecoder::id3v2Size(buf);
+
+    // Look for the first frame within a few KB of where the tag ends
+    const uint32_t limit = start + 4096;
+    for (uint32_t base = start; base < limit && base + 4 < size; base += sizeof(buf) - 3) {
+      if (!f.seek(base)) return false;
+      const size_t n = f.read(buf, sizeof(buf));
+      if (n < 4) return false;
+
+      for (size_t i = 0; i + 4 <= n; ++i) {
+        AudioDecoder::MpegHeader h;
+        if (!AudioDecoder::parseMpegHeader(buf + i, h)) continue;
+
+        const uint32_t at = base + (uint32_t)i;
+        uint8_t next[4];
+        AudioDecoder::MpegHeader h2;
+        if (!f.seek(at + h.frameBytes) || f.read(next, 4) != 4 ||
+            !AudioDecoder::parseMpegHeader(next, h2) || h2.sampleRate != h.sampleRate) {
+          continue;
+        }
+
+        uint32_t end = size;
+        uint8_t  tag[3];
+        if (size >= 128 && f.seek(size - 128) && f.read(tag, 3) == 3 &&
+            memcmp(tag, "TAG", 3) == 0) {
+          end = size - 128;
+        }
+
+        info.codec         = AudioDecoder::Codec::Mp3;
+        info.sampleRate    = h.sampleRate;
+        info.numChannels   = h.channels;
+        info.bitsPerSample = 0;
+        info.blockAlign    = 0;
+        info.byteRate      = h.bitrate / 8;
+        info.dataOffset    = at;
+        info.dataSize      = end > at ? end - at : 0;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  inline bool isMp3Name(const char* path) {
+    const size_t len = path ? strlen(path) : 0;
+    return len > 4 && strcasecmp(path + len - 4, ".mp3") == 0;
+  }
+
+  /*
+   * Parses a track header by file type: .mp3 files as MPEG audio, anything else as WAV
+   */
+  inline bool parseTrackHeader(File &f, WavInfo &info) {
+    return isMp3Name(f.name()) ? parseMp3Header(f, info) : parseWavHeader(f, info);
+  }
+
+  /*
+   * Reports whether the player can stream this format: mono or stereo 16-bit PCM,
+   * IMA ADPCM, or MP3 when built with SPEAKER_MP3
+   */
+  inline bool isPlayable(const WavInfo &info) {
+    if (info.sampleRate == 0 || (info.numChannels != 1 && info.numChannels != 2)) return false;
+    switch (info.codec) {
+      case AudioDecoder::Codec::Pcm16:
+        return info.bitsPerSample == 16;
+      case AudioDecoder::Codec::ImaAdpcm:
+        return info.bitsPerSample == 4 &&
+               AudioDecoder::imaFramesPerBlock(info.blockAlign, (uint8_t)info.numChannels) > 1;
+      case AudioDecoder::Codec::Mp3:
+        return SPEAKER_MP3 != 0;
+    }
+    return false;
+  }
+
+  /*
+   * Track length in milliseconds from the data size and byte rate
+   */
+  inline uint32_t durationMs(const WavInfo &info) {
+    uint32_t byteRate = info.byteRate;
+    if (info.codec == AudioDecoder::Codec::Pcm16 || !byteRate) {
+      byteRate = info.sampleRate * info.numChannels * (info.bitsPerSample / 8);
+    }
+    return byteRate ? (uint32_t)((uint64_t)info.dataSize * 1000 / byteRate) : 0;
+  }
+
   // ========= I2S backend → MAX98357A =========
 
   static I2SClass g_i2s;
   static bool     g_i2sInited = false;
   static uint32_t g_i2sRate   = 44100;
 
+  // Channels per I2S frame, fixed at compile time by SPEAKER_I2S_STEREO
+  static const uint8_t         I2S_CHANNELS  = SPEAKER_I2S_STEREO ? 2 : 1;
+  static const i2s_slot_mode_t I2S_SLOT_MODE = SPEAKER_I2S_STEREO ? I2S_SLOT_MODE_STEREO
+                                                                  : I2S_SLOT_MODE_MONO;
+
+  static volatile AudioKernel::ResampleQuality g_resampleQuality =
+      (AudioKernel::ResampleQuality)SPEAKER_RESAMPLE_QUALITY;
+
   /*
    * Initializes the I2S audio interface connected to MAX98357A amplifier
-   * Configures the I2S pins and sets the default sample rate.
-   * Must be called before any audio playback can occur.
+   * Configures the I2S pins and sets the default sample rate (ignored with
+   * SPEAKER_FIXED_RATE). Must be called before any audio playback can occur.
    */
   inline bool initMax98357A(int bclkPin, int lrckPin, int dataPin,
                             uint32_t defaultRate = 44100) {
+#if SPEAKER_FIXED_RATE
+    (void)defaultRate;
+    g_i2sRate = SPEAKER_FIXED_RATE;
+    AudioKernel::initPolyphase();
+#else
     g_i2sRate = defaultRate;
+#endif
     g_i2s.setPins(bclkPin, lrckPin, dataPin); // BCLK, WS, DOUT
 
     bool ok = g_i2s.begin(I2S_MODE_STD,
                           g_i2sRate,
                           I2S_DATA_BIT_WIDTH_16BIT,
-                          I2S_SLOT_MODE_MONO);
+                          I2S_SLOT_MODE);
     g_i2sInited = ok;
     if (!ok) {
       Logger::log(Logger::Level::Error,
@@ -130,15 +355,16 @@ namespace Speaker {
 
   /*
    * Adjusts the I2S sample rate if needed for the current audio file
-   * Only reconfigures if the rate differs from the current setting.
+   * Only reconfigures if the rate differs from the current setting; never with
+   * SPEAKER_FIXED_RATE, where the caller resamples instead.
    */
   inline bool ensureSampleRate(uint32_t rate) {
     if (!g_i2sInited) return false;
-    if (rate == 0 || rate == g_i2sRate) return true;
+    if (rate == 0 || rate == g_i2sRate || SPEAKER_FIXED_RATE) return true;
 
     if (!g_i2s.configureTX(rate,
                            I2S_DATA_BIT_WIDTH_16BIT,
-                           I2S_SLOT_MODE_MONO)) {
+                           I2S_SLOT_MODE)) {
       Logger::log(Logger::Level::Error,
                   "Speaker::ensureSampleRate: configureTX failed");
       LOGGER_DEBUG(Serial.println("Speaker::ensureSampleRate: configureTX failed"));
@@ -148,11 +374,275 @@ namespace Speaker {
     return true;
   }
 
+  /*
+   * Selects the resampler for tracks started from now on (SPEAKER_FIXED_RATE only)
+   */
+  inline void setResampleQuality(AudioKernel::ResampleQuality q) {
+    g_resampleQuality = q;
+  }
+
+  /*
+   * Writes a whole buffer to I2S, blocking until the DMA has accepted all of it
+   */
+  inline void i2sWriteAll(const uint8_t* data, size_t bytes) {
+    size_t written = 0;
+    while (written < bytes) {
+      PROFILE_SCOPE(Profiler::Probe::I2sWrite);
+      written += g_i2s.write(data + written, bytes - written);
+    }
+  }
+
+  // ========= SD access =========
+  // Every card access from the player goes through SdBus at audio priority
+
+  inline File busOpen(const char* path) {
+    SdBus::Guard bus(SdBus::Client::Audio);
+    return SD.open(path);
+  }
+
+  inline size_t busRead(File &f, uint8_t* buf, size_t n) {
+    SdBus::Guard bus(SdBus::Client::Audio);
+    PROFILE_SCOPE(Profiler::Probe::SdRead);
+    return f.read(buf, n);
+  }
+
+  inline bool busSeek(File &f, uint32_t pos) {
+    SdBus::Guard bus(SdBus::Client::Audio);
+    return f.seek(pos);
+  }
+
+  inline void busClose(File &f) {
+    SdBus::Guard bus(SdBus::Client::Audio);
+    f.close();
+  }
+
+  inline bool busParseTrackHeader(File &f, WavInfo &info) {
+    SdBus::Guard bus(SdBus::Client::Audio);
+    return parseTrackHeader(f, info);
+  }
+
+  // ========= Decoder stage =========
+  // Turns a track's data bytes into 16-bit PCM frames for both players
+
+  static_assert(SPEAKER_CODED_BYTES % 512 == 0, "SPEAKER_CODED_BYTES must be sector-aligned");
+
+  // Data bytes read from SD for playback
+  static uint64_t g_bytesRead = 0;
+
+  /*
+   * An open track and its decoder state
+   * remaining counts data bytes not yet read from f. ADPCM and MP3 tracks read
+   * into `coded` and keep the input the decoder has not consumed yet at
+   * coded[codedPos..codedLen).
+   */
+  struct TrackStream {
+    File     f;
+    WavInfo  info;
+    uint32_t remaining = 0;
+    uint8_t* coded     = nullptr;  // SPEAKER_CODED_BYTES, owned by the caller; unused for PCM
+    uint16_t codedPos  = 0;
+    uint16_t codedLen  = 0;
+    AudioDecoder::ImaDecoder ima;
+#if SPEAKER_MP3
+    AudioDecoder::Mp3Stream* mp3 = nullptr;  // from g_mp3Pool while decoding
+#endif
+  };
+
+#if SPEAKER_MP3
+  static_assert(SPEAKER_CODED_BYTES >= 2048, "SPEAKER_CODED_BYTES must hold a whole MP3 frame");
+  static_assert(SPEAKER_MP3_STREAMS >= 2, "need MP3 decoders for the current and the fading track");
+
+  static AudioDecoder::Mp3Stream g_mp3Pool[SPEAKER_MP3_STREAMS];
+
+  /*
+   * Lends a pooled MP3 decoder to a stream, restarted for the new track
+   */
+  inline bool acquireMp3(TrackStream &s) {
+    if (s.mp3) return true;
+    for (AudioDecoder::Mp3Stream &m : g_mp3Pool) {
+      if (m.inUse) continue;
+      if (!m.restart()) break;
+      m.inUse = true;
+      m.reset((uint8_t)s.info.numChannels);
+      s.mp3 = &m;
+      return true;
+    }
+    Logger::log(Logger::Level::Error, "Speaker: no MP3 decoder available");
+    LOGGER_DEBUG(Serial.println("Speaker: no MP3 decoder available"));
+    return false;
+  }
+
+  inline void releaseMp3(TrackStream &s) {
+    if (s.mp3) {
+      s.mp3->inUse = false;
+      s.mp3 = nullptr;
+    }
+  }
+#endif
+
+  /*
+   * Starts decoding from the first data byte; f must already be positioned there
+   */
+  inline void startStream(TrackStream &s) {
+    s.remaining = s.info.dataSize;
+    s.codedPos  = s.codedLen = 0;
+    s.ima.reset(s.info.blockAlign, (uint8_t)s.info.numChannels);
+#if SPEAKER_MP3
+    if (s.mp3) s.mp3->reset((uint8_t)s.info.numChannels);
+#endif
+  }
+
+  /*
+   * Drops the rest of the track, as if its end had been reached
+   */
+  inline void endStream(TrackStream &s) {
+    startStream(s);
+    s.remaining = 0;
+  }
+
+  // True once every frame of the track has been handed out
+  inline bool streamAtEnd(const TrackStream &s) {
+    bool pending = s.codedPos < s.codedLen || s.ima.pending();
+#if SPEAKER_MP3
+    if (s.mp3) pending = pending || s.mp3->pending();
+#endif
+    return s.remaining == 0 && !pending;
+  }
+
+  inline bool rewindStream(TrackStream &s) {
+    if (!busSeek(s.f, s.info.dataOffset)) return false;
+    startStream(s);
+    return true;
+  }
+
+  inline void closeStream(TrackStream &s) {
+    busClose(s.f);
+#if SPEAKER_MP3
+    releaseMp3(s);
+#endif
+  }
+
+  /*
+   * Returns how many bytes to read next so file reads land on sector boundaries
+   * The first read after the header is shortened so it ends on a 512-byte
+   * boundary; every read after that is a whole buffer. Skipped if the shortened read would
+   * split a sample frame.
+   */
+  inline size_t alignedReadSize(uint32_t filePos, uint32_t remaining, uint8_t bytesPerFrame) {
+    size_t n = SPEAKER_BLOCK_BYTES;
+    uint32_t misalign = filePos % 512;
+    if (misalign) {
+      size_t toBoundary = SPEAKER_BLOCK_BYTES - misalign;
+      if (toBoundary % bytesPerFrame == 0) n = toBoundary;
+    }
+    if (n > remaining) n = remaining;
+    n -= n % bytesPerFrame;
+    return n;
+  }
+
+  /*
+   * Reads up to maxFrames frames of 16-bit PCM, interleaved in the track's channels
+   * Returns the frames written to out, 0 at end of data or on a read error.
+   * PCM is read straight into out; with `aligned`, read sizes come from
+   * alignedReadSize. ADPCM and MP3 input is refilled in runs that end on a
+   * sector boundary, and input that cannot be decoded at end of data is dropped.
+   */
+  inline size_t readFrames(TrackStream &s, uint8_t* out, size_t maxFrames, bool aligned) {
+    const uint8_t ch = (uint8_t)s.info.numChannels;
+
+    if (s.info.codec == AudioDecoder::Codec::Pcm16) {
+      const uint8_t bytesPerFrame = 2 * ch;
+      size_t toRead = aligned ? alignedReadSize(s.f.position(), s.remaining, bytesPerFrame)
+                              : s.remaining - s.remaining % bytesPerFrame;
+      if (toRead > maxFrames * bytesPerFrame) toRead = maxFrames * bytesPerFrame;
+
+      size_t n = toRead ? busRead(s.f, out, toRead) : 0;
+      n -= n % bytesPerFrame;
+      s.remaining -= n;
+      g_bytesRead += n;
+      return n / bytesPerFrame;
+    }
+
+#if !SPEAKER_MP3
+    if (s.info.codec == AudioDecoder::Codec::Mp3) {
+      endStream(s);
+      return 0;
+    }
+#else
+    if (s.info.codec == AudioDecoder::Codec::Mp3 && !acquireMp3(s)) return 0;
+#endif
+
+    int16_t* pcm = (int16_t*)out;
+    size_t   n   = 0;
+    while (n < maxFrames) {
+      uint8_t*     in    = s.coded + s.codedPos;
+      const size_t avail = s.codedLen - s.codedPos;
+      size_t       used  = 0;
+      size_t       got   = 0;
+      {
+        PROFILE_SCOPE(Profiler::Probe::Decode);
+        if (s.info.codec == AudioDecoder::Codec::ImaAdpcm) {
+          got = s.ima.decode(in, avail, used, pcm + n * ch, maxFrames - n);
+        }
+#if SPEAKER_MP3
+        else {
+          got = s.mp3->take(pcm + n * ch, maxFrames - n);
+          if (!got && avail) {
+            switch (s.mp3->decodeFrame(in, avail, used)) {
+              case AudioDecoder::Mp3Stream::Result::Frame:
+                got = s.mp3->take(pcm + n * ch, maxFrames - n);
+                break;
+              case AudioDecoder::Mp3Stream::Result::Skipped:
+                if (!used) used = avail;
+                break;
+              case AudioDecoder::Mp3Stream::Result::NeedInput:
+                break;
+            }
+          }
+        }
+#endif
+      }
+      s.codedPos += (uint16_t)used;
+      n          += got;
+      if (got || used) continue;
+
+      // The decoder needs more input
+      if (s.remaining == 0) {
+        s.codedPos = s.codedLen = 0;
+        break;
+      }
+      if (s.codedPos) {
+        memmove(s.coded, s.coded + s.codedPos, avail);
+        s.codedLen = (uint16_t)avail;
+        s.codedPos = 0;
+      }
+      size_t want = SPEAKER_CODED_BYTES - s.codedLen;
+      if (want == 0) {
+        s.codedLen = 0;  // a full buffer the decoder cannot use: skip it
+        continue;
+      }
+      const uint32_t end = (uint32_t)s.f.position() + want;
+      if (want > 512 && end % 512) want -= end % 512;
+      if (want > s.remaining) want = s.remaining;
+
+      const size_t r = busRead(s.f, s.coded + s.codedLen, want);
+      if (!r) {
+        endStream(s);
+        break;
+      }
+      s.codedLen  += (uint16_t)r;
+      s.remaining -= r;
+      g_bytesRead += r;
+    }
+    return n;
+  }
+
   // ========= Simple blocking one-shot player (good for tests) =========
 
   /*
-   * Plays a complete WAV file from start to finish (blocking)
-   * Reads the file from SD card, converts to mono if needed, and streams to I2S.
+   * Plays a complete track from start to finish (blocking)
+   * Reads the file from SD card, decodes it through the decoder stage, converts
+   * to the I2S layout if needed, and streams to I2S.
    * This function blocks until playback completes - use the background player for normal operation.
    */
   inline bool playWavI2S(const char *path) {
@@ -162,7 +652,13 @@ namespace Speaker {
       return false;
     }
 
-    File f = SD.open(path);
+    static uint8_t coded[SPEAKER_CODED_BYTES];
+    TrackStream t;
+    File    &f    = t.f;
+    WavInfo &info = t.info;
+    t.coded = coded;
+
+    f = busOpen(path);
     if (!f) {
       Logger::logf(Logger::Level::Error,
                    "playWavI2S: failed to open %s",
@@ -174,29 +670,30 @@ namespace Speaker {
       return false;
     }
 
-    WavInfo info;
-    if (!parseWavHeader(f, info)) {
-      Logger::log(Logger::Level::Error, "playWavI2S: invalid WAV header");
-      LOGGER_DEBUG(Serial.println("playWavI2S: invalid WAV header"));
-      f.close();
+    if (!busParseTrackHeader(f, info)) {
+      Logger::log(Logger::Level::Error, "playWavI2S: invalid track header");
+      LOGGER_DEBUG(Serial.println("playWavI2S: invalid track header"));
+      busClose(f);
       return false;
     }
 
-    // Accept mono or stereo, 16-bit only
-    if (info.bitsPerSample != 16 ||
-        (info.numChannels != 1 && info.numChannels != 2)) {
+    // Accept mono or stereo, 16-bit PCM or a supported codec
+    if (!isPlayable(info)) {
       Logger::logf(Logger::Level::Error,
-                   "playWavI2S: unsupported format (ch=%u, bits=%u)",
+                   "playWavI2S: unsupported format (%s, ch=%u, bits=%u)",
+                   AudioDecoder::codecName(info.codec),
                    info.numChannels,
                    info.bitsPerSample);
       LOGGER_DEBUG(
-        Serial.print("playWavI2S: unsupported format (ch=");
+        Serial.print("playWavI2S: unsupported format (");
+        Serial.print(AudioDecoder::codecName(info.codec));
+        Serial.print(", ch=");
         Serial.print(info.numChannels);
         Serial.print(", bits=");
         Serial.print(info.bitsPerSample);
         Serial.println(")");
       );
-      f.close();
+      busClose(f);
       return false;
     }
 
@@ -204,15 +701,15 @@ namespace Speaker {
       Logger::log(Logger::Level::Error,
                   "playWavI2S: failed to set sample rate");
       LOGGER_DEBUG(Serial.println("playWavI2S: failed to set sample rate"));
-      f.close();
+      busClose(f);
       return false;
     }
 
-    if (!f.seek(info.dataOffset)) {
+    if (!busSeek(f, info.dataOffset)) {
       Logger::log(Logger::Level::Error,
                   "playWavI2S: failed to seek to data");
       LOGGER_DEBUG(Serial.println("playWavI2S: failed to seek to data"));
-      f.close();
+      busClose(f);
       return false;
     }
 
@@ -225,48 +722,42 @@ namespace Speaker {
 
     const uint8_t  ch          = info.numChannels;
     const uint8_t  bytesPerSam = 2 * ch;
-    uint32_t       remaining   = info.dataSize;
 
     const size_t   MAX_FRAMES = 256;
     int16_t        inBuf [MAX_FRAMES * 2];
-    int16_t        outBuf[MAX_FRAMES];
-
-    while (remaining > 0) {
-      uint32_t bytesLeft  = remaining;
-      size_t   maxBytes   = MAX_FRAMES * bytesPerSam;
-      size_t   toRead     = (bytesLeft > maxBytes) ? maxBytes : bytesLeft;
-
-      size_t n = f.read((uint8_t*)inBuf, toRead);
-      if (!n) break;
-
-      size_t framesRead = n / bytesPerSam;
-      for (size_t i = 0; i < framesRead; ++i) {
-        int16_t monoSample;
-        if (ch == 1) {
-          monoSample = inBuf[i];
-        } else {
-          int16_t left  = inBuf[2 * i + 0];
-          int16_t right = inBuf[2 * i + 1];
-          int32_t mix   = (int32_t)left + (int32_t)right;
-          monoSample    = (int16_t)(mix / 2);
+    int16_t        outBuf[MAX_FRAMES * 2];
+
+    AudioKernel::Resampler rs;
+    rs.reset(info.sampleRate, g_i2sRate, I2S_CHANNELS, g_resampleQuality);
+
+    startStream(t);
+    while (!streamAtEnd(t)) {
+      size_t framesRead = readFrames(t, (uint8_t*)inBuf, MAX_FRAMES, false);
+      if (!framesRead) break;
+      if (!rs.unity()) {
+        // Fixed I2S rate: convert the layout, then resample a buffer at a time
+        AudioKernel::convert(inBuf, ch, outBuf, I2S_CHANNELS, framesRead, AudioKernel::Q15_ONE);
+        const int16_t* p = outBuf;
+        while (framesRead) {
+          size_t used;
+          size_t m = rs.process(p, framesRead, inBuf, MAX_FRAMES * 2 / I2S_CHANNELS, used);
+          i2sWriteAll((const uint8_t*)inBuf, m * I2S_CHANNELS * 2);
+          p          += used * I2S_CHANNELS;
+          framesRead -= used;
         }
-        outBuf[i] = monoSample;
-      }
-
-      size_t outBytes = framesRead * 2;
-      size_t written  = 0;
-      while (written < outBytes) {
-        written += g_i2s.write(
-          ((uint8_t*)outBuf) + written,
-          outBytes - written
-        );
+      } else if (ch == I2S_CHANNELS) {
+        // Already in the I2S layout at unity gain: no conversion pass
+        i2sWriteAll((const uint8_t*)inBuf, framesRead * bytesPerSam);
+      } else {
+        size_t samples = AudioKernel::convert(inBuf, ch, outBuf, I2S_CHANNELS,
+                                              framesRead, AudioKernel::Q15_ONE);
+        i2sWriteAll((const uint8_t*)outBuf, samples * 2);
       }
 
-      remaining -= n;
       yield();
     }
 
-    f.close();
+    closeStream(t);
     return true;
   }
 
@@ -276,291 +767,1084 @@ namespace Speaker {
 
   // ========= Background player: playlist + controls =========
 
-  // Max number of tracks in playlist
-  static const size_t MAX_TRACKS = 16;
+  static_assert(SPEAKER_PREFETCH_BUFFERS >= 2, "need at least two prefetch buffers");
+  static_assert(SPEAKER_BLOCK_BYTES % 512 == 0, "SPEAKER_BLOCK_BYTES must be sector-aligned");
+
+  /*
+   * One playlist entry as handed to the player by the track source
+   * fileSize != 0 means info came from an index and is trusted as long as the
+   * file still has that size; 0 makes the player parse the header itself.
+   */
+  struct TrackRef {
+    char     path[SPEAKER_PATH_MAX];
+    WavInfo  info;
+    uint32_t fileSize = 0;
+  };
+
+  /*
+   * Outcome of a track lookup or open
+   * Busy means the source could not answer right now (its index is being
+   * swapped out); the player retries the same entry instead of skipping it.
+   */
+  enum class TrackStatus : uint8_t { Ok, Unplayable, Busy };
+
+  /*
+   * Where the playlist comes from (a fixed list or Playlist.hpp's SD index)
+   * count() may grow while playing; lookup() reports entries that are gone as
+   * Unplayable. Both are called from the reader task.
+   */
+  typedef size_t      (*TrackCountFn)();
+  typedef TrackStatus (*TrackLookupFn)(size_t index, TrackRef &out);
 
-  static const char* g_playlist[MAX_TRACKS];
-  static size_t      g_playlistCount = 0;
-  static size_t      g_currentIndex  = 0;
+  static TrackCountFn  g_trackCount  = nullptr;
+  static TrackLookupFn g_trackLookup = nullptr;
+  static size_t        g_currentIndex = 0;
+
+  // Bumped when entries may have changed in place; invalidates the WavInfo cache
+  static volatile uint32_t g_tracksVersion = 0;
+
+  inline size_t trackCount() {
+    return g_trackCount ? g_trackCount() : 0;
+  }
+
+  /*
+   * Player control commands
+   * Next/Prev go to the reader task, everything else to the output task; each
+   * queue is FIFO, so commands of one kind are applied in the order they were
+   * posted. tUs is when the triggering event happened (e.g. the end of a gesture)
+   * and is used to measure command-to-audible latency.
+   */
+  enum class Cmd : uint8_t {
+    Next        = 0,
+    Prev        = 1,
+    PauseToggle = 2,
+    VolumeUp    = 3,
+    VolumeDown  = 4,
+    Stop        = 5
+  };
+  static const uint8_t CMD_COUNT = 6;
+
+  struct Command {
+    Cmd      type;
+    uint32_t tUs;
+  };
+
+  static QueueHandle_t g_navQ = nullptr;  // Next/Prev/Stop, consumed by readerTask
+  static QueueHandle_t g_cmdQ = nullptr;  // the rest and Stop, consumed by audioTask
 
-  // Player commands & state (safe from gesture code)
-  static volatile bool g_cmdNext        = false;
-  static volatile bool g_cmdPrev        = false;
-  static volatile bool g_cmdPauseToggle = false;
-  static volatile int  g_cmdVolDelta    = 0; // +/- steps
   static volatile bool g_stopRequested  = false;
   static volatile bool g_paused         = false;
 
   // Volume (software gain)
   static float g_volume = 1.0f; // 1.0 = unity, 0.0 = mute, up to ~2.0
 
-  // Audio task handle
-  static TaskHandle_t g_audioTaskHandle = nullptr;
+  // Task handles
+  static TaskHandle_t g_audioTaskHandle  = nullptr;
+  static TaskHandle_t g_readerTaskHandle = nullptr;
+
+  static const uint8_t NO_MIX = 0xFF;
 
+  /*
+   * One prefetched chunk of PCM data plus the format of the track it came from
+   * gen identifies the track switch the block belongs to; the output task drops
+   * blocks from an older generation instead of playing them. During a crossfade
+   * mixIdx names a second block holding the same span of the outgoing track,
+   * and xfPos/xfLen place this block within the fade (in frames).
+   */
+  struct AudioBlock {
+    uint8_t  data[SPEAKER_BLOCK_BYTES];
+    uint32_t bytes  = 0;
+    uint32_t gen    = 0;
+    WavInfo  info;
+    uint8_t  mixIdx = NO_MIX;
+    uint32_t xfPos  = 0;
+    uint32_t xfLen  = 0;
+    uint32_t cmdUs  = 0;  // first block after a Next/Prev: when that command was posted
+    Cmd      cmd    = Cmd::Next;
+  };
+
+  // Two extra blocks hold the primed first block of the next/previous track
+  static const uint8_t POOL_BLOCKS = SPEAKER_PREFETCH_BUFFERS + 2;
+
+  static AudioBlock    g_blocks[POOL_BLOCKS];
+  static QueueHandle_t g_freeQ = nullptr;  // indices of empty blocks
+  static QueueHandle_t g_fullQ = nullptr;  // indices of filled blocks, in play order
+
+  // Bumped by the reader every time it switches to another track
+  static volatile uint32_t g_trackGen = 0;
+  // Generation being crossfaded out; its queued blocks still play (0 = none)
+  static volatile uint32_t g_fadeGen  = 0;
+
+  /*
+   * Time from a command being posted to the first I2S write that reflects it
+   * This is when the samples reach the driver; add the I2S DMA depth for the
+   * moment they leave the amplifier.
+   */
+  struct CmdLatency {
+    uint32_t count   = 0;
+    uint32_t lastUs  = 0;
+    uint32_t maxUs   = 0;
+    uint64_t totalUs = 0;
+  };
+
+  /*
+   * Playback pipeline counters
+   * An underrun is counted each time the output task needs a block while
+   * playing and none is ready.
+   */
+  struct Stats {
+    uint32_t underruns      = 0;
+    uint32_t blocksPlayed   = 0;
+    uint32_t blocksZeroCopy = 0;  // sent to I2S straight from the prefetch buffer
+    uint32_t blocksDropped  = 0;  // stale blocks discarded after a track switch
+    uint32_t blocksMixed    = 0;  // played as part of a crossfade
+    uint32_t blocksResampled = 0; // converted to SPEAKER_FIXED_RATE
+    uint32_t crossfades     = 0;
+    uint32_t readErrors     = 0;
+    uint64_t bytesRead      = 0;  // data bytes read from SD, coded size for ADPCM/MP3
+    uint32_t cmdsDropped    = 0;  // posted while a command queue was full
+    uint32_t firstAudioMs   = 0;  // millis() when the first block went to I2S (0 = not yet)
+    // I2S refill jitter: |gap between write completions - audio time the previous write added|
+    uint32_t refills             = 0;
+    uint32_t refillJitterMaxUs   = 0;
+    uint64_t refillJitterTotalUs = 0;
+    CmdLatency latency[CMD_COUNT];
+  };
+  static Stats g_stats;
+
+  /*
+   * An open playlist entry owned by the reader task
+   * Neighbour slots (next/previous track) are opened ahead of time and hold their
+   * first data block in `primed`, so switching to them is a buffer handoff.
+   * MP3 neighbours are only opened: priming would tie up a decoder per slot.
+   */
+  struct TrackSlot : TrackStream {
+    size_t   index     = 0;
+    bool     open      = false;
+    bool     failed    = false;  // open/parse failed; retried only on a real switch
+    int16_t  primed    = -1;     // block index holding the first data block, or -1
+  };
+
+  struct InfoCacheEntry {
+    size_t   index   = 0;
+    uint32_t version = 0;
+    bool     valid   = false;
+    WavInfo  info;
+  };
+  static InfoCacheEntry g_infoCache[SPEAKER_INFO_CACHE];
+  static uint8_t        g_infoCacheNext = 0;
+
+  /*
+   * Plays tracks from a track source; call before startPlayer()
+   */
+  inline void setTrackSource(TrackCountFn count, TrackLookupFn lookup) {
+    g_trackCount    = count;
+    g_trackLookup   = lookup;
+    g_currentIndex  = 0;
+    g_tracksVersion = g_tracksVersion + 1;
+  }
+
+  /*
+   * Tells the player that existing entries may now refer to different files
+   * Call from any task after replacing or rebuilding entries in the source.
+   */
+  inline void tracksChanged() {
+    g_tracksVersion = g_tracksVersion + 1;
+  }
+
+  // Fixed list for setPlaylist(); the caller's array must outlive playback
+  static const char* const* g_fixedList  = nullptr;
+  static size_t             g_fixedCount = 0;
+
+  inline size_t fixedListCount() {
+    return g_fixedCount;
+  }
+
+  inline TrackStatus fixedListLookup(size_t index, TrackRef &out) {
+    if (index >= g_fixedCount || !g_fixedList[index]) return TrackStatus::Unplayable;
+    strncpy(out.path, g_fixedList[index], sizeof(out.path) - 1);
+    out.path[sizeof(out.path) - 1] = '\0';
+    out.fileSize = 0;
+    return TrackStatus::Ok;
+  }
+
+  /*
+   * Plays a fixed list of paths instead of an SD index
+   */
   inline void setPlaylist(const char* const* files, size_t count) {
-    if (count > MAX_TRACKS) count = MAX_TRACKS;
-    for (size_t i = 0; i < count; ++i) {
-      g_playlist[i] = files[i];
+    g_fixedList  = files;
+    g_fixedCount = count;
+    setTrackSource(fixedListCount, fixedListLookup);
+  }
+
+  inline const char* cmdName(Cmd c) {
+    static const char* const names[CMD_COUNT] = {
+      "next", "prev", "pause", "volume_up", "volume_down", "stop"
+    };
+    return (uint8_t)c < CMD_COUNT ? names[(uint8_t)c] : "?";
+  }
+
+  inline QueueHandle_t queueFor(Cmd c) {
+    return (c == Cmd::Next || c == Cmd::Prev) ? g_navQ : g_cmdQ;
+  }
+
+  // Tasks and the ISR both count drops, so the increment is atomic
+  inline void IRAM_ATTR countDroppedCmd() {
+    __atomic_fetch_add(&g_stats.cmdsDropped, 1, __ATOMIC_RELAXED);
+  }
+
+  /*
+   * Posts a command from task context; tUs = 0 stamps it now
+   * Never blocks: a full queue drops the command and counts it.
+   */
+  inline void post(Cmd c, uint32_t tUs = 0) {
+    Command cmd{ c, tUs ? tUs : (uint32_t)micros() };
+    if (!cmd.tUs) cmd.tUs = 1;  // 0 means "no command" in AudioBlock::cmdUs
+
+    if (c == Cmd::Stop) {
+      g_stopRequested = true;
+      if (g_navQ) xQueueSend(g_navQ, &cmd, 0);
     }
-    g_playlistCount = count;
-    g_currentIndex  = 0;
+    QueueHandle_t q = queueFor(c);
+    if (!q || xQueueSend(q, &cmd, 0) != pdTRUE) countDroppedCmd();
+  }
+
+  /*
+   * Posts a command from an interrupt handler
+   */
+  inline void IRAM_ATTR postFromISR(Cmd c) {
+    Command cmd{ c, (uint32_t)micros() | 1u };
+    QueueHandle_t q = queueFor(c);
+    if (!q) return;
+
+    BaseType_t woken = pdFALSE;
+    if (xQueueSendFromISR(q, &cmd, &woken) != pdTRUE) countDroppedCmd();
+    portYIELD_FROM_ISR(woken);
   }
 
-  // Control API – call these from your gesture code
-  
+  // Control API – call these from your gesture code; tUs is when the gesture ended
+
   /* Skips to the next track in the playlist */
-  inline void nextTrack()       { g_cmdNext        = true; }
-  
+  inline void nextTrack(uint32_t tUs = 0)   { post(Cmd::Next, tUs); }
+
   /* Returns to the previous track in the playlist */
-  inline void prevTrack()       { g_cmdPrev        = true; }
-  
+  inline void prevTrack(uint32_t tUs = 0)   { post(Cmd::Prev, tUs); }
+
   /* Toggles between play and pause states */
-  inline void pauseToggle()     { g_cmdPauseToggle = true; }
-  
-  /* Stops playback and terminates the audio task */
-  inline void stopPlayback()    { g_stopRequested  = true; }
-  
+  inline void pauseToggle(uint32_t tUs = 0) { post(Cmd::PauseToggle, tUs); }
+
+  /* Toggles play/pause from an interrupt handler */
+  inline void IRAM_ATTR pauseToggleFromISR() { postFromISR(Cmd::PauseToggle); }
+
+  /* Stops playback and terminates the audio tasks */
+  inline void stopPlayback()                { post(Cmd::Stop); }
+
   /* Increases the volume by one step */
-  inline void volumeUp()        { g_cmdVolDelta++; }
-  
+  inline void volumeUp(uint32_t tUs = 0)    { post(Cmd::VolumeUp, tUs); }
+
   /* Decreases the volume by one step */
-  inline void volumeDown()      { g_cmdVolDelta--; }
+  inline void volumeDown(uint32_t tUs = 0)  { post(Cmd::VolumeDown, tUs); }
 
-  // ==== internal helpers / task ====
+  /* Returns a snapshot of the playback pipeline counters */
+  inline Stats stats() {
+    Stats s = g_stats;
+    s.bytesRead = g_bytesRead;
+    return s;
+  }
 
-  /*
-   * Clamps a 32-bit value to 16-bit signed range
-   * Prevents audio clipping when applying volume scaling.
-   */
-  inline int16_t clamp16(int32_t x) {
-    if (x > 32767) return 32767;
-    if (x < -32768) return -32768;
-    return (int16_t)x;
+  // ==== internal helpers / tasks ====
+
+  inline const WavInfo* findCachedInfo(size_t index) {
+    for (size_t i = 0; i < SPEAKER_INFO_CACHE; ++i) {
+      const InfoCacheEntry &e = g_infoCache[i];
+      if (e.valid && e.index == index && e.version == g_tracksVersion) return &e.info;
+    }
+    return nullptr;
+  }
+
+  inline void cacheInfo(size_t index, const WavInfo &info) {
+    InfoCacheEntry &e = g_infoCache[g_infoCacheNext];
+    g_infoCacheNext = (uint8_t)((g_infoCacheNext + 1) % SPEAKER_INFO_CACHE);
+    e.index   = index;
+    e.version = g_tracksVersion;
+    e.info    = info;
+    e.valid   = true;
   }
 
   /*
-   * FreeRTOS task that manages continuous audio playback
-   * Handles the playlist, processes control commands, applies volume scaling,
-   * and streams audio data to the I2S interface. Runs in background.
+   * Opens a playlist entry and positions it at the start of its audio data
+   * Headers of recently opened tracks come from the WavInfo cache, and indexed
+   * tracks bring their header with them, so those only cost an open and one
+   * seek. Logs and returns Unplayable for missing files or unsupported
+   * formats, Busy if the track source asked for a retry.
    */
-  static void audioTask(void* /*arg*/) {
-    LOGGER_DEBUG(Serial.println("Speaker::audioTask: started"));
+  inline TrackStatus openTrack(size_t index, File &f, WavInfo &info) {
+    static TrackRef ref;  // reader task only
+    const TrackStatus found = g_trackLookup ? g_trackLookup(index, ref) : TrackStatus::Unplayable;
+    if (found != TrackStatus::Ok) {
+      LOGGER_DEBUG(Serial.println(found == TrackStatus::Busy
+                                    ? "Speaker::openTrack: playlist busy, retrying"
+                                    : "Speaker::openTrack: no such playlist entry, skipping"));
+      return found;
+    }
+    const char* path = ref.path;
+    LOGGER_DEBUG(
+      Serial.print("Speaker::openTrack: opening ");
+      Serial.println(path);
+    );
 
-    for (;;) {
-      if (g_stopRequested) break;
+    f = busOpen(path);
+    if (!f) {
+      Logger::logf(Logger::Level::Warn,
+                   "Speaker::audioTask: failed to open %s", path);
+      LOGGER_DEBUG(Serial.println("Speaker::audioTask: failed to open file, skipping"));
+      return TrackStatus::Unplayable;
+    }
 
-      if (g_playlistCount == 0 || !g_i2sInited) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-        continue;
+    const WavInfo* known = findCachedInfo(index);
+    if (!known && ref.fileSize && ref.fileSize == (uint32_t)f.size()) known = &ref.info;
+    if (known) {
+      info = *known;
+      if (busSeek(f, info.dataOffset)) {
+        if (known == &ref.info) cacheInfo(index, info);
+        return TrackStatus::Ok;
       }
+      busClose(f);
+      return TrackStatus::Unplayable;
+    }
+
+    if (!busParseTrackHeader(f, info)) {
+      Logger::log(Logger::Level::Warn,
+                  "Speaker::audioTask: invalid track header");
+      LOGGER_DEBUG(Serial.println("Speaker::audioTask: invalid track header, skipping"));
+      busClose(f);
+      return TrackStatus::Unplayable;
+    }
 
-      const char* path = g_playlist[g_currentIndex];
+    if (!isPlayable(info)) {
+      Logger::logf(Logger::Level::Warn,
+                   "Speaker::audioTask: unsupported format (%s, ch=%u, bits=%u)",
+                   AudioDecoder::codecName(info.codec),
+                   info.numChannels,
+                   info.bitsPerSample);
       LOGGER_DEBUG(
-        Serial.print("Speaker::audioTask: opening ");
-        Serial.println(path);
+        Serial.print("Speaker::audioTask: unsupported format (");
+        Serial.print(AudioDecoder::codecName(info.codec));
+        Serial.print(", ch=");
+        Serial.print(info.numChannels);
+        Serial.print(", bits=");
+        Serial.print(info.bitsPerSample);
+        Serial.println("), skipping");
       );
+      busClose(f);
+      return TrackStatus::Unplayable;
+    }
 
-      File f = SD.open(path);
-      if (!f) {
-        Logger::logf(Logger::Level::Warn,
-                     "Speaker::audioTask: failed to open %s",
-                     path ? path : "<null>");
-        LOGGER_DEBUG(Serial.println("Speaker::audioTask: failed to open file, skipping"));
-        g_currentIndex = (g_currentIndex + 1) % g_playlistCount;
-        vTaskDelay(pdMS_TO_TICKS(50));
-        continue;
-      }
+    if (!busSeek(f, info.dataOffset)) {
+      Logger::log(Logger::Level::Warn,
+                  "Speaker::audioTask: seek to data failed");
+      LOGGER_DEBUG(Serial.println("Speaker::audioTask: seek to data failed, skipping"));
+      busClose(f);
+      return TrackStatus::Unplayable;
+    }
 
-      WavInfo info;
-      if (!parseWavHeader(f, info)) {
-        Logger::log(Logger::Level::Warn,
-                    "Speaker::audioTask: invalid WAV header");
-        LOGGER_DEBUG(Serial.println("Speaker::audioTask: invalid WAV header, skipping"));
-        f.close();
-        g_currentIndex = (g_currentIndex + 1) % g_playlistCount;
-        vTaskDelay(pdMS_TO_TICKS(50));
-        continue;
-      }
+    LOGGER_DEBUG(
+      Serial.print("Speaker::openTrack: rate=");
+      Serial.print(info.sampleRate);
+      Serial.print(" Hz, channels=");
+      Serial.print(info.numChannels);
+      Serial.print(", codec=");
+      Serial.println(AudioDecoder::codecName(info.codec));
+    );
+    cacheInfo(index, info);
+    return TrackStatus::Ok;
+  }
 
-      if (info.bitsPerSample != 16 ||
-          (info.numChannels != 1 && info.numChannels != 2)) {
-        Logger::logf(Logger::Level::Warn,
-                     "Speaker::audioTask: unsupported format (ch=%u, bits=%u)",
-                     info.numChannels,
-                     info.bitsPerSample);
-        LOGGER_DEBUG(
-          Serial.print("Speaker::audioTask: unsupported format (ch=");
-          Serial.print(info.numChannels);
-          Serial.print(", bits=");
-          Serial.print(info.bitsPerSample);
-          Serial.println("), skipping");
-        );
-        f.close();
-        g_currentIndex = (g_currentIndex + 1) % g_playlistCount;
-        vTaskDelay(pdMS_TO_TICKS(50));
-        continue;
-      }
+  /*
+   * Decodes the next chunk of a slot's track into block idx, at most maxFrames frames
+   * Returns the number of PCM bytes in the block (a whole number of frames), 0
+   * at end of data or on a read error.
+   */
+  inline size_t readIntoBlock(TrackSlot &slot, uint8_t idx, size_t maxFrames = SPEAKER_BLOCK_BYTES) {
+    AudioBlock &blk = g_blocks[idx];
+    const uint8_t bytesPerFrame = 2 * slot.info.numChannels;
+    const size_t  capacity      = SPEAKER_BLOCK_BYTES / bytesPerFrame;
+    if (maxFrames > capacity) maxFrames = capacity;
+
+    blk.bytes  = readFrames(slot, blk.data, maxFrames, true) * bytesPerFrame;
+    blk.info   = slot.info;
+    blk.mixIdx = NO_MIX;
+    return blk.bytes;
+  }
 
-      if (!ensureSampleRate(info.sampleRate)) {
-        Logger::log(Logger::Level::Warn,
-                    "Speaker::audioTask: failed to set sample rate");
-        LOGGER_DEBUG(Serial.println("Speaker::audioTask: failed to set sample rate, skipping"));
-        f.close();
-        g_currentIndex = (g_currentIndex + 1) % g_playlistCount;
-        vTaskDelay(pdMS_TO_TICKS(50));
-        continue;
+  inline void closeSlot(TrackSlot &slot) {
+    if (slot.open) closeStream(slot);
+    slot.open = false;
+  }
+
+  inline bool isMp3(const TrackSlot &slot) {
+    return slot.info.codec == AudioDecoder::Codec::Mp3;
+  }
+
+  /*
+   * Readies a neighbour slot: opens (or rewinds) its track and reads the first
+   * data block into idx. Returns false if the block was not used.
+   */
+  inline bool primeSlot(TrackSlot &slot, size_t index, uint8_t idx) {
+    if (slot.open && slot.index != index) closeSlot(slot);
+    if (!slot.open) {
+      slot.index  = index;
+      const TrackStatus st = openTrack(index, slot.f, slot.info);
+      slot.failed = st == TrackStatus::Unplayable;  // Busy: try priming it again later
+      slot.open   = st == TrackStatus::Ok;
+      if (!slot.open) return false;
+      startStream(slot);
+    } else if (!rewindStream(slot)) {
+      closeSlot(slot);
+      return false;
+    }
+
+    if (isMp3(slot)) return false;
+    if (!readIntoBlock(slot, idx)) {
+      g_stats.readErrors++;
+      return false;
+    }
+    slot.primed = idx;
+    return true;
+  }
+
+  /*
+   * Returns the neighbour slot that still needs opening or priming, if any
+   */
+  inline TrackSlot* slotNeedingPrime(TrackSlot* slots, uint8_t nxt, uint8_t prv,
+                                     size_t nextIndex, size_t prevIndex, size_t &wantIndex) {
+    TrackSlot &n = slots[nxt];
+    if (!(n.index == nextIndex && (n.primed >= 0 || n.failed || (n.open && isMp3(n))))) {
+      wantIndex = nextIndex;
+      return &n;
+    }
+    TrackSlot &p = slots[prv];
+    if (!(p.index == prevIndex && (p.primed >= 0 || p.failed || (p.open && isMp3(p))))) {
+      wantIndex = prevIndex;
+      return &p;
+    }
+    return nullptr;
+  }
+
+  /*
+   * FreeRTOS task that owns the playlist position and the open track files
+   * Keeps every free buffer filled with the next chunk of decoded PCM for the current
+   * track. While playback is well buffered it also opens the next and previous
+   * playlist entries and primes each with its first block, so next/prev is just
+   * a handoff of that block plus a slot rotation. With SPEAKER_XFADE_MS set, the
+   * outgoing track keeps streaming from a fourth slot after next/prev and every
+   * new-track block carries the matching span of it for the crossfade. At end of
+   * track it seeks back to the data start (repeat current track) without a gap.
+   */
+  static void readerTask(void* /*arg*/) {
+    LOGGER_DEBUG(Serial.println("Speaker::readerTask: started"));
+
+    // Slot roles rotate on next/prev; the TrackSlot objects themselves never move
+    TrackSlot slots[4];
+    uint8_t   cur = 0, nxt = 1, prv = 2, fad = 3;
+    static uint8_t codedBuf[4][SPEAKER_CODED_BYTES];
+    for (uint8_t i = 0; i < 4; ++i) slots[i].coded = codedBuf[i];
+
+    // Crossfade progress of the outgoing track in slots[fad], in new-track frames
+    bool     fading  = false;
+    uint32_t xfDone  = 0;
+    uint32_t xfLen   = 0;   // set from the new track's rate by its first block
+    uint32_t xfCarry = 0;   // rate-conversion remainder of the outgoing track's frames
+
+    auto releasePrimed = [&](TrackSlot &slot) {
+      if (slot.primed >= 0) {
+        uint8_t idx = (uint8_t)slot.primed;
+        xQueueSend(g_freeQ, &idx, 0);
+        slot.primed = -1;
+      }
+    };
+
+    // Reads the span of the outgoing track that plays under block idx
+    auto attachFade = [&](uint8_t idx) {
+      AudioBlock &blk = g_blocks[idx];
+      blk.mixIdx = NO_MIX;
+      if (!fading) return;
+
+      TrackSlot &o = slots[fad];
+      if (o.info.sampleRate != blk.info.sampleRate && !SPEAKER_FIXED_RATE) {
+        fading = false;  // I2S follows the track rate: mismatched rates cut over instead
+        return;
+      }
+      if (!xfLen) xfLen = (uint32_t)((uint64_t)SPEAKER_XFADE_MS * blk.info.sampleRate / 1000);
+
+      // Bounded wait: with the output task stalled or stopping, an unbounded one
+      // would hang the reader at Stop. No free block in time: cut over unmixed
+      uint8_t m;
+      bool    got = false;
+      for (int i = 0; i < 10 && !got && !g_stopRequested; i++)
+        got = xQueueReceive(g_freeQ, &m, pdMS_TO_TICKS(10)) == pdTRUE;
+      if (!got) {
+        fading = false;
+        return;
+      }
+      AudioBlock &mb = g_blocks[m];
+
+      const uint8_t  bytesPerFrame = 2 * o.info.numChannels;
+      const uint32_t frames        = blk.bytes / (2 * blk.info.numChannels);
+      // The same stretch of time in the outgoing track's own frames
+      const uint64_t scaled = (uint64_t)frames * o.info.sampleRate + xfCarry;
+      const uint32_t oFrames = (uint32_t)(scaled / blk.info.sampleRate);
+      xfCarry = (uint32_t)(scaled % blk.info.sampleRate);
+      size_t want = oFrames;
+      if (want > SPEAKER_BLOCK_BYTES / bytesPerFrame) want = SPEAKER_BLOCK_BYTES / bytesPerFrame;
+
+      size_t n = want ? readFrames(o, mb.data, want, false) * bytesPerFrame : 0;
+      if (n == 0) {
+        xQueueSend(g_freeQ, &m, 0);
+        fading = false;
+        return;
       }
 
-      if (!f.seek(info.dataOffset)) {
-        Logger::log(Logger::Level::Warn,
-                    "Speaker::audioTask: seek to data failed");
-        LOGGER_DEBUG(Serial.println("Speaker::audioTask: seek to data failed, skipping"));
-        f.close();
-        g_currentIndex = (g_currentIndex + 1) % g_playlistCount;
-        vTaskDelay(pdMS_TO_TICKS(50));
+      mb.bytes   = n;
+      mb.info    = o.info;
+      mb.gen     = blk.gen;
+      blk.mixIdx = m;
+      blk.xfPos  = xfDone;
+      blk.xfLen  = xfLen;
+
+      xfDone += frames;
+      if (xfDone >= xfLen || streamAtEnd(o)) fading = false;
+    };
+
+    // Navigation command whose first block has not been queued yet
+    uint32_t navUs  = 0;
+    Cmd      navCmd = Cmd::Next;
+
+    // Stamps a current-track block and hands it to the output task
+    auto queueBlock = [&](uint8_t idx) {
+      AudioBlock &blk = g_blocks[idx];
+      blk.gen   = g_trackGen;
+      blk.cmdUs = navUs;
+      blk.cmd   = navCmd;
+      navUs     = 0;
+      attachFade(idx);
+      xQueueSend(g_fullQ, &idx, portMAX_DELAY);
+    };
+
+    // Frames per current-track block, so its outgoing-track companion fits a block
+    auto maxFrames = [&]() -> size_t {
+      if (!fading) return SPEAKER_BLOCK_BYTES;
+      const WavInfo &o = slots[fad].info;
+      const WavInfo &c = slots[cur].info;
+      const size_t   n = SPEAKER_BLOCK_BYTES / (2 * o.numChannels);
+      if (!SPEAKER_FIXED_RATE || o.sampleRate == c.sampleRate || !c.sampleRate) return n;
+      // One frame of slack for the conversion remainder
+      return (size_t)((uint64_t)n * c.sampleRate / o.sampleRate) - 1;
+    };
+
+    for (;;) {
+      if (g_stopRequested) break;
+
+      const size_t count = trackCount();
+      if (count == 0 || !g_i2sInited) {
+        SdBus::setAudioHungry(false);
+        vTaskDelay(pdMS_TO_TICKS(100));
         continue;
       }
 
-      LOGGER_DEBUG(
-        Serial.print("Speaker::audioTask: playing, rate=");
-        Serial.print(info.sampleRate);
-        Serial.print(" Hz, channels=");
-        Serial.println(info.numChannels);
-      );
-
-      const uint8_t ch          = info.numChannels;
-      const uint8_t bytesPerSam = 2 * ch;
-      uint32_t      remaining   = info.dataSize;
-
-      const size_t  MAX_FRAMES = 256;
-      int16_t       inBuf [MAX_FRAMES * 2];
-      int16_t       outBuf[MAX_FRAMES];
-
-      bool trackDone   = false;
-      bool advanceNext = false;
-      bool advancePrev = false;
-
-      while (!trackDone && !g_stopRequested) {
-        // Handle pause
-        if (g_paused) {
-          vTaskDelay(pdMS_TO_TICKS(10));
-          // Volume changes still apply
-          if (g_cmdVolDelta != 0) {
-            int delta = g_cmdVolDelta;
-            g_cmdVolDelta = 0;
-            g_volume += 0.1f * delta;
-            if (g_volume < 0.0f) g_volume = 0.0f;
-            if (g_volume > 2.0f) g_volume = 2.0f;
-            LOGGER_DEBUG(
-              Serial.print("Speaker::volume=");
-              Serial.println(g_volume);
-            );
-          }
-          if (g_cmdPauseToggle) {
-            g_cmdPauseToggle = false;
-            g_paused = false;
-            LOGGER_DEBUG(Serial.println("Speaker::unpause"));
-          }
-          if (g_cmdNext) {
-            g_cmdNext = false;
-            advanceNext = true;
-            break;
+      // Below half full: other SD clients hold off until the stream catches up
+      SdBus::setAudioHungry(uxQueueMessagesWaiting(g_fullQ) < SPEAKER_PREFETCH_BUFFERS / 2);
+
+      // Track navigation: rotate slot roles; a new generation invalidates queued blocks
+      Command nav;
+      if (xQueueReceive(g_navQ, &nav, 0) == pdTRUE) {
+        if (nav.type == Cmd::Stop) break;
+        bool next = nav.type == Cmd::Next;
+        navUs  = nav.tUs;
+        navCmd = nav.type;
+
+        uint8_t oldCur = cur;
+        bool    fade   = SPEAKER_XFADE_MS > 0 && count > 1 &&
+                         slots[oldCur].open && !streamAtEnd(slots[oldCur]);
+
+        if (count == 1) {
+          endStream(slots[cur]);  // restart the only track
+        } else if (fade) {
+          // The old current track keeps streaming as the fade-out source
+          if (next) {
+            cur = nxt; nxt = prv; prv = fad;
+          } else {
+            cur = prv; prv = nxt; nxt = fad;
           }
-          if (g_cmdPrev) {
-            g_cmdPrev = false;
-            advancePrev = true;
-            break;
+          fad = oldCur;
+        } else {
+          if (next) {
+            cur = nxt; nxt = prv; prv = oldCur;
+          } else {
+            cur = prv; prv = nxt; nxt = oldCur;
           }
-          continue;
+          // The old current track is now a neighbour and must be rewound and re-primed
+          slots[oldCur].primed = -1;
         }
-
-        if (remaining == 0) {
-          trackDone = true;
-          break;
+#if SPEAKER_MP3
+        // Only the current and the fading track keep an MP3 decoder
+        releaseMp3(slots[nxt]);
+        releaseMp3(slots[prv]);
+#endif
+        if (count > 1) {
+          g_currentIndex = next ? (g_currentIndex + 1) % count
+                                : (g_currentIndex + count - 1) % count;
         }
 
-        // Handle control commands
-        if (g_cmdPauseToggle) {
-          g_cmdPauseToggle = false;
-          g_paused = !g_paused;
-          LOGGER_DEBUG(Serial.println(g_paused ? "Speaker::pause" : "Speaker::unpause"));
-          continue;
+        if (fade) {
+          fading    = true;
+          xfDone    = 0;
+          xfLen     = 0;
+          xfCarry   = 0;
+          g_fadeGen = g_trackGen;  // blocks already queued for it still play
+          g_stats.crossfades++;
+        } else {
+          fading    = false;
+          g_fadeGen = 0;
         }
-        if (g_cmdNext) {
-          g_cmdNext = false;
-          advanceNext = true;
-          break;
+
+        TrackSlot &c = slots[cur];
+        g_trackGen = g_trackGen + 1;
+        if (c.open && c.index == g_currentIndex && c.primed >= 0 &&
+            g_blocks[c.primed].bytes / (2 * c.info.numChannels) <= maxFrames()) {
+          uint8_t idx = (uint8_t)c.primed;
+          c.primed = -1;
+          queueBlock(idx);
+        } else if (c.open && c.index == g_currentIndex && c.primed >= 0) {
+          // Primed block too long to pair with the outgoing track; re-read it shorter
+          releasePrimed(c);
+          endStream(c);
+        } else if (count > 1) {
+          releasePrimed(c);
+          // An MP3 neighbour is opened but not primed: start it from the top
+          if (!(c.open && c.index == g_currentIndex && isMp3(c) && rewindStream(c))) closeSlot(c);
         }
-        if (g_cmdPrev) {
-          g_cmdPrev = false;
-          advancePrev = true;
-          break;
+      }
+
+      TrackSlot &c = slots[cur];
+
+      if (!c.open || c.index != g_currentIndex) {
+        releasePrimed(c);
+        closeSlot(c);
+        c.index  = g_currentIndex;
+        const TrackStatus st = openTrack(g_currentIndex, c.f, c.info);
+        if (st != TrackStatus::Ok) {
+          // A busy index is only briefly so: retry the same track rather than skip it
+          if (st == TrackStatus::Unplayable) g_currentIndex = (g_currentIndex + 1) % count;
+          vTaskDelay(pdMS_TO_TICKS(st == TrackStatus::Busy ? 10 : 50));
+          continue;
         }
-        if (g_cmdVolDelta != 0) {
-          int delta = g_cmdVolDelta;
-          g_cmdVolDelta = 0;
-          g_volume += 0.1f * delta;
-          if (g_volume < 0.0f) g_volume = 0.0f;
-          if (g_volume > 2.0f) g_volume = 2.0f;
-          LOGGER_DEBUG(
-            Serial.print("Speaker::volume=");
-            Serial.println(g_volume);
-          );
+        c.open      = true;
+        c.failed    = false;
+        startStream(c);
+        g_trackGen  = g_trackGen + 1;
+      }
+
+      if (streamAtEnd(c)) {
+        // Normal end-of-track → replay SAME track
+        if (!rewindStream(c)) {
+          closeSlot(c);
+          continue;
         }
+      }
 
-        uint32_t bytesLeft = remaining;
-        size_t   maxBytes  = MAX_FRAMES * bytesPerSam;
-        size_t   toRead    = (bytesLeft > maxBytes) ? maxBytes : bytesLeft;
+      uint8_t idx;
+      if (xQueueReceive(g_freeQ, &idx, pdMS_TO_TICKS(10)) != pdTRUE) {
+        continue;  // all buffers full; re-check commands
+      }
 
-        size_t n = f.read((uint8_t*)inBuf, toRead);
-        if (!n) {
-          trackDone = true;
-          break;
+      // Playback is comfortably buffered: spend this block priming a neighbour
+      if (count > 1 && !fading && uxQueueMessagesWaiting(g_fullQ) >= SPEAKER_PREFETCH_BUFFERS / 2) {
+        size_t     wantIndex = 0;
+        TrackSlot* n = slotNeedingPrime(slots, nxt, prv,
+                                        (g_currentIndex + 1) % count,
+                                        (g_currentIndex + count - 1) % count,
+                                        wantIndex);
+        if (n) {
+          releasePrimed(*n);
+          if (!primeSlot(*n, wantIndex, idx)) xQueueSend(g_freeQ, &idx, 0);
+          continue;
         }
+      }
+
+      if (!readIntoBlock(c, idx, maxFrames())) {
+        g_stats.readErrors++;
+        xQueueSend(g_freeQ, &idx, 0);
+        endStream(c);  // treat as end of track
+        continue;
+      }
 
-        size_t framesRead = n / bytesPerSam;
-        for (size_t i = 0; i < framesRead; ++i) {
-          int16_t monoSample;
-          if (ch == 1) {
-            monoSample = inBuf[i];
+      queueBlock(idx);
+    }
+
+    for (uint8_t i = 0; i < 4; ++i) {
+      releasePrimed(slots[i]);
+      closeSlot(slots[i]);
+    }
+    SdBus::setAudioHungry(false);
+    LOGGER_DEBUG(Serial.println("Speaker::readerTask: exiting"));
+    g_readerTaskHandle = nullptr;
+    vTaskDelete(nullptr);
+  }
+
+  /*
+   * Moves g_volume by `delta` steps of 0.1, clamped to 0.0 .. 2.0
+   * The result is snapped to a whole number of steps, so stepping lands on
+   * exactly 1.0 (the zero-copy path) even from the off-grid start volume.
+   */
+  inline void stepVolume(int delta) {
+    long steps = lroundf((g_volume + 0.1f * delta) * 10.0f);
+    if (steps < 0)  steps = 0;
+    if (steps > 20) steps = 20;
+    g_volume = (float)steps / 10.0f;
+    LOGGER_DEBUG(
+      Serial.print("Speaker::volume=");
+      Serial.println(g_volume);
+    );
+  }
+
+  /*
+   * Records the latency of a command that has just become audible
+   * Counters only: this runs on the output task's refill path, so the log line
+   * is written by whoever polls stats() (main.ino's loop).
+   */
+  inline void recordLatency(Cmd c, uint32_t tUs) {
+    const uint32_t dt = (uint32_t)micros() - tUs;
+    CmdLatency &l = g_stats.latency[(uint8_t)c];
+    l.lastUs   = dt;  // before count, so a reader that sees the new count sees this too
+    l.totalUs += dt;
+    if (dt > l.maxUs) l.maxUs = dt;
+    l.count++;
+  }
+
+  /*
+   * FreeRTOS task that feeds the I2S output from prefetched blocks
+   * Handles pause and volume, converts each block to the I2S channel layout with
+   * volume scaling and writes it to I2S; native-format blocks at settled unity gain
+   * skip the conversion and are written from the prefetch buffer itself. Every
+   * gain change (volume step, pause/resume, start of a track after a cut) is a
+   * SPEAKER_RAMP_MS per-sample ramp, and crossfade blocks are mixed with their
+   * outgoing-track companion. All buffers are static, so the per-block cost is
+   * bounded and nothing is allocated. Never touches the SD card, so an SD stall
+   * only shows up as an underrun once every prefetched block has been played.
+   * With SPEAKER_FIXED_RATE, tracks at another rate take the resampling path.
+   */
+  static void audioTask(void* /*arg*/) {
+    LOGGER_DEBUG(Serial.println("Speaker::audioTask: started"));
+
+    // Worst case is a mono block expanded to stereo
+    static int16_t outBuf[SPEAKER_BLOCK_BYTES / 2 * I2S_CHANNELS];
+    // Outgoing track during a crossfade, in the same layout as outBuf
+    static int16_t mixBuf[SPEAKER_BLOCK_BYTES / 2 * I2S_CHANNELS];
+    uint32_t playingGen = 0;
+    bool     starved    = false;
+
+#if SPEAKER_FIXED_RATE
+    // Resampled output of the current and the outgoing track
+    static int16_t rsBuf[SPEAKER_RESAMPLE_FRAMES * I2S_CHANNELS];
+    static int16_t rsMix[SPEAKER_RESAMPLE_FRAMES * I2S_CHANNELS];
+    AudioKernel::Resampler mainRs;
+    AudioKernel::Resampler fadeRs;
+#endif
+
+    AudioKernel::GainRamp ramp;
+    bool pausing = false;  // fading out; g_paused is set once the ramp reaches 0
+
+    // Post time of commands applied but not yet written to I2S (0 = none)
+    uint32_t pendingUs[CMD_COUNT] = {};
+    auto notePending = [&]() {
+      for (uint8_t c = 0; c < CMD_COUNT; ++c) {
+        if (pendingUs[c]) {
+          recordLatency((Cmd)c, pendingUs[c]);
+          pendingUs[c] = 0;
+        }
+      }
+    };
+
+    // Refill timing; only measured across back-to-back writes of one track
+    uint32_t lastRefillUs  = 0;
+    uint32_t lastRefillDur = 0;
+    auto noteRefill = [&](size_t frames) {
+      const uint32_t now = micros();
+      if (lastRefillUs) {
+        const int32_t  dev = (int32_t)(now - lastRefillUs) - (int32_t)lastRefillDur;
+        const uint32_t jit = dev < 0 ? (uint32_t)-dev : (uint32_t)dev;
+        g_stats.refills++;
+        g_stats.refillJitterTotalUs += jit;
+        if (jit > g_stats.refillJitterMaxUs) g_stats.refillJitterMaxUs = jit;
+      }
+      lastRefillUs  = now;
+      lastRefillDur = g_i2sRate ? (uint32_t)((uint64_t)frames * 1000000 / g_i2sRate) : 0;
+    };
+
+    auto freeBlock = [](uint8_t idx) {
+      AudioBlock &blk = g_blocks[idx];
+      if (blk.mixIdx != NO_MIX) {
+        uint8_t m = blk.mixIdx;
+        blk.mixIdx = NO_MIX;
+        xQueueSend(g_freeQ, &m, 0);
+      }
+      xQueueSend(g_freeQ, &idx, 0);
+    };
+
+#if SPEAKER_FIXED_RATE
+    /*
+     * Plays one block at the fixed I2S rate, SPEAKER_RESAMPLE_FRAMES output frames
+     * per pass. Both streams are staged at unity gain so the blocks go straight
+     * back to the reader; a crossfade resamples each stream on its own and mixes
+     * them at the output rate, then the gain ramp runs in output frames.
+     */
+    auto playResampled = [&](uint8_t idx) {
+      AudioBlock    &blk = g_blocks[idx];
+      const bool     mix = blk.mixIdx != NO_MIX;
+      size_t         left    = blk.bytes / (2 * blk.info.numChannels);
+      size_t         mixLeft = 0;
+      uint32_t       xfPos   = 0, xfLen = 0;
+      uint32_t       cpuUs   = 0;
+      uint32_t       t0      = micros();
+
+      AudioKernel::convert((const int16_t*)blk.data, blk.info.numChannels, outBuf, I2S_CHANNELS,
+                           left, AudioKernel::Q15_ONE);
+      if (mix) {
+        const AudioBlock &mb = g_blocks[blk.mixIdx];
+        mixLeft = mb.bytes / (2 * mb.info.numChannels);
+        AudioKernel::convert((const int16_t*)mb.data, mb.info.numChannels, mixBuf, I2S_CHANNELS,
+                             mixLeft, AudioKernel::Q15_ONE);
+        xfPos = (uint32_t)((uint64_t)blk.xfPos * g_i2sRate / blk.info.sampleRate);
+        xfLen = (uint32_t)((uint64_t)blk.xfLen * g_i2sRate / blk.info.sampleRate);
+      }
+      freeBlock(idx);
+
+      int16_t* in    = outBuf;
+      int16_t* mixIn = mixBuf;
+      bool     first = true;
+      while (left) {
+        size_t   used;
+        size_t   m;
+        int16_t* o = rsBuf;
+        if (mainRs.unity()) {
+          m    = left < SPEAKER_RESAMPLE_FRAMES ? left : SPEAKER_RESAMPLE_FRAMES;
+          o    = in;
+          used = m;
+          mainRs.track(in, m);
+        } else {
+          m = mainRs.process(in, left, rsBuf, SPEAKER_RESAMPLE_FRAMES, used);
+        }
+        in   += used * I2S_CHANNELS;
+        left -= used;
+        if (!m) continue;
+
+        AudioKernel::GainRamp mixRamp = ramp;
+        AudioKernel::convertRamp(o, I2S_CHANNELS, o, I2S_CHANNELS, m, ramp);
+
+        if (mix) {
+          size_t   k;
+          int16_t* mo = rsMix;
+          if (fadeRs.unity()) {
+            k    = mixLeft < m ? mixLeft : m;
+            memcpy(rsMix, mixIn, k * I2S_CHANNELS * sizeof(int16_t));
+            used = k;
           } else {
-            int16_t left  = inBuf[2 * i + 0];
-            int16_t right = inBuf[2 * i + 1];
-            int32_t mix   = (int32_t)left + (int32_t)right;
-            monoSample    = (int16_t)(mix / 2);
+            k = fadeRs.process(mixIn, mixLeft, rsMix, m, used);
+          }
+          mixIn   += used * I2S_CHANNELS;
+          mixLeft -= used;
+          // Rounding can leave the outgoing stream a frame short: hold it, then silence
+          for (size_t j = k; j < m; ++j) {
+            for (uint8_t c = 0; c < I2S_CHANNELS; ++c) {
+              mo[j * I2S_CHANNELS + c] = (j == k && k) ? mo[(k - 1) * I2S_CHANNELS + c] : 0;
+            }
           }
-          int32_t scaled = (int32_t)(monoSample * g_volume);
-          outBuf[i] = clamp16(scaled);
+          AudioKernel::convertRamp(mo, I2S_CHANNELS, mo, I2S_CHANNELS, m, mixRamp);
+          AudioKernel::crossfade(o, mo, m, I2S_CHANNELS, xfPos, xfLen);
+          xfPos += m;
         }
 
-        size_t outBytes = framesRead * 2;
-        size_t written  = 0;
-        while (written < outBytes) {
-          written += g_i2s.write(
-            ((uint8_t*)outBuf) + written,
-            outBytes - written
-          );
+        cpuUs += micros() - t0;
+        if (first) notePending();
+        first = false;
+        i2sWriteAll((const uint8_t*)o, m * I2S_CHANNELS * 2);
+        noteRefill(m);
+        t0 = micros();
+      }
+
+      PROFILE_RECORD_US(Profiler::Probe::Resample, cpuUs);
+      (void)cpuUs;
+      g_stats.blocksResampled++;
+      if (mix) g_stats.blocksMixed++;
+    };
+#endif
+
+    for (;;) {
+      if (g_stopRequested) break;
+
+      const uint32_t rampFrames = (uint32_t)((uint64_t)SPEAKER_RAMP_MS * g_i2sRate / 1000);
+
+      // Drain commands; while paused, sleep here until one arrives
+      Command    cmd;
+      TickType_t wait = g_paused ? portMAX_DELAY : 0;
+      while (xQueueReceive(g_cmdQ, &cmd, wait) == pdTRUE) {
+        wait = 0;
+        switch (cmd.type) {
+          case Cmd::VolumeUp:
+          case Cmd::VolumeDown:
+            stepVolume(cmd.type == Cmd::VolumeUp ? 1 : -1);
+            if (!pausing && !g_paused) {
+              ramp.rampTo(AudioKernel::gainToQ15(g_volume), rampFrames);
+            }
+            break;
+
+          case Cmd::PauseToggle:
+            if (g_paused) {
+              g_paused = false;
+              ramp.set(0);
+              ramp.rampTo(AudioKernel::gainToQ15(g_volume), rampFrames);
+            } else if (pausing) {
+              pausing = false;
+              ramp.rampTo(AudioKernel::gainToQ15(g_volume), rampFrames);
+            } else {
+              pausing = true;
+              ramp.rampTo(0, rampFrames);
+            }
+            LOGGER_DEBUG(Serial.println(pausing ? "Speaker::pause" : "Speaker::unpause"));
+            break;
+
+          default:
+            break;
         }
+        pendingUs[(uint8_t)cmd.type] = cmd.tUs;
+      }
+
+      if (g_stopRequested) break;
 
-        remaining -= n;
-        taskYIELD();
+      if (pausing && !ramp.active()) {
+        pausing  = false;
+        g_paused = true;
       }
 
-      f.close();
+      if (g_paused) {
+        lastRefillUs = 0;
+        continue;
+      }
 
-      if (g_stopRequested) break;
+      const int32_t volumeQ15 = AudioKernel::gainToQ15(g_volume);
 
-      if (advanceNext) {
-        g_currentIndex = (g_currentIndex + 1) % g_playlistCount;
-      } else if (advancePrev) {
-        g_currentIndex = (g_currentIndex + g_playlistCount - 1) % g_playlistCount;
-      } else {
-        // Normal end-of-track → replay SAME track
-        // g_currentIndex unchanged
+      uint8_t idx;
+      if (xQueueReceive(g_fullQ, &idx, 0) != pdTRUE) {
+        // Nothing prefetched: count one underrun per dry spell, then wait
+        if (!starved && playingGen != 0) g_stats.underruns++;
+        starved      = true;
+        lastRefillUs = 0;
+        if (xQueueReceive(g_fullQ, &idx, pdMS_TO_TICKS(10)) != pdTRUE) continue;
       }
+      starved = false;
 
-      vTaskDelay(pdMS_TO_TICKS(10));
+      AudioBlock &blk = g_blocks[idx];
 
+      if (blk.gen != g_trackGen && blk.gen != g_fadeGen) {
+        g_stats.blocksDropped++;
+        freeBlock(idx);
+        playingGen = 0;  // the gap while the new track prefetches is not an underrun
+        continue;
+      }
+
+      if (blk.gen != playingGen) {
+        if (!ensureSampleRate(blk.info.sampleRate)) {
+          Logger::log(Logger::Level::Warn,
+                      "Speaker::audioTask: failed to set sample rate");
+          LOGGER_DEBUG(Serial.println("Speaker::audioTask: failed to set sample rate, skipping"));
+          post(Cmd::Next);
+          freeBlock(idx);
+          continue;
+        }
+        // A cut (or the very first block) starts from silence; a crossfade is already smooth
+        if (blk.mixIdx == NO_MIX && !pausing) {
+          ramp.set(0);
+          ramp.rampTo(volumeQ15, (uint32_t)((uint64_t)SPEAKER_RAMP_MS * g_i2sRate / 1000));
+        }
+#if SPEAKER_FIXED_RATE
+        // The outgoing track of a crossfade keeps its resampler state
+        if (blk.mixIdx != NO_MIX) fadeRs = mainRs;
+        mainRs.reset(blk.info.sampleRate, g_i2sRate, I2S_CHANNELS, g_resampleQuality);
+#endif
+        playingGen   = blk.gen;
+        lastRefillUs = 0;
+        if (!g_stats.firstAudioMs) {
+          g_stats.firstAudioMs = (uint32_t)millis() | 1u;
+          Logger::logf(Logger::Level::Info, "Speaker: first audio at %lu ms",
+                       (unsigned long)g_stats.firstAudioMs);
+        }
+      }
+      if (blk.cmdUs) pendingUs[(uint8_t)blk.cmd] = blk.cmdUs;
+
+#if SPEAKER_FIXED_RATE
+      if (!mainRs.unity() || (blk.mixIdx != NO_MIX && !fadeRs.unity())) {
+        playResampled(idx);
+        g_stats.blocksPlayed++;
+        continue;
+      }
+#endif
+
+      const uint8_t  ch         = blk.info.numChannels;
+      const int16_t* inBuf      = (const int16_t*)blk.data;
+      size_t         framesRead = blk.bytes / (2 * ch);
+
+      if (blk.mixIdx != NO_MIX) {
+        const AudioBlock &mb     = g_blocks[blk.mixIdx];
+        const uint8_t     mixCh  = mb.info.numChannels;
+        size_t            mixFrames = mb.bytes / (2 * mixCh);
+        if (mixFrames > framesRead) mixFrames = framesRead;
+
+        // Both streams follow the same gain curve
+        AudioKernel::GainRamp mixRamp = ramp;
+        size_t samples = AudioKernel::convertRamp(inBuf, ch, outBuf, I2S_CHANNELS,
+                                                  framesRead, ramp);
+        AudioKernel::convertRamp((const int16_t*)mb.data, mixCh, mixBuf, I2S_CHANNELS,
+                                 mixFrames, mixRamp);
+#if SPEAKER_FIXED_RATE
+        mainRs.track(outBuf, framesRead);
+#endif
+        if (mixFrames < framesRead) {
+          memset(mixBuf + mixFrames * I2S_CHANNELS, 0,
+                 (framesRead - mixFrames) * I2S_CHANNELS * sizeof(int16_t));
+        }
+        AudioKernel::crossfade(outBuf, mixBuf, framesRead, I2S_CHANNELS, blk.xfPos, blk.xfLen);
+
+        freeBlock(idx);
+        notePending();
+        i2sWriteAll((const uint8_t*)outBuf, samples * 2);
+        noteRefill(framesRead);
+        g_stats.blocksMixed++;
+      } else if (ch == I2S_CHANNELS && !ramp.active() && ramp.q15() == AudioKernel::Q15_ONE) {
+        // Native format at unity gain: DMA straight from the prefetch buffer
+#if SPEAKER_FIXED_RATE
+        mainRs.track(inBuf, framesRead);
+#endif
+        notePending();
+        i2sWriteAll(blk.data, blk.bytes);
+        noteRefill(framesRead);
+        freeBlock(idx);
+        g_stats.blocksZeroCopy++;
+      } else {
+        size_t samples = AudioKernel::convertRamp(inBuf, ch, outBuf, I2S_CHANNELS,
+                                                  framesRead, ramp);
+#if SPEAKER_FIXED_RATE
+        mainRs.track(outBuf, framesRead);
+#endif
+
+        // Block is converted; hand it back to the reader before the slow I2S write
+        freeBlock(idx);
+        notePending();
+        i2sWriteAll((const uint8_t*)outBuf, samples * 2);
+        noteRefill(framesRead);
+      }
+
+      g_stats.blocksPlayed++;
     }
 
     LOGGER_DEBUG(Serial.println("Speaker::audioTask: exiting"));
@@ -569,39 +1853,67 @@ namespace Speaker {
   }
 
   /*
-   * Starts the background audio playback task
-   * Creates a FreeRTOS task that continuously plays through the playlist.
-   * Must be called after setting the playlist and initializing I2S.
+   * Starts the background audio playback tasks
+   * Creates the prefetch queues and spawns the SD reader and I2S output tasks,
+   * which continuously play through the playlist.
+   * Must be called after setting the track source and initializing I2S. An
+   * empty playlist is fine: playback starts once the source has a track.
    */
   inline void startPlayer() {
-    if (!g_i2sInited || g_playlistCount == 0) {
+    if (!g_i2sInited || !g_trackLookup) {
       Logger::log(Logger::Level::Error,
-                  "Speaker::startPlayer: I2S not inited or playlist empty");
-      LOGGER_DEBUG(Serial.println("Speaker::startPlayer: I2S not inited or playlist empty"));
+                  "Speaker::startPlayer: I2S not inited or no track source");
+      LOGGER_DEBUG(Serial.println("Speaker::startPlayer: I2S not inited or no track source"));
       return;
     }
-    if (g_audioTaskHandle) {
+    if (g_audioTaskHandle || g_readerTaskHandle) {
       Logger::log(Logger::Level::Warn,
                   "Speaker::startPlayer: already running");
       LOGGER_DEBUG(Serial.println("Speaker::startPlayer: already running"));
       return;
     }
 
+    if (!g_freeQ) g_freeQ = xQueueCreate(POOL_BLOCKS, sizeof(uint8_t));
+    if (!g_fullQ) g_fullQ = xQueueCreate(POOL_BLOCKS, sizeof(uint8_t));
+    if (!g_navQ)  g_navQ  = xQueueCreate(SPEAKER_CMD_QUEUE, sizeof(Command));
+    if (!g_cmdQ)  g_cmdQ  = xQueueCreate(SPEAKER_CMD_QUEUE, sizeof(Command));
+    if (!g_freeQ || !g_fullQ || !g_navQ || !g_cmdQ) {
+      Logger::log(Logger::Level::Error,
+                  "Speaker::startPlayer: failed to create queues");
+      LOGGER_DEBUG(Serial.println("Speaker::startPlayer: failed to create queues"));
+      return;
+    }
+    xQueueReset(g_freeQ);
+    xQueueReset(g_fullQ);
+    xQueueReset(g_navQ);
+    xQueueReset(g_cmdQ);
+    for (uint8_t i = 0; i < POOL_BLOCKS; ++i) {
+      xQueueSend(g_freeQ, &i, 0);
+    }
+
     g_stopRequested  = false;
-    g_cmdNext        = false;
-    g_cmdPrev        = false;
-    g_cmdPauseToggle = false;
-    g_cmdVolDelta    = 0;
     g_paused         = false;
     g_volume         = 0.05f;
+    g_stats          = Stats();
+
+    xTaskCreatePinnedToCore(
+      readerTask,
+      "audioReader",
+      SPEAKER_READER_TASK_STACK,
+      nullptr,
+      SPEAKER_READER_TASK_PRIO,
+      &g_readerTaskHandle,
+      SPEAKER_TASK_CORE
+    );
 
-    xTaskCreate(
+    xTaskCreatePinnedToCore(
       audioTask,
       "audioPlayer",
-      4096,
+      SPEAKER_AUDIO_TASK_STACK,
       nullptr,
-      1,
-      &g_audioTaskHandle
+      SPEAKER_AUDIO_TASK_PRIO,
+      &g_audioTaskHandle,
+      SPEAKER_TASK_CORE
     );
   }
 
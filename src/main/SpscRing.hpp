@@ -0,0 +1,76 @@
+/*
+ * Lock-free Single-Producer / Single-Consumer Ring Buffer
+ *
+ * Fixed-size queue for handing data from exactly one producer task to exactly
+ * one consumer task without a mutex. The producer only writes head, the consumer
+ * only writes tail, so neither side can block or be priority-inverted by the other.
+ * When the ring is full, push() fails and the overflow counter is incremented,
+ * which makes it visible when the consumer falls behind.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+template <typename T, size_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  /*
+   * Appends one element (producer side only)
+   * Returns false and counts an overflow if the ring is full.
+   */
+  bool push(const T &item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail >= N) {
+      overflows_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    buf_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+
+    size_t used = head + 1 - tail;
+    if (used > highWater_.load(std::memory_order_relaxed)) {
+      highWater_.store((uint32_t)used, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  /*
+   * Removes the oldest element (consumer side only)
+   * Returns false if the ring is empty.
+   */
+  bool pop(T &out) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head = head_.load(std::memory_order_acquire);
+    if (tail == head) return false;
+
+    out = buf_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Number of elements currently queued (approximate when called concurrently) */
+  size_t size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  static constexpr size_t capacity() { return N; }
+
+  /* Total pushes rejected because the ring was full */
+  uint32_t overflowCount() const { return overflows_.load(std::memory_order_relaxed); }
+
+  /* Highest fill level seen since construction */
+  uint32_t highWater() const { return highWater_.load(std::memory_order_relaxed); }
+
+private:
+  T buf_[N];
+  std::atomic<size_t>   head_{0};
+  std::atomic<size_t>   tail_{0};
+  std::atomic<uint32_t> overflows_{0};
+  std::atomic<uint32_t> highWater_{0};
+};
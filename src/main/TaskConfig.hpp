@@ -0,0 +1,157 @@
+/*
+ * Task Layout
+ *
+ * Priorities, stack sizes and core affinity of every task the firmware
+ * creates, in one place so the whole plan can be read (and overridden with
+ * -D flags) at once. Every task is created with xTaskCreatePinnedToCore.
+ *
+ * Ordering, highest first:
+ *   audioPlayer   refills I2S DMA; a late refill is an audible click
+ *   audioReader   keeps the prefetch queue ahead of audioPlayer
+ *   sensorTask    reads VL53L0X results into frames (and sensorBus1)
+ *   sensorBoot    brings the sensors up at boot, then starts sensorTask and exits
+ *   gestureTask   preprocessing, classification and player commands
+ *   logFlush      drains the log ring to SD
+ *   webServer     file manager, on spare CPU time only (webDownload streams too)
+ *
+ * Every task sits above tskIDLE_PRIORITY, so none of them has to share time
+ * slices with the idle task (and the watchdog feed it runs).
+ *
+ * On dual-core chips the audio pair gets core 1 to itself; sensors, gestures,
+ * logging and the web server share core 0 with the WiFi and lwIP tasks. On
+ * single-core chips (ESP32-C6) everything shares core 0 and only the priority
+ * ordering applies. Note the WiFi driver tasks run at priorities around 18-23
+ * there, so WiFi traffic can still delay audio; the DMA depth has to cover it.
+ *
+ * A change to this plan should be checked against the "refill jitter avg/max"
+ * figures in the periodic Speaker stats log line, before and after.
+ */
+
+#pragma once
+
+extern "C" {
+  #include "freertos/FreeRTOS.h"
+  #include "freertos/task.h"
+}
+
+// -------- cores --------
+
+#if portNUM_PROCESSORS > 1
+#define TASK_AUDIO_CORE  1
+#define TASK_APP_CORE    0
+#else
+#define TASK_AUDIO_CORE  0
+#define TASK_APP_CORE    0
+#endif
+
+#if portNUM_PROCESSORS > 1 && defined(CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_1) && TASK_AUDIO_CORE == 1
+#warning "WiFi task is pinned to the audio core; set CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_0"
+#endif
+
+// -------- audio --------
+
+#ifndef SPEAKER_AUDIO_TASK_PRIO
+#define SPEAKER_AUDIO_TASK_PRIO   6
+#endif
+
+#ifndef SPEAKER_AUDIO_TASK_STACK
+#define SPEAKER_AUDIO_TASK_STACK  4096
+#endif
+
+#ifndef SPEAKER_READER_TASK_PRIO
+#define SPEAKER_READER_TASK_PRIO  5
+#endif
+
+// MP3 decoding runs in the reader task and needs the extra stack
+#ifndef SPEAKER_READER_TASK_STACK
+#if defined(SPEAKER_MP3) && SPEAKER_MP3
+#define SPEAKER_READER_TASK_STACK 6144
+#else
+#define SPEAKER_READER_TASK_STACK 4096
+#endif
+#endif
+
+#ifndef SPEAKER_TASK_CORE
+#define SPEAKER_TASK_CORE         TASK_AUDIO_CORE
+#endif
+
+// -------- sensors and gestures --------
+
+#ifndef SENSOR_TASK_PRIO
+#define SENSOR_TASK_PRIO          4
+#endif
+
+#ifndef SENSOR_TASK_STACK
+#define SENSOR_TASK_STACK         4096
+#endif
+
+#ifndef SENSOR_TASK_CORE
+#define SENSOR_TASK_CORE          TASK_APP_CORE
+#endif
+
+// One-shot bring-up and self-test at boot, so audio does not wait for the sensors
+#ifndef SENSOR_BOOT_TASK_PRIO
+#define SENSOR_BOOT_TASK_PRIO     SENSOR_TASK_PRIO
+#endif
+
+#ifndef SENSOR_BOOT_TASK_STACK
+#define SENSOR_BOOT_TASK_STACK    4096
+#endif
+
+#ifndef SENSOR_BOOT_TASK_CORE
+#define SENSOR_BOOT_TASK_CORE     TASK_APP_CORE
+#endif
+
+// Second-bus readout task; same priority and core as the sensor task that reads frames
+#ifndef SENSORARRAY_AUX_TASK_PRIO
+#define SENSORARRAY_AUX_TASK_PRIO SENSOR_TASK_PRIO
+#endif
+
+#ifndef SENSORARRAY_AUX_TASK_STACK
+#define SENSORARRAY_AUX_TASK_STACK 3072
+#endif
+
+#ifndef GESTURE_TASK_PRIO
+#define GESTURE_TASK_PRIO         3
+#endif
+
+#ifndef GESTURE_TASK_STACK
+#define GESTURE_TASK_STACK        4096
+#endif
+
+#ifndef GESTURE_TASK_CORE
+#define GESTURE_TASK_CORE         TASK_APP_CORE
+#endif
+
+// -------- background --------
+
+#ifndef LOGGER_FLUSH_TASK_PRIO
+#define LOGGER_FLUSH_TASK_PRIO    2
+#endif
+
+#ifndef LOGGER_FLUSH_TASK_STACK
+#define LOGGER_FLUSH_TASK_STACK   3072
+#endif
+
+#ifndef LOGGER_FLUSH_TASK_CORE
+#define LOGGER_FLUSH_TASK_CORE    TASK_APP_CORE
+#endif
+
+// Below every other application task (level with Arduino's loopTask), just above idle
+#ifndef WEBFM_TASK_PRIO
+#define WEBFM_TASK_PRIO           (tskIDLE_PRIORITY + 1)
+#endif
+
+#ifndef WEBFM_TASK_STACK
+#define WEBFM_TASK_STACK          6144
+#endif
+
+// Download streamers run beside the request loop, at its priority and on its core
+#ifndef WEBFM_DOWNLOAD_TASK_STACK
+#define WEBFM_DOWNLOAD_TASK_STACK 3072
+#endif
+
+// Core 0 is where the WiFi/lwIP tasks already live
+#ifndef WEBFM_TASK_CORE
+#define WEBFM_TASK_CORE           TASK_APP_CORE
+#endif
@@ -0,0 +1,126 @@
+/*
+ * Sensor Trace Capture
+ *
+ * Records the raw frames gestureTask feeds into GesturePreprocessor, plus
+ * optional ground-truth labels, as LogRecord::Frame / TraceLabel records. The
+ * trace can then be replayed on a host through the same preprocessor and
+ * classifier code with tools/gesturereplay, which makes tuning and regression
+ * checks deterministic instead of depending on someone waving at the board.
+ *
+ * Two sinks:
+ *  - Log:    records go into the binary log (needs LOGGER_BINARY) and end up in
+ *            /system.bin next to everything else; logdecode prints them too.
+ *  - Serial: records are written raw to the serial port; the record sync byte
+ *            lets the replay tool skip any text printed in between.
+ */
+
+#pragma once
+#include <Arduino.h>
+
+#include <GestureTypes.hpp>
+#include <LogRecord.hpp>
+#include <Logger.hpp>
+
+namespace TraceCapture {
+
+  enum class Sink : uint8_t {
+    Off = 0,
+    Log,
+    Serial
+  };
+
+  // ------- internal shared state --------
+
+  inline volatile Sink& sinkRef() {
+    static volatile Sink s = Sink::Off;
+    return s;
+  }
+
+  inline volatile uint32_t& framesRef() {
+    static volatile uint32_t n = 0;
+    return n;
+  }
+
+  inline const char* sinkName(Sink s) {
+    switch (s) {
+      case Sink::Log:    return "log";
+      case Sink::Serial: return "serial";
+      default:           return "off";
+    }
+  }
+
+  inline void emit(LogRecord::Event ev, const void* payload, size_t len) {
+    if (sinkRef() == Sink::Log) {
+      Logger::event(Logger::Level::Info, ev, payload, len);
+    } else if (sinkRef() == Sink::Serial) {
+      uint8_t buf[sizeof(LogRecord::Header) + LogRecord::MAX_PAYLOAD];
+      ::Serial.write(buf, LogRecord::encode(buf, (uint8_t)Logger::Level::Info, ev,
+                                            millis(), payload, len));
+    }
+  }
+
+  // -------- public API --------
+
+  /*
+   * Starts capturing to the given sink; Sink::Off stops
+   * Returns false if the sink is not available in this build.
+   */
+  inline bool start(Sink s) {
+#if !LOGGER_BINARY
+    if (s == Sink::Log) {
+      Logger::log(Logger::Level::Warn, "TraceCapture: log sink needs LOGGER_BINARY");
+      LOGGER_DEBUG(Serial.println("TraceCapture: log sink needs LOGGER_BINARY"));
+      return false;
+    }
+#endif
+    framesRef() = 0;
+    sinkRef()   = s;
+    Logger::logf(Logger::Level::Info, "TraceCapture: sink %s", sinkName(s));
+    return true;
+  }
+
+  inline void stop() {
+    if (sinkRef() == Sink::Off) return;
+    sinkRef() = Sink::Off;
+    Logger::logf(Logger::Level::Info, "TraceCapture: stopped after %lu frames",
+                 (unsigned long)framesRef());
+  }
+
+  inline bool active() {
+    return sinkRef() != Sink::Off;
+  }
+
+  inline Sink sink() {
+    return sinkRef();
+  }
+
+  inline uint32_t frames() {
+    return framesRef();
+  }
+
+  /*
+   * Records one frame exactly as passed to GesturePreprocessor::update()
+   * Call from the consumer side only; a no-op when capture is off.
+   */
+  inline void frame(const uint16_t d[3], const uint32_t tUs[3]) {
+    if (sinkRef() == Sink::Off) return;
+    LogRecord::FramePayload p;
+    for (uint8_t i = 0; i < 3; ++i) {
+      p.d[i]   = d[i];
+      p.tUs[i] = tUs[i];
+    }
+    emit(LogRecord::Event::Frame, &p, sizeof(p));
+    framesRef() = framesRef() + 1;
+  }
+
+  /*
+   * Marks the gesture about to be performed; the replay tool scores the next
+   * episode against it. GestureDir::None labels deliberate non-gestures.
+   */
+  inline void label(GestureDir dir) {
+    if (sinkRef() == Sink::Off) return;
+    uint8_t d = (uint8_t)dir;
+    emit(LogRecord::Event::TraceLabel, &d, sizeof(d));
+  }
+
+} // namespace TraceCapture
@@ -5,6 +5,12 @@
  * Creates a WiFi access point and hosts a simple web server that allows
  * uploading, downloading, and deleting WAV files through a browser.
  * Useful for updating the music library without removing the SD card.
+ * All card access goes through SdBus at web priority, one chunk per bus
+ * acquisition, so file transfers cannot starve audio playback.
+ * The server runs in its own task (core and priority set below), so a slow
+ * client only ever stalls the file manager, never the gesture or audio tasks.
+ * Download bodies are streamed by a small pool of worker tasks, so a slow
+ * download does not hold up other clients either.
  */
 
 #pragma once
@@ -12,16 +18,52 @@
 #include <WebServer.h>
 #include <SD.h>
 #include <SPI.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <Logger.hpp>
+#include <Profiler.hpp>
+#include <SdBus.hpp>
+#include <FileIndex.hpp>
+#include <Playlist.hpp>
+#include <TaskConfig.hpp>
 
 extern "C" {
   #include "freertos/FreeRTOS.h"
-  #include "freertos/semphr.h"
+  #include "freertos/task.h"
 }
 
+// Upload staging buffer; a multiple of 512 bytes, ideally the card's cluster size
+#ifndef WEBFM_UPLOAD_STAGE_BYTES
+#define WEBFM_UPLOAD_STAGE_BYTES 16384
+#endif
+
+// VFS mount point passed to SD.begin(), needed for POSIX truncate()
+#ifndef WEBFM_SD_MOUNT
+#define WEBFM_SD_MOUNT "/sd"
+#endif
+
+// Idle time between handleClient() polls
+#ifndef WEBFM_POLL_MS
+#define WEBFM_POLL_MS     2
+#endif
+
+// Downloads streamed concurrently with other requests; 0 streams them in the request loop
+#ifndef WEBFM_DOWNLOAD_WORKERS
+#define WEBFM_DOWNLOAD_WORKERS 2
+#endif
+
+// Uploads are written here and renamed over the target once complete
+#define WEBFM_UPLOAD_TMP "/.upload.tmp"
+
 namespace WebFileManager {
 
+  static_assert(WEBFM_UPLOAD_STAGE_BYTES % 512 == 0, "upload stage must be sector-aligned");
+
   // ------- internal shared state --------
 
   inline WebServer& server() {
@@ -29,14 +71,28 @@ namespace WebFileManager {
     return s;
   }
 
-  inline SemaphoreHandle_t& sdMutexRef() {
-    static SemaphoreHandle_t m = nullptr;
-    return m;
+  static const SdBus::Client BUS = SdBus::Client::Web;
+
+  /*
+   * State of the upload in progress (the server handles one request at a time)
+   */
+  struct UploadState {
+    File     file;
+    bool     failed    = false;  // a write failed or the bus timed out; discard
+    uint32_t startUs   = 0;
+    size_t   staged    = 0;      // bytes in stage() not yet written
+    size_t   written   = 0;      // bytes written to the temp file
+    size_t   prealloc  = 0;      // bytes preallocated from Content-Length, 0 if none
+  };
+
+  inline UploadState& uploadRef() {
+    static UploadState u;
+    return u;
   }
 
-  inline File& uploadFileRef() {
-    static File f;
-    return f;
+  inline uint8_t* stage() {
+    static uint8_t buf[WEBFM_UPLOAD_STAGE_BYTES];
+    return buf;
   }
 
   inline const char*& ssidRef() {
@@ -49,156 +105,419 @@ namespace WebFileManager {
     return p;
   }
 
-  // -------- helpers --------
+  inline TaskHandle_t& taskRef() {
+    static TaskHandle_t t = nullptr;
+    return t;
+  }
+
+  // Cleared by stop(); the server task finishes its current request and exits
+  inline volatile bool& runningRef() {
+    static volatile bool r = false;
+    return r;
+  }
 
   /*
-   * Converts a file size in bytes to a human-readable string
-   * Automatically selects appropriate units (B, KB, MB, GB).
+   * A download handed from the request loop to a streaming worker
+   * The worker holds its own reference to the connection, so the socket stays
+   * open after the handler returns and WebServer lets go of it.
    */
-  inline String humanSize(uint64_t bytes) {
-    if (bytes < 1024) return String(bytes) + " B";
-    double kb = bytes / 1024.0;
-    if (kb < 1024) return String(kb, 1) + " KB";
-    double mb = kb / 1024.0;
-    if (mb < 1024) return String(mb, 1) + " MB";
-    double gb = mb / 1024.0;
-    return String(gb, 1) + " GB";
+  struct Download {
+    TaskHandle_t  task   = nullptr;
+    volatile bool busy   = false;  // set by the server task, cleared by the worker when done
+    WiFiClient    client;
+    File          file;
+    String        path;
+    size_t        first  = 0;
+    size_t        length = 0;
+    uint8_t       buf[SDBUS_CHUNK_BYTES];
+  };
+
+  inline Download* downloads() {
+    static Download d[WEBFM_DOWNLOAD_WORKERS ? WEBFM_DOWNLOAD_WORKERS : 1];
+    return d;
   }
 
+  // -------- helpers --------
+
   /*
-   * Generates an HTML table listing all files on the SD card
-   * Includes file names, sizes, and action buttons (download/delete) for each file.
+   * Streams an HTML response with chunked transfer encoding
+   * Text is collected in a fixed scratch buffer and sent with sendContent()
+   * whenever it fills, so a page of any length costs no heap allocations.
    */
-  inline String makeFileTable() {
-    String html;
-
-    SemaphoreHandle_t m = sdMutexRef();
-    if (!m || xSemaphoreTake(m, pdMS_TO_TICKS(200)) != pdTRUE) {
-      return "<p>SD busy or not available.</p>";
+  class PageWriter {
+  public:
+    PageWriter() : used_(0) {}
+
+    void begin(int code, const char* contentType) {
+      server().setContentLength(CONTENT_LENGTH_UNKNOWN);
+      server().send(code, contentType, "");
+      used_ = 0;
     }
 
-    File root = SD.open("/");
-    if (!root) {
-      xSemaphoreGive(m);
-      return "<p>Failed to open SD root.</p>";
+    void write(const char* text, size_t len) {
+      while (len) {
+        if (used_ == sizeof(buf_)) flush();
+        size_t n = sizeof(buf_) - used_;
+        if (n > len) n = len;
+        memcpy(buf_ + used_, text, n);
+        used_ += n;
+        text  += n;
+        len   -= n;
+      }
     }
 
-    html += "<table border='1' cellpadding='4' cellspacing='0'>"
-            "<tr><th>Name</th><th>Size</th><th>Actions</th></tr>";
-
-    while (true) {
-      File f = root.openNextFile();
-      if (!f) break;
-      String name = String(f.name());
-      uint64_t size = f.size();
-      f.close();
-
-      String displayName = name;
-      if (displayName.startsWith("/")) displayName.remove(0, 1);
+    void print(const char* text) { write(text, strlen(text)); }
 
-      html += "<tr>";
-      html += "<td>" + displayName + "</td>";
-      html += "<td>" + humanSize(size) + "</td>";
-      html += "<td>";
-
-      // Download
-      html += "<form style='display:inline' method='GET' action='/download'>";
-      html += "<input type='hidden' name='name' value='" + displayName + "'>";
-      html += "<input type='submit' value='Download'>";
-      html += "</form>";
+    void printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+      char line[256];
+      va_list ap;
+      va_start(ap, fmt);
+      int n = vsnprintf(line, sizeof(line), fmt, ap);
+      va_end(ap);
+      if (n > 0) write(line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+    }
 
-      html += "&nbsp;";
+    // Writes text as a quoted JSON string
+    void printJsonString(const char* text) {
+      write("\"", 1);
+      for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+          write("\\", 1);
+          write(c, 1);
+        } else if ((uint8_t)*c < 0x20) {
+          printf("\\u%04x", (unsigned)(uint8_t)*c);
+        } else {
+          write(c, 1);
+        }
+      }
+      write("\"", 1);
+    }
 
-      // Delete
-      html += "<form style='display:inline' method='POST' action='/delete' ";
-      html += "onsubmit='return confirm(\"Delete " + displayName + " ?\");'>";
-      html += "<input type='hidden' name='name' value='" + displayName + "'>";
-      html += "<input type='submit' value='Delete'>";
-      html += "</form>";
+    // Writes text with HTML/attribute metacharacters escaped
+    void printEscaped(const char* text) {
+      for (const char* c = text; *c; ++c) {
+        switch (*c) {
+          case '&':  print("&amp;");  break;
+          case '<':  print("&lt;");   break;
+          case '>':  print("&gt;");   break;
+          case '"':  print("&quot;"); break;
+          case '\'': print("&#39;");  break;
+          default:   write(c, 1);     break;
+        }
+      }
+    }
 
-      html += "</td>";
-      html += "</tr>";
+    void flush() {
+      if (used_) server().sendContent(buf_, used_);
+      used_ = 0;
     }
 
-    html += "</table>";
+    // Sends what is left and the terminating zero-length chunk
+    void end() {
+      flush();
+      server().sendContent("");
+    }
 
-    xSemaphoreGive(m);
-    return html;
-  }
+  private:
+    char   buf_[1024];
+    size_t used_;
+  };
 
   // -------- HTTP handlers --------
 
+  /*
+   * Browser side of the file list: pages through /api/files and renders the table
+   */
+  static const char FILE_LIST_SCRIPT[] =
+    "<script>"
+    "function hs(b){var u=['B','KB','MB','GB'],i=0;"
+    "while(b>=1024&&i<3){b/=1024;i++;}return (i?b.toFixed(1):b)+' '+u[i];}"
+    "function esc(s){return s.replace(/[&<>\"']/g,function(c){"
+    "return '&#'+c.charCodeAt(0)+';';});}"
+    "function row(f){var n=esc(f.name),s=hs(f.size);"
+    "if(f.rate)s+=' ('+f.rate+' Hz, '+f.channels+' ch, '+(f.durationMs/1000).toFixed(1)+' s)';"
+    "return '<tr><td>'+n+'</td><td>'+s+'</td><td>'"
+    "+\"<form style='display:inline' method='GET' action='/download'>\""
+    "+\"<input type='hidden' name='name' value='\"+n+\"'><input type='submit' value='Download'></form>&nbsp;\""
+    "+\"<form style='display:inline' method='POST' action='/delete' onsubmit='return confirm(&quot;Delete \"+n+\" ?&quot;);'>\""
+    "+\"<input type='hidden' name='name' value='\"+n+\"'><input type='submit' value='Delete'></form></td></tr>\";}"
+    "function load(off){fetch('/api/files?offset='+off+'&limit=100').then(function(r){return r.json();})"
+    ".then(function(j){var t=document.getElementById('files');"
+    "j.files.forEach(function(f){t.insertAdjacentHTML('beforeend',row(f));});"
+    "if(off+j.files.length<j.total&&j.files.length)load(off+j.files.length);});}"
+    "load(0);"
+    "</script>";
+
   /*
    * Serves the main file manager page
-   * Displays the upload form and lists all files currently on the SD card.
+   * Displays the upload form and an empty file table that the browser fills
+   * from /api/files, so serving the page never touches the SD card.
    */
   inline void handleRoot() {
-    String page;
-    page += "<html><head><title>ESP32 SD File Manager</title></head><body>";
-    page += "<h2>ESP32 SD File Manager</h2>";
+    PageWriter page;
+    page.begin(200, "text/html");
+
+    page.print("<html><head><title>ESP32 SD File Manager</title></head><body>"
+               "<h2>ESP32 SD File Manager</h2>");
 
     // Upload form
-    page += "<h3>Upload file</h3>";
-    page += "<form method='POST' action='/upload' enctype='multipart/form-data'>";
-    page += "File: <input type='file' name='upload'><br><br>";
-    page += "<input type='submit' value='Upload'>";
-    page += "</form>";
+    page.print("<h3>Upload file</h3>"
+               "<form method='POST' action='/upload' enctype='multipart/form-data'>"
+               "File: <input type='file' name='upload'><br><br>"
+               "<input type='submit' value='Upload'>"
+               "</form>");
 
     // File list
-    page += "<h3>Files on SD</h3>";
-    page += makeFileTable();
+    page.print("<h3>Files on SD</h3>"
+               "<table id='files' border='1' cellpadding='4' cellspacing='0'>"
+               "<tr><th>Name</th><th>Size</th><th>Actions</th></tr></table>"
+               "<noscript><p>The file list needs JavaScript.</p></noscript>");
+    page.print(FILE_LIST_SCRIPT);
+
+    page.print("<br><hr><small>Connect to WiFi \"");
+    page.printEscaped(ssidRef());
+    page.print("\" and open http://192.168.4.1/</small></body></html>");
+
+    page.end();
+  }
+
+  /*
+   * Serves one page of the directory index as JSON
+   * GET /api/files?offset=0&limit=50 returns
+   *   {"total":N,"offset":0,"files":[{"name":..,"size":..,"rate":..,
+   *    "channels":..,"bits":..,"durationMs":..}, ...]}
+   * rate/channels/bits/durationMs are 0 for files that are not WAV or MP3;
+   * bits is 4 for IMA ADPCM and 0 for MP3.
+   */
+  inline void handleApiFiles() {
+    static const size_t MAX_LIMIT = 200;
+
+    size_t offset = server().hasArg("offset") ? (size_t)server().arg("offset").toInt() : 0;
+    size_t limit  = server().hasArg("limit")  ? (size_t)server().arg("limit").toInt()  : 50;
+    if (limit == 0 || limit > MAX_LIMIT) limit = MAX_LIMIT;
+
+    PageWriter page;
+    page.begin(200, "application/json");
+    page.printf("{\"total\":%u,\"offset\":%u,\"files\":[",
+                (unsigned)FileIndex::count(), (unsigned)offset);
+
+    FileIndex::Entry e;
+    for (size_t i = 0; i < limit && FileIndex::get(offset + i, e); ++i) {
+      page.print(i ? ",{\"name\":" : "{\"name\":");
+      page.printJsonString(e.name);
+      page.printf(",\"size\":%lu,\"rate\":%lu,\"channels\":%u,\"bits\":%u,\"durationMs\":%lu}",
+                  (unsigned long)e.size, (unsigned long)e.sampleRate,
+                  (unsigned)e.channels, (unsigned)e.bits, (unsigned long)e.durationMs);
+    }
+
+    page.print("]}");
+    page.end();
+  }
+
+  /*
+   * Serves runtime statistics as JSON
+   * GET /stats returns
+   *   {"uptimeMs":..,"cpuMHz":..,"heapFree":..,"heapMin":..,"profiler":true|false,
+   *    "probes":[{"name":..,"count":..,"meanCyc":..,"p50Cyc":..,"p99Cyc":..,
+   *               "maxCyc":..,"recentMaxCyc":..,"hist":[..]}, ...],
+   *    "tasks":[{"name":..,"prio":..,"stackFree":..,"cpuPermille":..}, ...],
+   *    "sdbus":[{"client":..,"acquired":..,"timeouts":..,"deferred":..,
+   *              "waitMaxUs":..,"holdMaxUs":..}, ...],
+   *    "speaker":{"played":..,"underruns":..,"readErrors":..,"sdReadKB":..,
+   *               "refillJitterAvgUs":..,"refillJitterMaxUs":..,"resampled":..,
+   *               "i2sRate":..}}
+   * probes is empty unless built with PROFILER_ENABLE; cpuPermille covers the
+   * time since the previous snapshot (this endpoint or the serial dump).
+   */
+  inline void handleStats() {
+    static Profiler::TaskInfo tasks[PROFILER_MAX_TASKS];
+    char item[512];   // one probe with a full histogram
+
+    PageWriter page;
+    page.begin(200, "application/json");
+    page.printf("{\"uptimeMs\":%lu,\"cpuMHz\":%lu,\"heapFree\":%lu,\"heapMin\":%lu,"
+                "\"profiler\":%s,\"probes\":[",
+                (unsigned long)millis(), (unsigned long)getCpuFrequencyMhz(),
+                (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(),
+                Profiler::enabled() ? "true" : "false");
+
+    if (Profiler::enabled()) {
+      for (uint8_t p = 0; p < Profiler::PROBE_COUNT; ++p) {
+        if (p) page.print(",");
+        Profiler::formatProbeJson(item, sizeof(item), (Profiler::Probe)p);
+        page.print(item);
+      }
+    }
 
-    page += "<br><hr><small>Connect to WiFi \"";
-    page += ssidRef();
-    page += "\" and open http://192.168.4.1/</small>";
-    page += "</body></html>";
+    page.print("],\"tasks\":[");
+    size_t n = Profiler::taskSnapshot(tasks, PROFILER_MAX_TASKS);
+    for (size_t i = 0; i < n; ++i) {
+      if (i) page.print(",");
+      Profiler::formatTaskJson(item, sizeof(item), tasks[i]);
+      page.print(item);
+    }
+
+    page.print("],\"sdbus\":[");
+    for (uint8_t c = 0; c < SdBus::CLIENT_COUNT; ++c) {
+      SdBus::ClientStats s = SdBus::stats((SdBus::Client)c);
+      page.printf("%s{\"client\":\"%s\",\"acquired\":%lu,\"timeouts\":%lu,\"deferred\":%lu,"
+                  "\"waitMaxUs\":%lu,\"holdMaxUs\":%lu}",
+                  c ? "," : "", SdBus::clientName((SdBus::Client)c),
+                  (unsigned long)s.acquired, (unsigned long)s.timeouts,
+                  (unsigned long)s.deferred, (unsigned long)s.waitMaxUs,
+                  (unsigned long)s.holdMaxUs);
+    }
 
-    server().send(200, "text/html", page);
+    Speaker::Stats st = Speaker::stats();
+    page.printf("],\"speaker\":{\"played\":%lu,\"underruns\":%lu,\"readErrors\":%lu,"
+                "\"sdReadKB\":%lu,\"refillJitterAvgUs\":%lu,\"refillJitterMaxUs\":%lu,\"resampled\":%lu,"
+                "\"i2sRate\":%lu}}",
+                (unsigned long)st.blocksPlayed, (unsigned long)st.underruns,
+                (unsigned long)st.readErrors, (unsigned long)(st.bytesRead / 1024),
+                (unsigned long)(st.refills ? st.refillJitterTotalUs / st.refills : 0),
+                (unsigned long)st.refillJitterMaxUs, (unsigned long)st.blocksResampled,
+                (unsigned long)Speaker::g_i2sRate);
+    page.end();
+  }
+
+  /*
+   * Writes the staged upload bytes to the temp file
+   * The whole stage goes out under one bus acquisition in SDBUS_CHUNK_BYTES
+   * pieces; if audio wants the card between pieces the bus is released and
+   * re-acquired. Sets failed on a short write or bus timeout.
+   */
+  inline void writeStage(UploadState& u) {
+    size_t off = 0;
+    while (off < u.staged && !u.failed) {
+      if (!SdBus::acquire(BUS, pdMS_TO_TICKS(500))) {
+        u.failed = true;
+        break;
+      }
+      do {
+        size_t len = u.staged - off;
+        if (len > SDBUS_CHUNK_BYTES) len = SDBUS_CHUNK_BYTES;
+        size_t w = u.file.write(stage() + off, len);
+        off       += w;
+        u.written += w;
+        if (w != len) u.failed = true;
+      } while (off < u.staged && !u.failed && !SdBus::shouldYield(BUS));
+      SdBus::release(BUS);
+    }
+    u.staged = 0;
+  }
+
+  /*
+   * Closes and deletes the temp file of a failed or aborted upload
+   */
+  inline void discardUpload(UploadState& u) {
+    if (SdBus::acquire(BUS)) {
+      if (u.file) u.file.close();
+      SD.remove(WEBFM_UPLOAD_TMP);
+      SdBus::release(BUS);
+    }
   }
 
   /*
    * Handles file uploads from the web interface
-   * Receives file data in chunks and writes it to the SD card.
+   * Incoming ~1.4 KB pieces are coalesced into a sector-aligned staging buffer
+   * and written WEBFM_UPLOAD_STAGE_BYTES at a time to a temp file. The temp file
+   * is preallocated from Content-Length when the client sends one. At the end it
+   * is trimmed to the real length and renamed over the target, so a failed or
+   * aborted upload never leaves a truncated file under the real name. FAT has no
+   * atomic replace: the old file is removed just before the rename.
    */
   inline void handleUpload() {
     HTTPUpload& upload = server().upload();
-    File& uploadFile = uploadFileRef();
-
-    SemaphoreHandle_t m = sdMutexRef();
+    UploadState& u = uploadRef();
 
     if (upload.status == UPLOAD_FILE_START) {
-      String filename = "/" + upload.filename;
-      Serial.print("Upload start: ");
-      Serial.println(filename);
-
-      if (m && xSemaphoreTake(m, pdMS_TO_TICKS(500)) == pdTRUE) {
-        if (SD.exists(filename)) SD.remove(filename);
-        uploadFile = SD.open(filename, FILE_WRITE);
-        xSemaphoreGive(m);
+      Serial.print("Upload start: /");
+      Serial.println(upload.filename);
+
+      u = UploadState();
+      u.startUs = micros();
+
+      // Content-Length covers the multipart framing too, so it is an upper bound
+      size_t expected = server().clientContentLength();
+
+      if (SdBus::acquire(BUS, pdMS_TO_TICKS(500))) {
+        SD.remove(WEBFM_UPLOAD_TMP);
+        u.file = SD.open(WEBFM_UPLOAD_TMP, FILE_WRITE);
+        if (u.file && expected > 0 && expected != CONTENT_LENGTH_NOT_SET &&
+            expected != CONTENT_LENGTH_UNKNOWN) {
+          // Seeking past the end of a file open for writing extends its cluster chain
+          if (u.file.seek(expected) && u.file.seek(0)) u.prealloc = expected;
+        }
+        SdBus::release(BUS);
       }
+      if (!u.file) u.failed = true;
     }
     else if (upload.status == UPLOAD_FILE_WRITE) {
-      if (uploadFile) {
-        uploadFile.write(upload.buf, upload.currentSize);
+      const uint8_t* in  = upload.buf;
+      size_t         len = upload.currentSize;
+      while (len && !u.failed) {
+        size_t n = WEBFM_UPLOAD_STAGE_BYTES - u.staged;
+        if (n > len) n = len;
+        memcpy(stage() + u.staged, in, n);
+        u.staged += n;
+        in       += n;
+        len      -= n;
+        if (u.staged == WEBFM_UPLOAD_STAGE_BYTES) writeStage(u);
       }
     }
     else if (upload.status == UPLOAD_FILE_END) {
-      if (uploadFile) {
-        uploadFile.close();
-        Serial.print("Upload end, size = ");
-        Serial.println(upload.totalSize);
+      if (!u.failed && u.staged) writeStage(u);
+
+      const String target  = "/" + upload.filename;
+      bool         renamed = false;
+
+      if (!u.failed && SdBus::acquire(BUS)) {
+        u.file.close();
+        // Drop the preallocated tail beyond the bytes actually received
+        if (u.prealloc > u.written) {
+          u.failed = ::truncate(WEBFM_SD_MOUNT WEBFM_UPLOAD_TMP, (off_t)u.written) != 0;
+        }
+        if (!u.failed) {
+          if (SD.exists(target)) SD.remove(target);
+          renamed = SD.rename(WEBFM_UPLOAD_TMP, target);
+          if (renamed) FileIndex::refreshLocked(target.c_str());
+        }
+        SdBus::release(BUS);
+      }
+      // Takes the bus itself; the playlist lock comes before the bus
+      if (renamed) Playlist::add(target.c_str());
+
+      const uint32_t elapsedUs = micros() - u.startUs;
+      const float    mbps      = elapsedUs ? (float)u.written / (float)elapsedUs : 0.0f;
+
+      char line[200];
+      if (renamed) {
+        snprintf(line, sizeof(line), "Upload finished: %s (%u bytes in %lu ms, %.2f MB/s)",
+                 target.c_str(), (unsigned)u.written,
+                 (unsigned long)(elapsedUs / 1000), mbps);
+        Logger::log(Logger::Level::Info, line);
+        Serial.println(line);
       } else {
-        Logger::log(Logger::Level::Error, "Upload failed: file not open");
-        LOGGER_DEBUG(Serial.println("Upload failed: file not open"));
+        discardUpload(u);
+        snprintf(line, sizeof(line), "Upload failed: %s (write error or SD busy after %u bytes)",
+                 target.c_str(), (unsigned)u.written);
+        Logger::log(Logger::Level::Error, line);
+        LOGGER_DEBUG(Serial.println(line));
       }
 
-      String page;
-      page += "<html><body>";
-      page += "<p>Upload finished: " + String(upload.filename) + "</p>";
-      page += "<a href='/'>Back to file manager</a>";
-      page += "</body></html>";
-
-      server().send(200, "text/html", page);
+      PageWriter page;
+      page.begin(renamed ? 200 : 500, "text/html");
+      page.print("<html><body><p>");
+      page.printEscaped(line);
+      page.print("</p><a href='/'>Back to file manager</a></body></html>");
+      page.end();
+    }
+    else if (upload.status == UPLOAD_FILE_ABORTED) {
+      Logger::logf(Logger::Level::Warn, "Upload aborted: /%s after %u bytes",
+                   upload.filename.c_str(), (unsigned)(u.written + u.staged));
+      LOGGER_DEBUG(Serial.println("Upload aborted"));
+      discardUpload(u);
+      u = UploadState();
     }
   }
 
@@ -218,10 +537,11 @@ namespace WebFileManager {
     Serial.print("Delete request: ");
     Serial.println(fullPath);
 
-    SemaphoreHandle_t m = sdMutexRef();
-    if (m && xSemaphoreTake(m, pdMS_TO_TICKS(200)) == pdTRUE) {
+    bool removed = false;
+    if (SdBus::acquire(BUS, pdMS_TO_TICKS(200))) {
       if (SD.exists(fullPath)) {
-        SD.remove(fullPath);
+        removed = SD.remove(fullPath);
+        FileIndex::remove(fullPath.c_str());
         Serial.println("File deleted.");
       } else {
         Logger::logf(Logger::Level::Warn,
@@ -229,16 +549,118 @@ namespace WebFileManager {
                      fullPath.c_str());
         LOGGER_DEBUG(Serial.println("File not found."));
       }
-      xSemaphoreGive(m);
+      SdBus::release(BUS);
     }
+    if (removed) Playlist::remove(fullPath.c_str());
 
     server().sendHeader("Location", "/", true);
     server().send(303);
   }
 
+  /*
+   * Parses a single-range "bytes=" Range header against a file of `size` bytes
+   * Returns 1 with [first, last] set for a satisfiable range, 0 if the header
+   * should be ignored (malformed, multi-range), -1 if it is unsatisfiable.
+   */
+  inline int parseRange(const String& header, size_t size, size_t& first, size_t& last) {
+    if (!header.startsWith("bytes=") || header.indexOf(',') >= 0) return 0;
+
+    const char* spec = header.c_str() + 6;
+    const char* dash = strchr(spec, '-');
+    if (!dash) return 0;
+
+    char* end = nullptr;
+    if (dash == spec) {
+      // bytes=-N: the last N bytes
+      unsigned long n = strtoul(dash + 1, &end, 10);
+      if (end == dash + 1 || *end) return 0;
+      if (n == 0 || size == 0) return -1;
+      first = n >= size ? 0 : size - n;
+      last  = size - 1;
+      return 1;
+    }
+
+    unsigned long a = strtoul(spec, &end, 10);
+    if (end != dash) return 0;
+    unsigned long b = size ? size - 1 : 0;
+    if (dash[1]) {
+      b = strtoul(dash + 1, &end, 10);
+      if (*end || b < a) return 0;
+      if (size && b > size - 1) b = size - 1;
+    }
+    if (a >= size) return -1;
+    first = a;
+    last  = b;
+    return 1;
+  }
+
+  /*
+   * Sends `length` bytes of an open file to a client, one SDBUS_CHUNK_BYTES
+   * read per bus acquisition; stops early if the client goes away or stop()
+   * is called. Returns the number of bytes sent.
+   */
+  inline size_t streamFile(WiFiClient& client, File& f, size_t length, uint8_t* buf) {
+    size_t sent = 0;
+    while (sent < length && runningRef()) {
+      size_t want = length - sent;
+      if (want > SDBUS_CHUNK_BYTES) want = SDBUS_CHUNK_BYTES;
+
+      if (!SdBus::acquire(BUS, pdMS_TO_TICKS(500))) break;
+      size_t n = f.read(buf, want);
+      SdBus::release(BUS);
+      if (n == 0) break;
+
+      if (client.write(buf, n) != n) break;
+      sent += n;
+      if (!client.connected()) break;
+    }
+    return sent;
+  }
+
+  inline void finishDownload(File& f, const String& path, size_t sent, size_t length, size_t first) {
+    if (sent != length) {
+      Logger::logf(Logger::Level::Warn, "Download of %s stopped at %u of %u bytes (from %u)",
+                   path.c_str(), (unsigned)sent, (unsigned)length, (unsigned)first);
+    }
+    if (SdBus::acquire(BUS)) {
+      f.close();
+      SdBus::release(BUS);
+    }
+  }
+
+  /*
+   * Download worker: streams each body it is handed, then waits for the next
+   */
+  inline void downloadTask(void* arg) {
+    Download& d = *(Download*)arg;
+    for (;;) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      const size_t sent = streamFile(d.client, d.file, d.length, d.buf);
+      finishDownload(d.file, d.path, sent, d.length, d.first);
+      d.client.stop();
+      d.file = File();
+      d.busy = false;
+    }
+  }
+
+  // An idle worker to hand a download to, or nullptr if all are streaming
+  inline Download* idleDownload() {
+    for (size_t i = 0; i < WEBFM_DOWNLOAD_WORKERS; ++i) {
+      Download& d = downloads()[i];
+      if (d.task && !d.busy) return &d;
+    }
+    return nullptr;
+  }
+
   /*
    * Handles file download requests from the web interface
-   * Streams the requested file from SD card to the client browser.
+   * Streams the requested file from SD card to the client browser, one
+   * SDBUS_CHUNK_BYTES read per bus acquisition so the network send never
+   * happens with the bus held. Supports a single byte range (206 Partial
+   * Content, If-Range) for resuming, and ETag/Last-Modified validators
+   * (If-None-Match -> 304) derived from the file size and mtime.
+   * Once the headers are out, the body goes to an idle download worker and the
+   * server task moves on; with all workers busy it is streamed here.
    */
   inline void handleDownload() {
     if (!server().hasArg("name")) {
@@ -252,42 +674,137 @@ namespace WebFileManager {
     Serial.print("Download request: ");
     Serial.println(fullPath);
 
-    SemaphoreHandle_t m = sdMutexRef();
-    if (!m || xSemaphoreTake(m, pdMS_TO_TICKS(200)) != pdTRUE) {
+    if (!SdBus::acquire(BUS, pdMS_TO_TICKS(200))) {
       server().send(503, "text/plain", "SD busy");
       return;
     }
 
     if (!SD.exists(fullPath)) {
-      xSemaphoreGive(m);
+      SdBus::release(BUS);
       server().send(404, "text/plain", "File not found");
       return;
     }
 
     File f = SD.open(fullPath, FILE_READ);
     if (!f) {
-      xSemaphoreGive(m);
+      SdBus::release(BUS);
       server().send(500, "text/plain", "Failed to open file");
       return;
     }
+    const size_t size  = f.size();
+    const time_t mtime = f.getLastWrite();
+    SdBus::release(BUS);
+
+    char etag[32];
+    snprintf(etag, sizeof(etag), "\"%lx-%lx\"", (unsigned long)size, (unsigned long)mtime);
+
+    char lastModified[40];
+    struct tm tmv;
+    gmtime_r(&mtime, &tmv);
+    strftime(lastModified, sizeof(lastModified), "%a, %d %b %Y %H:%M:%S GMT", &tmv);
+
+    auto closeFile = [&]() {
+      if (SdBus::acquire(BUS)) {
+        f.close();
+        SdBus::release(BUS);
+      }
+    };
+
+    server().sendHeader("Accept-Ranges", "bytes");
+    server().sendHeader("ETag", etag);
+    server().sendHeader("Last-Modified", lastModified);
 
-    server().streamFile(f, "application/octet-stream");
-    f.close();
-    xSemaphoreGive(m);
+    if (server().hasHeader("If-None-Match") && server().header("If-None-Match") == etag) {
+      closeFile();
+      server().send(304);
+      return;
+    }
+
+    // A Range is only honoured if If-Range (when present) still matches this version
+    size_t first = 0, last = size ? size - 1 : 0;
+    int    range = 0;
+    if (server().hasHeader("Range")) {
+      const bool current = !server().hasHeader("If-Range") ||
+                           server().header("If-Range") == etag ||
+                           server().header("If-Range") == lastModified;
+      if (current) range = parseRange(server().header("Range"), size, first, last);
+    }
+
+    if (range < 0) {
+      char cr[40];
+      snprintf(cr, sizeof(cr), "bytes */%u", (unsigned)size);
+      server().sendHeader("Content-Range", cr);
+      closeFile();
+      server().send(416, "text/plain", "Range not satisfiable");
+      return;
+    }
+
+    if (range > 0 && first > 0) {
+      bool ok = false;
+      if (SdBus::acquire(BUS, pdMS_TO_TICKS(500))) {
+        ok = f.seek(first);
+        SdBus::release(BUS);
+      }
+      if (!ok) {
+        closeFile();
+        server().send(503, "text/plain", "SD busy or seek failed");
+        return;
+      }
+    }
+
+    const size_t length = size ? last - first + 1 : 0;
+    if (range > 0) {
+      char cr[64];
+      snprintf(cr, sizeof(cr), "bytes %u-%u/%u", (unsigned)first, (unsigned)last, (unsigned)size);
+      server().sendHeader("Content-Range", cr);
+    }
+    server().setContentLength(length);
+    server().send(range > 0 ? 206 : 200, "application/octet-stream", "");
+
+    if (Download* d = idleDownload()) {
+      d->client = server().client();
+      d->file   = f;
+      d->path   = fullPath;
+      d->first  = first;
+      d->length = length;
+      d->busy   = true;
+      xTaskNotifyGive(d->task);
+      return;
+    }
+
+    static uint8_t buf[SDBUS_CHUNK_BYTES];
+    WiFiClient client = server().client();
+    finishDownload(f, fullPath, streamFile(client, f, length, buf), length, first);
+  }
+
+  /*
+   * Server task: polls the WebServer until stop() is called
+   * Handlers block only this task; SD access inside them still goes through
+   * SdBus, so a long transfer cannot hold the card against the audio stream.
+   */
+  inline void serverTask(void*) {
+    while (runningRef()) {
+      server().handleClient();
+      vTaskDelay(pdMS_TO_TICKS(WEBFM_POLL_MS));
+    }
+    taskRef() = nullptr;
+    vTaskDelete(nullptr);
   }
 
   // -------- public API for your main code --------
 
   /*
    * Initializes and starts the WiFi file manager web server
-   * Creates a WiFi access point and sets up HTTP request handlers.
+   * Creates a WiFi access point, sets up HTTP request handlers and starts the
+   * server task on WEBFM_TASK_CORE at WEBFM_TASK_PRIO. Returns false if the
+   * task could not be created.
    * Connect to the specified SSID and navigate to http://192.168.4.1/
    */
-  inline void begin(SemaphoreHandle_t sdMutex,
-                    const char* ssid = "ESP32-Music",
+  inline bool begin(const char* ssid = "ESP32-Music",
                     const char* password = "12345678")
   {
-    sdMutexRef() = sdMutex;
+    if (taskRef()) return true;
+
     ssidRef() = ssid;
     passwordRef() = password;
 
@@ -302,6 +819,8 @@ namespace WebFileManager {
     Serial.println("Open http://192.168.4.1/ in your browser.");
 
     server().on("/", HTTP_GET, handleRoot);
+    server().on("/api/files", HTTP_GET, handleApiFiles);
+    server().on("/stats", HTTP_GET, handleStats);
 
     server().on(
       "/upload",
@@ -313,22 +832,55 @@ namespace WebFileManager {
     server().on("/delete", HTTP_POST, handleDelete);
     server().on("/download", HTTP_GET, handleDownload);
 
+    // Request headers handleDownload needs; WebServer drops the rest
+    static const char* downloadHeaders[] = { "Range", "If-Range", "If-None-Match" };
+    server().collectHeaders(downloadHeaders, sizeof(downloadHeaders) / sizeof(downloadHeaders[0]));
+
+    // The task paces itself with WEBFM_POLL_MS instead of the built-in 1 ms delay
+    server().enableDelay(false);
     server().begin();
-  }
 
-  /*
-   * Processes incoming web requests (call regularly from main loop)
-   * Checks for and handles any pending HTTP requests from clients.
-   */
-  inline void loopOnce() {
-    server().handleClient();
+    // Workers outlive stop(), idle; a missing one only means inline streaming
+    for (size_t i = 0; i < WEBFM_DOWNLOAD_WORKERS; ++i) {
+      Download& d = downloads()[i];
+      if (!d.task &&
+          xTaskCreatePinnedToCore(downloadTask, "webDownload", WEBFM_DOWNLOAD_TASK_STACK,
+                                  &d, WEBFM_TASK_PRIO, &d.task, WEBFM_TASK_CORE) != pdPASS) {
+        d.task = nullptr;
+        Logger::log(Logger::Level::Warn, "WebFileManager: download task creation failed");
+      }
+    }
+
+    runningRef() = true;
+    if (xTaskCreatePinnedToCore(serverTask,
+                                "webServer",
+                                WEBFM_TASK_STACK,
+                                nullptr,
+                                WEBFM_TASK_PRIO,
+                                &taskRef(),
+                                WEBFM_TASK_CORE) != pdPASS) {
+      runningRef() = false;
+      taskRef() = nullptr;
+      server().stop();
+      Logger::log(Logger::Level::Error, "WebFileManager: server task creation failed");
+      LOGGER_DEBUG(Serial.println("WebFileManager: server task creation failed"));
+      return false;
+    }
+    return true;
   }
 
   /*
    * Shuts down the web server and disables WiFi
-   * Call this when the file manager is no longer needed.
+   * Waits for the server task to finish the request it is serving and for
+   * running downloads to wind down, so nothing is left holding the SD bus or
+   * a half-written upload.
    */
   inline void stop() {
+    runningRef() = false;
+    while (taskRef()) vTaskDelay(pdMS_TO_TICKS(WEBFM_POLL_MS));
+    for (size_t i = 0; i < WEBFM_DOWNLOAD_WORKERS; ++i) {
+      while (downloads()[i].busy) vTaskDelay(pdMS_TO_TICKS(WEBFM_POLL_MS));
+    }
     server().stop();
     WiFi.mode(WIFI_OFF);
   }
@@ -12,15 +12,51 @@
 #include <SPI.h>
 #include <SD.h>
 #include <Adafruit_VL53L0X.h>
+#include "soc/soc_caps.h"
 
+#include <SdBus.hpp>
 #include <Logger.hpp>
+#include <Profiler.hpp>
+#include <TaskConfig.hpp>
 #include <GesturePreprocessor.hpp>
 #include <GestureClassifier.hpp>
+#include <SensorArray.hpp>
+#include <SpscRing.hpp>
 #include <Speaker.hpp>
+#include <FileIndex.hpp>
+#include <Playlist.hpp>
+#include <TraceCapture.hpp>
+#include <WebFileManager.hpp>
 
 // I2C + XSHUT wiring
 #define SDA_PIN   6
 #define SCL_PIN   7
+
+// Sensor bus clock: 400 kHz is the VL53L0X's rated fast mode; 1000000 (fast-mode
+// plus) is out of spec for it and only for short, well pulled-up wiring
+#ifndef I2C_CLOCK_HZ
+#define I2C_CLOCK_HZ 400000
+#endif
+
+// Put the top sensor on the second I2C controller (Wire1) so its readout overlaps L/R
+#ifndef SENSOR_SPLIT_BUS
+#define SENSOR_SPLIT_BUS 0
+#endif
+#define SDA2_PIN  10
+#define SCL2_PIN  11
+
+// General-purpose I2C controllers; the C6's second one is the LP I2C, which Wire1 cannot drive
+#if defined(SOC_HP_I2C_NUM)
+#define I2C_CONTROLLERS SOC_HP_I2C_NUM
+#elif defined(SOC_I2C_NUM)
+#define I2C_CONTROLLERS SOC_I2C_NUM
+#else
+#define I2C_CONTROLLERS 1
+#endif
+
+#if SENSOR_SPLIT_BUS && I2C_CONTROLLERS < 2
+#error "SENSOR_SPLIT_BUS needs a second I2C controller (Wire1)"
+#endif
 #define XSHUT_L   2
 #define XSHUT_R   3
 #define XSHUT_T   4
@@ -28,29 +64,108 @@
 #define ADDR_R    0x31
 #define ADDR_T    0x32
 
+// VL53L0X GPIO1 data-ready pins (-1 = not wired, poll instead)
+#define IRQ_L     -1
+#define IRQ_R     -1
+#define IRQ_T     -1
+
+// SD file handles: log + current/next/previous track + web upload/download
+#ifndef SD_MAX_FILES
+#define SD_MAX_FILES 8
+#endif
+
+// Full-rate ranging while a hand may be present; period at or below the budget = back-to-back
+// (budgets come from each sensor's SensorConfig, see kSensorConfig)
+#define RANGE_PERIOD_MS   20
+// Emit a partial frame if a sensor is this many ranging periods late
+#define FRAME_TIMEOUT_PERIODS 2
+
+// Duty-cycled sensing: slow idle scan until something enters the gesture band
+#ifndef SENSOR_DUTY_CYCLE
+#define SENSOR_DUTY_CYCLE 1
+#endif
+// Idle scan: all three sensors (keeps L/R/T ordering intact) at a long budget, low rate
+#define IDLE_SENSOR_MASK  0x07
+#define IDLE_PERIOD_MS    100
+#define IDLE_BUDGET_US    33000
+// Fall back to the idle scan after this long with nothing in the band; > MAX_EPISODE_MS
+#define IDLE_AFTER_MS     3000
+
+// Achieved-rate check of every sensor at boot; 0 skips it
+#ifndef SENSOR_SELF_TEST_MS
+#define SENSOR_SELF_TEST_MS 500
+#endif
+
+// 1 = act on swipes as soon as their direction is unambiguous instead of after the hand leaves
+#ifndef GESTURE_EARLY_DECISION
+#define GESTURE_EARLY_DECISION 0
+#endif
+
 #define SD_CS     9
 
+// SD SPI clock for mounting and the probe reads, and the clock used once the probe passes
+#ifndef SD_PROBE_HZ
+#define SD_PROBE_HZ 10000000
+#endif
+#ifndef SD_SPI_HZ
+#define SD_SPI_HZ   20000000
+#endif
+// Sectors read at both clocks to check the faster one
+#define SD_PROBE_SECTORS 8
+
+// Wait up to this long for a serial monitor at boot; 0 = start right away
+#ifndef BOOT_SERIAL_WAIT_MS
+#define BOOT_SERIAL_WAIT_MS 0
+#endif
+
 #define LED_G  1
 #define LED_B  13
 #define LED_R  12
 #define BUTTON_PIN 21
 
+// Binary logs get their own file; decode with tools/logdecode
+#if LOGGER_BINARY
+#define LOG_PATH "/system.bin"
+#else
+#define LOG_PATH "/system.log"
+#endif
+
+// How often loop() writes SD bus and playback counters to the log
+#ifndef STATS_LOG_INTERVAL_MS
+#define STATS_LOG_INTERVAL_MS 60000
+#endif
+
+// Where sensor traces go when capture is started from the serial console
+#ifndef TRACE_SINK
+#if LOGGER_BINARY
+#define TRACE_SINK TraceCapture::Sink::Log
+#else
+#define TRACE_SINK TraceCapture::Sink::Serial
+#endif
+#endif
+
+// How often loop() checks the serial console for commands
+#define CONSOLE_POLL_MS 50
+
 
-SemaphoreHandle_t g_sdMutex = nullptr;
 volatile bool     g_systemEnabled = true;
 
 Adafruit_VL53L0X L;
 Adafruit_VL53L0X R;
 Adafruit_VL53L0X T;
 
+// Ranging profile per sensor (L, R, T); high speed matches the 20 ms full-rate period
+const SensorArray::SensorConfig kSensorConfig[SensorArray::NUM_SENSORS] = {
+  SensorArray::highSpeedConfig(),
+  SensorArray::highSpeedConfig(),
+  SensorArray::highSpeedConfig()
+};
+
 GesturePreprocessor gp;
 
-const char* kTracks[] = {
-  "/Rick-Roll-Sound-Effect.wav",
-  "/afro-11-324020.wav",
-  "/memphis-trap-wav-349366.wav"
-};
-const size_t kNumTracks = sizeof(kTracks) / sizeof(kTracks[0]);
+// Frames from sensorTask (producer) to gestureTask (consumer)
+SpscRing<SensorArray::SensorFrame, 16> g_frameRing;
+TaskHandle_t g_gestureTaskHandle = nullptr;
 
 volatile uint32_t g_lastButtonPressMs = 0;
 
@@ -68,25 +183,23 @@ void IRAM_ATTR buttonISR() {
 
   g_systemEnabled = !g_systemEnabled;
 
-  if (g_systemEnabled) {
-    Speaker::pauseToggle();
-  } else {
-    Speaker::pauseToggle();
-  }
+  Speaker::pauseToggleFromISR();
 }
 
 /*
  * Initializes a VL53L0X Time-of-Flight sensor with a specific I2C address
  * Uses the XSHUT pin to power cycle the sensor before setting its new address.
  * This allows multiple sensors on the same I2C bus with unique addresses.
+ * The sensor starts from cfg's profile, then gets cfg's budget/VCSEL/limit overrides.
  */
-bool initSensor(Adafruit_VL53L0X &sensor, int xshutPin, uint8_t newAddr) {
+bool initSensor(Adafruit_VL53L0X &sensor, int xshutPin, uint8_t newAddr,
+                const SensorArray::SensorConfig &cfg, TwoWire &bus) {
   pinMode(xshutPin, OUTPUT);
   digitalWrite(xshutPin, LOW);
   delay(5);
   digitalWrite(xshutPin, HIGH);
   delay(5);
-  if (!sensor.begin(newAddr, false, &Wire)) {
+  if (!sensor.begin(newAddr, false, &bus, cfg.profile)) {
     Logger::logf(Logger::Level::Error,
                  "Failed to init VL53L0X at addr 0x%02X",
                  newAddr);
@@ -96,29 +209,145 @@ bool initSensor(Adafruit_VL53L0X &sensor, int xshutPin, uint8_t newAddr) {
     );
     return false;
   }
+  if (!SensorArray::configureSensor(sensor, cfg)) {
+    Logger::logf(Logger::Level::Warn,
+                 "VL53L0X at addr 0x%02X rejected part of its ranging config",
+                 newAddr);
+    LOGGER_DEBUG(
+      Serial.print("Ranging config partly rejected at addr 0x");
+      Serial.println(newAddr, HEX);
+    );
+  }
   return true;
 }
 
 /*
- * Reads distance measurement from a VL53L0X sensor
- * Returns the distance in millimeters, or 0xFFFF if the reading is invalid
- * (e.g., out of range or sensor error).
+ * Logs a recognized gesture together with the episode that produced it
+ * One compact record in binary log mode, one descriptive line in text mode.
+ */
+void logGesture(const GestureEpisode &ep, GestureDir dir) {
+  LogRecord::EpisodePayload p;
+  p.dirSeen       = (uint8_t)((uint8_t)dir | (ep.seenMask & 0x07) << 4);
+  p.sampleCount   = ep.sampleCount;
+  p.winnerChanges = ep.winnerChanges;
+  p.durationMs    = LogRecord::packMs(ep.durationUs());
+  for (int i = 0; i < 3; ++i) {
+    LogRecord::SensorSummary &s = p.s[i];
+    const bool seen  = ep.seen(i);
+    s.dMin           = seen ? LogRecord::packMm(ep.dMin[i]) : LogRecord::MM_UNSEEN;
+    s.dMax           = seen ? LogRecord::packMm(ep.dMax[i]) : LogRecord::MM_UNSEEN;
+    s.maxApproachVel = LogRecord::packVelocity(ep.maxApproachVel[i]);
+    s.firstSeenMs    = seen ? LogRecord::packMs(ep.firstSeenUs[i] - ep.tStartUs) : 0;
+  }
+  Logger::event(Logger::Level::Info, LogRecord::Event::Gesture, &p, sizeof(p));
+}
+
+/*
+ * High-priority FreeRTOS task that only does sensor acquisition
+ * Blocks on SensorArray::readFrame(), so the frame rate follows the sensors'
+ * continuous ranging period rather than serialized I2C round-trips. Each frame is
+ * pushed into g_frameRing and gestureTask is notified; nothing slow (filtering,
+ * logging, LEDs) runs here, so it cannot delay the next sample.
+ * It also drives the sensor duty cycle, since it owns the sensors' I2C traffic.
+ */
+void sensorTask(void* arg) {
+  for (;;) {
+    if (!g_systemEnabled) {
+      vTaskDelay(pdMS_TO_TICKS(100));
+      continue;
+    }
+
+    SensorArray::SensorFrame frame;
+    if (!SensorArray::readFrame(frame, FRAME_TIMEOUT_PERIODS * SensorArray::periodMs())) {
+      vTaskDelay(pdMS_TO_TICKS(100));
+      continue;
+    }
+
+    // Anything in the gesture band wakes full-rate ranging before the next frame
+    bool near = false;
+    for (uint8_t i = 0; i < SensorArray::NUM_SENSORS; ++i) {
+      if (GesturePreprocessor::inBand(frame.d[i])) near = true;
+    }
+    SensorArray::updateMode(frame, near);
+
+    g_frameRing.push(frame);  // full ring counts an overflow and drops the frame
+    if (g_gestureTaskHandle) xTaskNotifyGive(g_gestureTaskHandle);
+  }
+}
+
+const char* gestureName(GestureDir dir) {
+  switch (dir) {
+    case GestureDir::Left:  return "LEFT";
+    case GestureDir::Right: return "RIGHT";
+    case GestureDir::Up:    return "UP";
+    case GestureDir::Down:  return "DOWN";
+    case GestureDir::Tap:   return "TAP";
+    default:                return "NONE";
+  }
+}
+
+/*
+ * Triggers the music control action for a gesture
+ * tUs is when the deciding sample was taken, for the Speaker latency stats.
+ */
+void runGesture(GestureDir dir, uint32_t tUs) {
+  switch (dir) {
+    case GestureDir::Left:
+      LOGGER_DEBUG(Serial.println("LEFT -> prevTrack()"));
+      Speaker::prevTrack(tUs);
+      break;
+
+    case GestureDir::Right:
+      LOGGER_DEBUG(Serial.println("RIGHT -> nextTrack()"));
+      Speaker::nextTrack(tUs);
+      break;
+
+    case GestureDir::Up:
+      LOGGER_DEBUG(Serial.println("UP -> volumeUp()"));
+      Speaker::volumeUp(tUs);
+      break;
+
+    case GestureDir::Down:
+      LOGGER_DEBUG(Serial.println("DOWN -> volumeDown()"));
+      Speaker::volumeDown(tUs);
+      break;
+
+    case GestureDir::Tap:
+      LOGGER_DEBUG(Serial.println("TAP -> pauseToggle()"));
+      Speaker::pauseToggle(tUs);
+      break;
+
+    default:
+      LOGGER_DEBUG(Serial.println("NONE"));
+      break;
+  }
+}
+
+/*
+ * Reverses an action taken on an early decision that turned out wrong
+ * Swipes have an opposite gesture; a cancelled track change restarts the
+ * previous track rather than resuming it mid-way.
  */
-uint16_t readVL(Adafruit_VL53L0X &s) {
-  VL53L0X_RangingMeasurementData_t measure;
-  s.rangingTest(&measure, false);
-  if (measure.RangeStatus != 4) {
-    return measure.RangeMilliMeter;
+void undoGesture(GestureDir dir, uint32_t tUs) {
+  switch (dir) {
+    case GestureDir::Left:  runGesture(GestureDir::Right, tUs); break;
+    case GestureDir::Right: runGesture(GestureDir::Left,  tUs); break;
+    case GestureDir::Up:    runGesture(GestureDir::Down,  tUs); break;
+    case GestureDir::Down:  runGesture(GestureDir::Up,    tUs); break;
+    default: break;
   }
-  return 0xFFFF;
 }
 
 /*
- * FreeRTOS task that continuously reads sensor data and processes gestures
- * Runs at approximately 50 Hz to capture hand movements. When a gesture episode
- * is detected and classified, it triggers the corresponding music control action.
+ * FreeRTOS task that consumes sensor frames and processes gestures
+ * Drains g_frameRing through the preprocessor and classifier. When a gesture
+ * episode is detected and classified, it triggers the corresponding music control action.
+ * With early decisions on, swipes act on the preprocessor's provisional result and
+ * the final classification only confirms it or takes it back.
  */
 void gestureTask(void* arg) {
+  uint32_t lastOverflows = 0;
+
   for (;;) {
     if (!g_systemEnabled) {
       Logger::ledError();
@@ -126,17 +355,36 @@ void gestureTask(void* arg) {
       continue;
     }
 
-    uint32_t now = millis();
+    SensorArray::SensorFrame frame;
+    if (!g_frameRing.pop(frame)) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+      continue;
+    }
 
-    uint16_t dL = readVL(L);
-    uint16_t dR = readVL(R);
-    uint16_t dT = readVL(T);
+    uint32_t overflows = g_frameRing.overflowCount();
+    if (overflows != lastOverflows) {
+      LogRecord::OverflowPayload p;
+      p.dropped   = overflows - lastOverflows;
+      p.total     = overflows;
+      p.highWater = g_frameRing.highWater();
+      Logger::event(Logger::Level::Warn, LogRecord::Event::FrameOverflow, &p, sizeof(p));
+      LOGGER_DEBUG(
+        Serial.print("Sensor frame ring overflow, total=");
+        Serial.println(overflows);
+      );
+      lastOverflows = overflows;
+    }
 
-    GestureEvent ev = gp.update(dL, dR, dT, now);
+    TraceCapture::frame(frame.d, frame.tUs);
+    GestureEvent ev;
+    {
+      PROFILE_SCOPE(Profiler::Probe::GestureUpdate);
+      ev = gp.update(frame.d, frame.tUs);
+    }
     if (ev == GestureEvent::EpisodeReady) {
       const GestureEpisode &ep = gp.lastEpisode();
 
-      uint32_t dur = ep.tEndMs - ep.tStartMs;
+      uint32_t dur = ep.durationMs();
 
       auto swingOf = [&](int i)->uint16_t {
         if (ep.dMin[i] == 0xFFFF) return 0;
@@ -147,7 +395,11 @@ void gestureTask(void* arg) {
       uint16_t swingR = swingOf(1);
       uint16_t swingT = swingOf(2);
 
-      GestureDir dir = classifyEpisode(ep);
+      GestureDir dir;
+      {
+        PROFILE_SCOPE(Profiler::Probe::Classify);
+        dir = classifyEpisode(ep);
+      }
 
       LOGGER_DEBUG(
         Serial.print("EPISODE dur=");
@@ -166,64 +418,66 @@ void gestureTask(void* arg) {
         Logger::ledWarn();
       } else {
         Logger::ledBusy();
+        logGesture(ep, dir);
       }
 
-      switch (dir) {
-        case GestureDir::Left:
-          Logger::log(Logger::Level::Info, "Gesture recognized: LEFT");
-          LOGGER_DEBUG(Serial.println("LEFT -> prevTrack()"));
-          Speaker::prevTrack();
-          break;
-
-        case GestureDir::Right:
-          Logger::log(Logger::Level::Info, "Gesture recognized: RIGHT");
-          LOGGER_DEBUG(Serial.println("RIGHT -> nextTrack()"));
-          Speaker::nextTrack();
-          break;
-
-        case GestureDir::Up:
-          Logger::log(Logger::Level::Info, "Gesture recognized: UP");
-          LOGGER_DEBUG(Serial.println("UP -> volumeUp()"));
-          Speaker::volumeUp();
-          break;
-
-        case GestureDir::Down:
-          Logger::log(Logger::Level::Info, "Gesture recognized: DOWN");
-          LOGGER_DEBUG(Serial.println("DOWN -> volumeDown()"));
-          Speaker::volumeDown();
-          break;
-
-        case GestureDir::Tap:
-          Logger::log(Logger::Level::Info, "Gesture recognized: TAP");
-          LOGGER_DEBUG(Serial.println("TAP -> pauseToggle()"));
-          Speaker::pauseToggle();
-          break;
-
-        default:
-          LOGGER_DEBUG(Serial.println("NONE"));
-          break;
+      const ProvisionalDecision &pv = gp.provisional();
+      if (pv.dir != GestureDir::None && !pv.cancelled) {
+        if (pv.dir == dir) {
+          LOGGER_DEBUG(Serial.println("confirms early decision"));
+          continue;
+        }
+        // The early action was wrong: take it back before doing the right one
+        undoGesture(pv.dir, ep.tEndUs);
+      }
+      runGesture(dir, ep.tEndUs);
+    } else if (ev == GestureEvent::Provisional) {
+      const ProvisionalDecision &pv = gp.provisional();
+      Logger::logf(Logger::Level::Info, "Early gesture %s (confidence %u)",
+                   gestureName(pv.dir), pv.confidence);
+      Logger::ledBusy();
+      LOGGER_DEBUG(Serial.print("EARLY -> "));
+      runGesture(pv.dir, pv.tUs);
+    } else if (ev == GestureEvent::Cancelled) {
+      const ProvisionalDecision &pv = gp.provisional();
+      Logger::logf(Logger::Level::Warn, "Early gesture %s cancelled", gestureName(pv.dir));
+      Logger::ledWarn();
+      uint32_t nowUs = frame.tUs[0];
+      for (uint8_t i = 1; i < SensorArray::NUM_SENSORS; ++i) {
+        if ((int32_t)(frame.tUs[i] - nowUs) > 0) nowUs = frame.tUs[i];
       }
+      undoGesture(pv.dir, nowUs);
     }
-
-    vTaskDelay(pdMS_TO_TICKS(20));
   }
 }
 
 /*
- * Arduino setup function - initializes all hardware and starts tasks
- * Sets up sensors, SD card, audio output, WiFi file manager, and gesture recognition.
+ * Logs when a boot stage finished and how long it took (ms since reset)
  */
-void setup() {
-  Serial.begin(115200);
-  delay(1000);
-
-  if (!g_sdMutex) {
-    g_sdMutex = xSemaphoreCreateMutex();
-  }
+void logBootStage(const char* stage, uint32_t startMs) {
+  const uint32_t now = millis();
+  Logger::logf(Logger::Level::Info, "Boot: %s done at %lu ms (%lu ms)",
+               stage, (unsigned long)now, (unsigned long)(now - startMs));
+  LOGGER_DEBUG(Serial.printf("Boot: %s done at %lu ms (%lu ms)\n",
+                             stage, (unsigned long)now, (unsigned long)(now - startMs)));
+}
 
-  Logger::init(g_sdMutex, "/system.log", LED_R, LED_G, LED_B);
+/*
+ * One-shot FreeRTOS task that brings up the sensors while setup() starts audio
+ * Gives each VL53L0X its address, starts continuous ranging and runs the
+ * self-test, then starts gestureTask and sensorTask and deletes itself.
+ * Gestures work from the moment it logs its boot stage.
+ */
+void sensorBootTask(void* arg) {
+  const uint32_t t0 = millis();
 
-  Wire.begin(SDA_PIN, SCL_PIN);
+  Wire.begin(SDA_PIN, SCL_PIN, I2C_CLOCK_HZ);
+#if SENSOR_SPLIT_BUS
+  Wire1.begin(SDA2_PIN, SCL2_PIN, I2C_CLOCK_HZ);
+  TwoWire &busT = Wire1;
+#else
+  TwoWire &busT = Wire;
+#endif
 
   pinMode(XSHUT_L, OUTPUT);
   pinMode(XSHUT_R, OUTPUT);
@@ -233,46 +487,313 @@ void setup() {
   digitalWrite(XSHUT_T, LOW);
   delay(10);
 
-  initSensor(L, XSHUT_L, ADDR_L);
-  initSensor(R, XSHUT_R, ADDR_R);
-  initSensor(T, XSHUT_T, ADDR_T);
+  bool okL = initSensor(L, XSHUT_L, ADDR_L, kSensorConfig[0], Wire);
+  bool okR = initSensor(R, XSHUT_R, ADDR_R, kSensorConfig[1], Wire);
+  bool okT = initSensor(T, XSHUT_T, ADDR_T, kSensorConfig[2], busT);
+
+  // Sensors that failed to init are left out of continuous ranging
+  Adafruit_VL53L0X* const sensors[SensorArray::NUM_SENSORS] = {
+    okL ? &L : nullptr,
+    okR ? &R : nullptr,
+    okT ? &T : nullptr
+  };
+  const int8_t  irqPins[SensorArray::NUM_SENSORS] = { IRQ_L, IRQ_R, IRQ_T };
+  const uint8_t buses[SensorArray::NUM_SENSORS]   = { 0, 0, SENSOR_SPLIT_BUS ? 1 : 0 };
+  if (!SensorArray::begin(sensors, irqPins, RANGE_PERIOD_MS, buses)) {
+    Logger::log(Logger::Level::Error, "No VL53L0X sensor started continuous ranging");
+    LOGGER_DEBUG(Serial.println("No VL53L0X sensor started continuous ranging"));
+  }
+
+  SensorArray::ModeConfig active;
+  active.sensorMask = 0x07;
+  active.periodMs   = RANGE_PERIOD_MS;
+  active.budgetUs   = 0;  // each sensor's own SensorConfig budget
+
+  SensorArray::ModeConfig idle;
+  idle.sensorMask = IDLE_SENSOR_MASK;
+  idle.periodMs   = IDLE_PERIOD_MS;
+  idle.budgetUs   = IDLE_BUDGET_US;
+
+  SensorArray::configureModes(active, idle, SENSOR_DUTY_CYCLE ? IDLE_AFTER_MS : 0);
+  logBootStage("sensor init", t0);
+
+#if SENSOR_SELF_TEST_MS
+  const uint32_t tTest = millis();
+  SensorArray::SelfTestResult selfTest[SensorArray::NUM_SENSORS];
+  if (!SensorArray::selfTest(SENSOR_SELF_TEST_MS, selfTest)) {
+    Logger::log(Logger::Level::Warn, "VL53L0X self-test: a sensor is below its expected rate");
+    LOGGER_DEBUG(Serial.println("VL53L0X self-test: a sensor is below its expected rate"));
+  }
+  logBootStage("sensor self-test", tTest);
+#endif
+
+  gp.setStreaming(GESTURE_EARLY_DECISION);
+
+  // Priorities, stacks and cores: see TaskConfig.hpp
+  xTaskCreatePinnedToCore(
+    gestureTask,
+    "gestureTask",
+    GESTURE_TASK_STACK,
+    nullptr,
+    GESTURE_TASK_PRIO,
+    &g_gestureTaskHandle,
+    GESTURE_TASK_CORE
+  );
+
+  xTaskCreatePinnedToCore(
+    sensorTask,
+    "sensorTask",
+    SENSOR_TASK_STACK,
+    nullptr,
+    SENSOR_TASK_PRIO,
+    nullptr,
+    SENSOR_TASK_CORE
+  );
 
   LOGGER_DEBUG(Serial.println("VL53L0X triangle + gesture episode detector ready"));
+  logBootStage("gestures", t0);
+  vTaskDelete(nullptr);
+}
 
+/*
+ * Mounts the SD card, then raises the SPI clock from SD_PROBE_HZ to SD_SPI_HZ
+ * The first SD_PROBE_SECTORS sectors are read at both clocks; the card stays
+ * at the probe clock if the faster remount fails or reads back differently.
+ * hz is the clock in use.
+ */
+bool mountSd(uint32_t &hz) {
   SPI.begin(18, 19, 23, SD_CS);
-  if (!SD.begin(SD_CS, SPI, 10000000)) {
+  // The player keeps current/next/previous tracks open next to the log file
+  hz = SD_PROBE_HZ;
+  if (!SD.begin(SD_CS, SPI, SD_PROBE_HZ, "/sd", SD_MAX_FILES)) return false;
+
+#if SD_SPI_HZ > SD_PROBE_HZ
+  static uint8_t sector[512];
+  auto checksum = [](uint32_t &sum) -> bool {
+    sum = 2166136261u;
+    for (uint32_t i = 0; i < SD_PROBE_SECTORS; ++i) {
+      if (!SD.readRAW(sector, i)) return false;
+      for (size_t k = 0; k < sizeof(sector); ++k) {
+        sum ^= sector[k];
+        sum *= 16777619u;
+      }
+    }
+    return true;
+  };
+
+  uint32_t slow = 0, fast = 0;
+  if (!checksum(slow)) return true;  // nothing to compare against: keep the probe clock
+  SD.end();
+  if (SD.begin(SD_CS, SPI, SD_SPI_HZ, "/sd", SD_MAX_FILES) && checksum(fast) && fast == slow) {
+    hz = SD_SPI_HZ;
+    return true;
+  }
+  SD.end();
+  Logger::logf(Logger::Level::Warn, "SD: %lu Hz failed the probe, staying at %lu Hz",
+               (unsigned long)SD_SPI_HZ, (unsigned long)SD_PROBE_HZ);
+  LOGGER_DEBUG(Serial.println("SD: fast clock failed the probe"));
+  return SD.begin(SD_CS, SPI, SD_PROBE_HZ, "/sd", SD_MAX_FILES);
+#else
+  return true;
+#endif
+}
+
+/*
+ * Arduino setup function - brings the system up in stages
+ *   1. SD mount (with the clock probe), then I2S and the player: the first
+ *      track starts prefetching as soon as the card is up.
+ *   2. Sensor bring-up and self-test run alongside in sensorBootTask, which
+ *      starts the gesture pipeline when it is done.
+ *   3. Deferred: log flushing, a playlist rebuild if the index needs one, the
+ *      web file index and WiFi.
+ * Each stage logs when it finished, so boot-time regressions show in the log.
+ */
+void setup() {
+  const uint32_t t0 = millis();
+  Serial.begin(115200);
+#if BOOT_SERIAL_WAIT_MS
+  while (!Serial && millis() - t0 < BOOT_SERIAL_WAIT_MS) delay(10);
+#endif
+
+  if (!SdBus::begin()) {
+    LOGGER_DEBUG(Serial.println("SdBus mutex creation failed"));
+    while (true) vTaskDelay(portMAX_DELAY);
+  }
+
+  // Log lines wait in the RAM ring until the deferred stage starts flushing
+  Logger::init(LOG_PATH, LED_R, LED_G, LED_B, false);
+
+  xTaskCreatePinnedToCore(
+    sensorBootTask,
+    "sensorBoot",
+    SENSOR_BOOT_TASK_STACK,
+    nullptr,
+    SENSOR_BOOT_TASK_PRIO,
+    nullptr,
+    SENSOR_BOOT_TASK_CORE
+  );
+
+  // Setup button interrupt with highest priority
+  pinMode(BUTTON_PIN, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, FALLING);
+
+  uint32_t t = millis();
+  uint32_t sdHz = 0;
+  if (!mountSd(sdHz)) {
     Logger::log(Logger::Level::Error, "SD init failed");
     LOGGER_DEBUG(Serial.println("SD init failed"));
     while (true) vTaskDelay(portMAX_DELAY);
   }
+  Logger::logf(Logger::Level::Info, "SD: SPI clock %lu Hz", (unsigned long)sdHz);
+  logBootStage("sd mount", t);
 
+  t = millis();
   if (!Speaker::initMax98357A(8, 22, 15, 44100)) {
     Logger::log(Logger::Level::Error, "I2S init failed");
     LOGGER_DEBUG(Serial.println("I2S init failed"));
     while (true) vTaskDelay(portMAX_DELAY);
   }
 
-  Speaker::setPlaylist(kTracks, kNumTracks);
+  // Tracks come from the SD playlist index; uploads become playable without a reflash.
+  // A good index is one read; a rebuild waits for the deferred stage.
+  if (!Playlist::begin(true)) {
+    Logger::log(Logger::Level::Error, "Playlist init failed");
+    LOGGER_DEBUG(Serial.println("Playlist init failed"));
+  }
   Speaker::startPlayer();  // spawns audio FreeRTOS task inside Speaker
+  logBootStage("audio", t);
 
-  // Setup button interrupt with highest priority
-  pinMode(BUTTON_PIN, INPUT_PULLUP);
-  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, FALLING);
+  // Nothing below is needed for the first track or the first gesture
+  t = millis();
+  Logger::startFlushing();
+  Playlist::finishRebuild();
 
-  xTaskCreate(
-    gestureTask,
-    "gestureTask",
-    4096,
-    nullptr,
-    1,
-    nullptr
-  );
+  // Directory index for the web file list
+  FileIndex::build();
+
+  // File manager runs in its own low-priority task; nothing to poll from loop()
+  if (!WebFileManager::begin()) {
+    LOGGER_DEBUG(Serial.println("WiFi file manager failed to start"));
+  }
+  logBootStage("deferred", t);
+  logBootStage("setup", t0);
+}
+
+/*
+ * Writes SD bus arbitration, sensor duty-cycle and playback counters to the log
+ * Lets a log review confirm that web/log SD traffic never caused an underrun.
+ */
+void logStats() {
+  char line[256];
+  for (uint8_t c = 0; c < SdBus::CLIENT_COUNT; ++c) {
+    SdBus::formatStats(line, sizeof(line), (SdBus::Client)c);
+    Logger::log(Logger::Level::Info, line);
+  }
+
+  SensorArray::formatPowerStats(line, sizeof(line));
+  Logger::log(Logger::Level::Info, line);
+
+  Speaker::Stats st = Speaker::stats();
+  Logger::logf(Logger::Level::Info, "Speaker: played=%lu underruns=%lu readErrors=%lu "
+               "sdKB=%lu refill jitter avg/max=%lu/%lu us resampled=%lu",
+               (unsigned long)st.blocksPlayed, (unsigned long)st.underruns,
+               (unsigned long)st.readErrors, (unsigned long)(st.bytesRead / 1024),
+               (unsigned long)(st.refills ? st.refillJitterTotalUs / st.refills : 0),
+               (unsigned long)st.refillJitterMaxUs, (unsigned long)st.blocksResampled);
+}
+
+/*
+ * Prints profiler probes and per-task stack/CPU figures to the serial port
+ * Written directly, not through the log, so it works without serial debug.
+ */
+void dumpStats() {
+  static Profiler::TaskInfo tasks[PROFILER_MAX_TASKS];
+  char line[192];
+
+  if (Profiler::enabled()) {
+    for (uint8_t p = 0; p < Profiler::PROBE_COUNT; ++p) {
+      Profiler::formatProbe(line, sizeof(line), (Profiler::Probe)p);
+      Serial.println(line);
+    }
+  } else {
+    Serial.println("Profiler probes disabled (build with PROFILER_ENABLE=1)");
+  }
+
+  size_t n = Profiler::taskSnapshot(tasks, PROFILER_MAX_TASKS);
+  for (size_t i = 0; i < n; ++i) {
+    Profiler::formatTask(line, sizeof(line), tasks[i]);
+    Serial.println(line);
+  }
+  Serial.printf("heap free=%lu min=%lu\n",
+                (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap());
+}
+
+/*
+ * Handles single-character commands from the serial console
+ *   c        start/stop sensor trace capture
+ *   l r u d  label the next gesture Left/Right/Up/Down (while capturing)
+ *   t n      label the next gesture Tap / no gesture
+ *   s        print profiler probes and task stats (same data as /stats)
+ *   p        rescan the track directory into a fresh playlist index
+ */
+void handleConsole() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    switch (c) {
+      case 'c':
+        if (TraceCapture::active()) TraceCapture::stop();
+        else TraceCapture::start(TRACE_SINK);
+        break;
+      case 'l': TraceCapture::label(GestureDir::Left);  break;
+      case 'r': TraceCapture::label(GestureDir::Right); break;
+      case 'u': TraceCapture::label(GestureDir::Up);    break;
+      case 'd': TraceCapture::label(GestureDir::Down);  break;
+      case 't': TraceCapture::label(GestureDir::Tap);   break;
+      case 'n': TraceCapture::label(GestureDir::None);  break;
+      case 's': dumpStats(); break;
+      case 'p': Playlist::rebuild(); break;
+      default: break;
+    }
+  }
+}
+
+/*
+ * Logs the command-to-audible latencies Speaker recorded since the last call
+ * The audio task only updates counters, so the formatting and the log ring
+ * stay on this low-priority task.
+ */
+void logCommandLatency() {
+  static uint32_t reported[Speaker::CMD_COUNT] = {};
+  const Speaker::Stats st = Speaker::stats();
+  for (uint8_t c = 0; c < Speaker::CMD_COUNT; ++c) {
+    const Speaker::CmdLatency &l = st.latency[c];
+    if (l.count == reported[c]) continue;
+    const uint32_t missed = l.count - reported[c] - 1;
+    reported[c] = l.count;
+    if (missed) {
+      Logger::logf(Logger::Level::Info, "Speaker: %s audible after %lu us (%lu earlier not logged)",
+                   Speaker::cmdName((Speaker::Cmd)c), (unsigned long)l.lastUs,
+                   (unsigned long)missed);
+    } else {
+      Logger::logf(Logger::Level::Info, "Speaker: %s audible after %lu us",
+                   Speaker::cmdName((Speaker::Cmd)c), (unsigned long)l.lastUs);
+    }
+  }
 }
 
 /*
  * Arduino main loop - runs indefinitely
- * All work is done in FreeRTOS tasks, so this just sleeps forever.
+ * All work is done in FreeRTOS tasks; this only serves the serial console and
+ * logs command latencies and counters.
  */
 void loop() {
-  vTaskDelay(portMAX_DELAY);
+  static uint32_t lastStatsMs = 0;
+
+  handleConsole();
+  logCommandLatency();
+  if (millis() - lastStatsMs >= STATS_LOG_INTERVAL_MS) {
+    lastStatsMs = millis();
+    logStats();
+  }
+  vTaskDelay(pdMS_TO_TICKS(CONSOLE_POLL_MS));
 }
@@ -0,0 +1,300 @@
+/*
+ * Host-side replay and benchmark harness for captured sensor traces
+ *
+ * Feeds LogRecord::Frame records (captured with TraceCapture, either pulled off
+ * the SD card as /system.bin or saved from the serial port) through the real
+ * GesturePreprocessor and classifier headers from src/main, bit-for-bit as the
+ * device does. TraceLabel records say which gesture was performed next; the
+ * tool scores each labelled episode and prints a confusion table, then times
+ * the pipeline so preprocessing and classifier changes can be compared on the
+ * same input. Anything else in the file (other records, serial text) is skipped.
+ *
+ * Build:  g++ -std=c++17 -O2 -I tools/gesturereplay/shim -I src/main \
+ *             tools/gesturereplay/gesturereplay.cpp -o gesturereplay
+ * Usage:  gesturereplay [--backend rules|tree] [--stream] [--repeat N]
+ *                       [--min-accuracy PCT] [--episodes] trace.bin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define REPLAY_HAVE_TSC 1
+#else
+#define REPLAY_HAVE_TSC 0
+#endif
+
+#include <GestureClassifier.hpp>
+
+static const int NUM_DIRS = 6;   // GestureDir::None .. GestureDir::Tap
+static const int NO_LABEL = -1;
+
+struct TraceItem {
+  bool                     isLabel;
+  uint8_t                  label;
+  LogRecord::FramePayload  frame;
+};
+
+struct ReplayResult {
+  // confusion[label][predicted]; predicted == NUM_DIRS means no episode at all
+  uint32_t confusion[NUM_DIRS][NUM_DIRS + 1] = {};
+  uint32_t unlabelled[NUM_DIRS] = {};
+  uint32_t episodes    = 0;
+  uint32_t rejected    = 0;
+  uint32_t provisional = 0;
+  uint32_t cancelled   = 0;
+  uint32_t confirmed   = 0;    // provisional decision matched the final class
+  uint64_t earlyLeadUs = 0;    // sum of (episode end - provisional time) over confirmed
+  std::vector<uint32_t> updateTicks;
+};
+
+static ReplayResult* g_current = nullptr;
+
+static void onEvent(LogRecord::Event ev, const void* /*payload*/, size_t /*len*/) {
+  if (g_current && ev == LogRecord::Event::EpisodeRejected) ++g_current->rejected;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: gesturereplay [--backend rules|tree] [--stream] [--repeat N]\n"
+          "                     [--min-accuracy PCT] [--episodes] <trace.bin>\n");
+}
+
+static inline uint64_t ticks() {
+#if REPLAY_HAVE_TSC
+  return __rdtsc();
+#else
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static const char* TICK_UNIT = REPLAY_HAVE_TSC ? "cycles" : "ns";
+
+/*
+ * Pulls Frame and TraceLabel records out of a log or serial capture
+ * Resyncs byte-by-byte on the record sync byte, like logdecode.
+ */
+static size_t parseTrace(const std::vector<uint8_t>& data, std::vector<TraceItem>& out) {
+  size_t pos = 0, skipped = 0;
+  while (pos + sizeof(LogRecord::Header) <= data.size()) {
+    LogRecord::Header h;
+    memcpy(&h, &data[pos], sizeof(h));
+    if (h.sync != LogRecord::SYNC || pos + sizeof(h) + h.len > data.size()) {
+      ++pos;
+      ++skipped;
+      continue;
+    }
+
+    const uint8_t* payload = &data[pos + sizeof(h)];
+    const LogRecord::Event ev = (LogRecord::Event)h.event;
+    TraceItem item;
+    memset(&item, 0, sizeof(item));
+
+    if (ev == LogRecord::Event::Frame && h.len == sizeof(LogRecord::FramePayload)) {
+      memcpy(&item.frame, payload, sizeof(item.frame));
+      out.push_back(item);
+    } else if (ev == LogRecord::Event::TraceLabel && h.len == 1 && payload[0] < NUM_DIRS) {
+      item.isLabel = true;
+      item.label   = payload[0];
+      out.push_back(item);
+    }
+
+    pos += sizeof(h) + h.len;
+  }
+  return skipped + (data.size() - pos);
+}
+
+/*
+ * One pass over the trace with a fresh preprocessor
+ */
+static void replay(const std::vector<TraceItem>& trace, bool streaming, bool timed,
+                   bool printEpisodes, ReplayResult& res) {
+  GesturePreprocessor gp;
+  gp.setStreaming(streaming);
+
+  g_current = &res;
+  int      pending = NO_LABEL;
+  uint32_t frameNo = 0;
+
+  for (const TraceItem& item : trace) {
+    if (item.isLabel) {
+      // A label nobody consumed: that gesture produced no episode
+      if (pending != NO_LABEL) ++res.confusion[pending][NUM_DIRS];
+      pending = item.label;
+      continue;
+    }
+
+    const uint64_t t0 = timed ? ticks() : 0;
+    GestureEvent ev  = gp.update(item.frame.d, item.frame.tUs);
+    GestureDir   dir = GestureDir::None;
+    if (ev == GestureEvent::EpisodeReady) dir = classifyEpisode(gp.lastEpisode());
+    if (timed) res.updateTicks.push_back((uint32_t)(ticks() - t0));
+    ++frameNo;
+
+    if (ev == GestureEvent::Provisional) {
+      ++res.provisional;
+    } else if (ev == GestureEvent::Cancelled) {
+      ++res.cancelled;
+    } else if (ev == GestureEvent::EpisodeReady) {
+      ++res.episodes;
+
+      const ProvisionalDecision& pv = gp.provisional();
+      if (pv.dir != GestureDir::None && !pv.cancelled && pv.dir == dir) {
+        ++res.confirmed;
+        res.earlyLeadUs += gp.lastEpisode().tEndUs - pv.tUs;
+      }
+
+      if (printEpisodes) {
+        printf("frame %6u  episode %3u  %-5s  label %s\n", (unsigned)frameNo,
+               (unsigned)res.episodes, LogRecord::dirName((uint8_t)dir),
+               pending == NO_LABEL ? "-" : LogRecord::dirName((uint8_t)pending));
+      }
+
+      if (pending != NO_LABEL) {
+        ++res.confusion[pending][(int)dir];
+        pending = NO_LABEL;
+      } else {
+        ++res.unlabelled[(int)dir];
+      }
+    }
+  }
+  if (pending != NO_LABEL) ++res.confusion[pending][NUM_DIRS];
+  g_current = nullptr;
+}
+
+static void printConfusion(const ReplayResult& res, uint32_t& labelled, uint32_t& correct) {
+  labelled = 0;
+  correct  = 0;
+
+  printf("\nlabel \\ got");
+  for (int p = 0; p < NUM_DIRS; ++p) printf(" %6s", LogRecord::dirName((uint8_t)p));
+  printf(" %6s  recall\n", "miss");
+
+  for (int l = 0; l < NUM_DIRS; ++l) {
+    uint32_t row = 0;
+    for (int p = 0; p <= NUM_DIRS; ++p) row += res.confusion[l][p];
+    if (!row) continue;
+
+    // A deliberate non-gesture is right if it produced no episode or None
+    uint32_t ok = res.confusion[l][l] + (l == (int)GestureDir::None ? res.confusion[l][NUM_DIRS] : 0);
+    labelled += row;
+    correct  += ok;
+
+    printf("%-11s", LogRecord::dirName((uint8_t)l));
+    for (int p = 0; p <= NUM_DIRS; ++p) printf(" %6u", (unsigned)res.confusion[l][p]);
+    printf("  %5.1f%%\n", 100.0 * ok / row);
+  }
+
+  uint32_t unl = 0;
+  for (int p = 0; p < NUM_DIRS; ++p) unl += res.unlabelled[p];
+  if (unl) {
+    printf("%-11s", "(unlabelled)");
+    for (int p = 0; p < NUM_DIRS; ++p) printf(" %6u", (unsigned)res.unlabelled[p]);
+    printf("\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  const char* path          = nullptr;
+  bool        streaming     = false;
+  bool        printEpisodes = false;
+  long        repeat        = 20;
+  double      minAccuracy   = -1.0;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+      const char* b = argv[++i];
+      if (strcmp(b, "rules") == 0)     setClassifierBackend(ClassifierBackend::Rules);
+      else if (strcmp(b, "tree") == 0) setClassifierBackend(ClassifierBackend::Tree);
+      else { usage(); return 2; }
+    } else if (strcmp(argv[i], "--stream") == 0) {
+      streaming = true;
+    } else if (strcmp(argv[i], "--episodes") == 0) {
+      printEpisodes = true;
+    } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      repeat = strtol(argv[++i], nullptr, 10);
+      if (repeat < 1) { usage(); return 2; }
+    } else if (strcmp(argv[i], "--min-accuracy") == 0 && i + 1 < argc) {
+      minAccuracy = strtod(argv[++i], nullptr);
+    } else if (!path) {
+      path = argv[i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (!path) { usage(); return 2; }
+
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t  n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    data.insert(data.end(), chunk, chunk + n);
+  }
+  fclose(f);
+
+  std::vector<TraceItem> trace;
+  const size_t skipped = parseTrace(data, trace);
+  size_t frames = 0;
+  for (const TraceItem& item : trace) frames += item.isLabel ? 0 : 1;
+  fprintf(stderr, "%zu frames, %zu labels, %zu bytes skipped\n",
+          frames, trace.size() - frames, skipped);
+  if (!frames) return 1;
+
+  Logger::eventHookRef() = onEvent;
+
+  // Scored pass; also collects per-update timings
+  ReplayResult res;
+  res.updateTicks.reserve(frames);
+  replay(trace, streaming, true, printEpisodes, res);
+
+  printf("backend %s, streaming %s: %u episodes, %u rejected\n",
+         classifierBackend() == ClassifierBackend::Tree ? "tree" : "rules",
+         streaming ? "on" : "off", (unsigned)res.episodes, (unsigned)res.rejected);
+  if (streaming) {
+    printf("early decisions: %u made, %u cancelled, %u confirmed, mean lead %.1f ms\n",
+           (unsigned)res.provisional, (unsigned)res.cancelled, (unsigned)res.confirmed,
+           res.confirmed ? res.earlyLeadUs / 1000.0 / res.confirmed : 0.0);
+  }
+
+  uint32_t labelled = 0, correct = 0;
+  printConfusion(res, labelled, correct);
+  const double accuracy = labelled ? 100.0 * correct / labelled : 0.0;
+  if (labelled) printf("accuracy %.1f%% (%u/%u labelled gestures)\n", accuracy,
+                       (unsigned)correct, (unsigned)labelled);
+
+  // Throughput: untimed passes over the whole trace
+  auto w0 = std::chrono::steady_clock::now();
+  for (long r = 0; r < repeat; ++r) {
+    ReplayResult scratch;
+    replay(trace, streaming, false, false, scratch);
+  }
+  const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - w0).count();
+
+  std::vector<uint32_t> t = res.updateTicks;
+  std::sort(t.begin(), t.end());
+  uint64_t sum = 0;
+  for (uint32_t v : t) sum += v;
+  printf("\nupdate(): mean %.0f  p50 %u  p99 %u  max %u %s\n",
+         (double)sum / t.size(), (unsigned)t[t.size() / 2],
+         (unsigned)t[(t.size() * 99) / 100], (unsigned)t.back(), TICK_UNIT);
+  printf("throughput: %.2f Mframes/s over %ld passes\n",
+         secs > 0 ? frames * (double)repeat / secs / 1e6 : 0.0, repeat);
+
+  if (minAccuracy >= 0 && accuracy < minAccuracy) {
+    fprintf(stderr, "accuracy %.1f%% below --min-accuracy %.1f%%\n", accuracy, minAccuracy);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,11 @@
+/*
+ * Host stand-in for the Arduino core, just enough for the gesture pipeline
+ * headers (GesturePreprocessor, GestureClassifier, GestureTree) to compile.
+ */
+
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
@@ -0,0 +1,43 @@
+/*
+ * Host stand-in for src/main/Logger.hpp
+ *
+ * LED calls and text logging are no-ops and LOGGER_DEBUG output is compiled
+ * out. Structured events are handed to an optional hook so the replay tool can
+ * see what the preprocessor would have logged (e.g. rejected episodes).
+ */
+
+#pragma once
+#include <Arduino.h>
+#include <LogRecord.hpp>
+
+#define LOGGER_DEBUG(code) do { } while (0)
+
+namespace Logger {
+
+  enum class Level : uint8_t {
+    Info  = 0,
+    Warn  = 1,
+    Error = 2
+  };
+
+  typedef void (*EventHook)(LogRecord::Event ev, const void* payload, size_t len);
+
+  inline EventHook& eventHookRef() {
+    static EventHook h = nullptr;
+    return h;
+  }
+
+  inline void ledIdle()  {}
+  inline void ledBusy()  {}
+  inline void ledWarn()  {}
+  inline void ledWifi()  {}
+  inline void ledError() {}
+
+  inline void log(Level, const char*) {}
+  inline void logf(Level, const char*, ...) {}
+
+  inline void event(Level, LogRecord::Event ev, const void* payload, size_t len) {
+    if (eventHookRef()) eventHookRef()(ev, payload, len);
+  }
+
+} // namespace Logger
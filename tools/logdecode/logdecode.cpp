@@ -0,0 +1,131 @@
+/*
+ * Host-side decoder for binary Logger files (LOGGER_BINARY=1)
+ *
+ * Reads /system.bin copied off the SD card and prints every record either as the
+ * same "[t ms][LEVEL] text" lines the device writes in text mode, or as CSV with
+ * one column per gesture episode field. Uses the record layout and formatter from
+ * src/main/LogRecord.hpp, so the two can never drift apart.
+ *
+ * Build:  g++ -std=c++17 -O2 -I src/main tools/logdecode/logdecode.cpp -o logdecode
+ * Usage:  logdecode [--csv] system.bin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <LogRecord.hpp>
+
+static void usage() {
+  fprintf(stderr, "usage: logdecode [--csv] <system.bin>\n");
+}
+
+static void printCsvHeader() {
+  printf("t_ms,level,event,dir,dur_ms,samples,winner_changes,seen_mask,"
+         "dmin_l,dmin_r,dmin_t,dmax_l,dmax_r,dmax_t,"
+         "vmax_l,vmax_r,vmax_t,first_l_ms,first_r_ms,first_t_ms,text\n");
+}
+
+// CSV-quotes text, doubling embedded quotes
+static void printCsvText(const char* text) {
+  putchar('"');
+  for (const char* c = text; *c; ++c) {
+    if (*c == '"') putchar('"');
+    putchar(*c);
+  }
+  putchar('"');
+}
+
+static void printCsvRow(const LogRecord::Header& h, const uint8_t* payload, const char* text) {
+  printf("%lu,%s,%s,", (unsigned long)h.tMs,
+         LogRecord::levelName(h.level), LogRecord::eventName(h.event));
+
+  if ((LogRecord::Event)h.event == LogRecord::Event::Gesture &&
+      h.len == sizeof(LogRecord::EpisodePayload)) {
+    LogRecord::EpisodePayload p;
+    memcpy(&p, payload, sizeof(p));
+    printf("%s,%u,%u,%u,%u,",
+           LogRecord::dirName(LogRecord::episodeDir(p)), (unsigned)p.durationMs,
+           (unsigned)p.sampleCount, (unsigned)p.winnerChanges,
+           (unsigned)LogRecord::episodeSeen(p));
+    // Unseen sensors leave their distance columns empty
+    for (int i = 0; i < 3; ++i) {
+      if (p.s[i].dMin != LogRecord::MM_UNSEEN) printf("%u", (unsigned)p.s[i].dMin);
+      putchar(',');
+    }
+    for (int i = 0; i < 3; ++i) {
+      if (p.s[i].dMin != LogRecord::MM_UNSEEN) printf("%u", (unsigned)p.s[i].dMax);
+      putchar(',');
+    }
+    for (int i = 0; i < 3; ++i) {
+      printf("%u,", (unsigned)(p.s[i].maxApproachVel * LogRecord::VEL_UNIT_MM_S));
+    }
+    for (int i = 0; i < 3; ++i) printf("%u,", (unsigned)p.s[i].firstSeenMs);
+  } else {
+    printf(",,,,,,,,,,,,,,,,,");
+  }
+
+  printCsvText(text);
+  putchar('\n');
+}
+
+int main(int argc, char** argv) {
+  bool        csv  = false;
+  const char* path = nullptr;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--csv") == 0) csv = true;
+    else if (!path) path = argv[i];
+    else { usage(); return 2; }
+  }
+  if (!path) { usage(); return 2; }
+
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t  n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    data.insert(data.end(), chunk, chunk + n);
+  }
+  fclose(f);
+
+  if (csv) printCsvHeader();
+
+  size_t pos = 0, records = 0, skipped = 0;
+  char   text[512];
+
+  while (pos + sizeof(LogRecord::Header) <= data.size()) {
+    LogRecord::Header h;
+    memcpy(&h, &data[pos], sizeof(h));
+
+    // Resync byte-by-byte after corruption or a torn write
+    if (h.sync != LogRecord::SYNC ||
+        pos + sizeof(h) + h.len > data.size()) {
+      ++pos;
+      ++skipped;
+      continue;
+    }
+
+    const uint8_t* payload = &data[pos + sizeof(h)];
+    LogRecord::formatBody(text, sizeof(text), h.event, payload, h.len);
+
+    if (csv) {
+      printCsvRow(h, payload, text);
+    } else {
+      printf("[%lu ms][%s] %s\n", (unsigned long)h.tMs, LogRecord::levelName(h.level), text);
+    }
+
+    pos += sizeof(h) + h.len;
+    ++records;
+  }
+
+  skipped += data.size() - pos;
+  fprintf(stderr, "%zu records, %zu bytes skipped\n", records, skipped);
+  return 0;
+}